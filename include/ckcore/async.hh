@@ -0,0 +1,174 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/async.hh
+ * @brief Asynchronous operations completing in a thread pool.
+ */
+
+#pragma once
+#include "ckcore/types.hh"
+#include "ckcore/task.hh"
+#include "ckcore/file.hh"
+#include "ckcore/process.hh"
+#include "ckcore/stream.hh"
+#include "ckcore/threadpool.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Completion handler for asynchronous operations.
+     *
+     * A completion is a task which is started in the thread pool when an
+     * asynchronous operation has finished, receiving the result of the
+     * operation. Long running work can be written as a chain of completions,
+     * each one starting the next asynchronous operation, which allows a large
+     * number of concurrent operations to share a few threads. Just like any
+     * other task the completion is deleted after execution if it should be
+     * automatically deleted. If the cancellation token of the completion is
+     * cancelled before the operation has started, the operation is not
+     * performed and the completion is not executed.
+     */
+    class Completion : public Task
+    {
+    private:
+        tint64 result_;
+
+        /**
+         * Executes the completion handler.
+         */
+        void start()
+        {
+            completed(result_);
+        }
+
+    public:
+        Completion() : result_(-1) {}
+
+        /**
+         * Sets the result that will be passed to the completion handler.
+         * @param [in] result The operation result.
+         */
+        void set_result(tint64 result)
+        {
+            result_ = result;
+        }
+
+        /**
+         * Called in a thread pool thread when the operation has completed.
+         * @param [in] result The operation result, the meaning depends on the
+         *                    operation. -1 indicates failure.
+         */
+        virtual void completed(tint64 result) = 0;
+    };
+
+    namespace async
+    {
+        /**
+         * Reads from a file in a thread pool thread. The file must not be
+         * accessed by anyone else until the operation has completed.
+         * @param [in] file The file to read from.
+         * @param [out] buffer The buffer to read into, must be valid until
+         *                     the operation has completed.
+         * @param [in] count The number of bytes to read.
+         * @param [in] completion The completion receiving the number of bytes
+         *                        read or -1 on error.
+         * @param [in] pool The thread pool to use.
+         * @return If the operation was started true is returned, otherwise
+         *         false is returned.
+         */
+        bool read(File &file,void *buffer,tuint32 count,Completion *completion,
+                  ThreadPool &pool = ThreadPool::instance());
+
+        /**
+         * Writes to a file in a thread pool thread. The file must not be
+         * accessed by anyone else until the operation has completed.
+         * @param [in] file The file to write to.
+         * @param [in] buffer The data to write, must be valid until the
+         *                    operation has completed.
+         * @param [in] count The number of bytes to write.
+         * @param [in] completion The completion receiving the number of bytes
+         *                        written or -1 on error.
+         * @param [in] pool The thread pool to use.
+         * @return If the operation was started true is returned, otherwise
+         *         false is returned.
+         */
+        bool write(File &file,const void *buffer,tuint32 count,
+                   Completion *completion,
+                   ThreadPool &pool = ThreadPool::instance());
+
+        /**
+         * Reads from a stream in a thread pool thread.
+         * @param [in] stream The stream to read from.
+         * @param [out] buffer The buffer to read into, must be valid until
+         *                     the operation has completed.
+         * @param [in] count The number of bytes to read.
+         * @param [in] completion The completion receiving the number of bytes
+         *                        read or -1 on error.
+         * @param [in] pool The thread pool to use.
+         * @return If the operation was started true is returned, otherwise
+         *         false is returned.
+         */
+        bool read(InStream &stream,void *buffer,tuint32 count,
+                  Completion *completion,
+                  ThreadPool &pool = ThreadPool::instance());
+
+        /**
+         * Writes to a stream in a thread pool thread.
+         * @param [in] stream The stream to write to.
+         * @param [in] buffer The data to write, must be valid until the
+         *                    operation has completed.
+         * @param [in] count The number of bytes to write.
+         * @param [in] completion The completion receiving the number of bytes
+         *                        written or -1 on error.
+         * @param [in] pool The thread pool to use.
+         * @return If the operation was started true is returned, otherwise
+         *         false is returned.
+         */
+        bool write(OutStream &stream,const void *buffer,tuint32 count,
+                   Completion *completion,
+                   ThreadPool &pool = ThreadPool::instance());
+
+        /**
+         * Executes a completion after a delay without occupying any thread
+         * while waiting.
+         * @param [in] delay The delay in milliseconds.
+         * @param [in] completion The completion receiving 0 as result.
+         * @param [in] pool The thread pool to use.
+         * @return If the operation was started true is returned, otherwise
+         *         false is returned.
+         */
+        bool sleep(tuint32 delay,Completion *completion,
+                   ThreadPool &pool = ThreadPool::instance());
+
+        /**
+         * Executes a completion when a process has exited. The operation is
+         * started by the process when it finishes so no thread is blocked
+         * while waiting.
+         * @param [in] process The process to wait for, must be valid until
+         *                     the operation has completed.
+         * @param [in] completion The completion receiving the process exit
+         *                        code or -1 if it's not available.
+         * @param [in] pool The thread pool to use.
+         * @return If the operation was started true is returned, otherwise
+         *         false is returned.
+         */
+        bool wait(Process &process,Completion *completion,
+                  ThreadPool &pool = ThreadPool::instance());
+    }
+}
@@ -0,0 +1,151 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/atomic.hh
+ * @brief Atomic operations on integers.
+ */
+
+#pragma once
+#ifdef _WINDOWS
+#include <intrin.h>
+#endif
+#include "ckcore/types.hh"
+
+#ifdef _WINDOWS
+#pragma intrinsic(_InterlockedExchangeAdd)
+#pragma intrinsic(_InterlockedExchange)
+#pragma intrinsic(_InterlockedCompareExchange)
+#pragma intrinsic(_ReadWriteBarrier)
+#pragma intrinsic(_mm_pause)
+#endif
+
+namespace ckcore
+{
+    namespace atomic
+    {
+        /**
+         * Reads an integer with acquire semantics. Memory operations following
+         * the load will not be reordered before it.
+         * @param [in] value The integer to read.
+         * @return The value of the integer.
+         */
+        inline tint32 load(const volatile tint32 &value)
+        {
+#ifdef _WINDOWS
+            // Volatile reads have acquire semantics on Windows.
+            tint32 res = value;
+            _ReadWriteBarrier();
+            return res;
+#elif defined(__ATOMIC_ACQUIRE)
+            return __atomic_load_n(&value,__ATOMIC_ACQUIRE);
+#else
+            tint32 res = value;
+            __sync_synchronize();
+            return res;
+#endif
+        }
+
+        /**
+         * Writes an integer with release semantics. Memory operations
+         * preceeding the store will not be reordered after it.
+         * @param [out] value The integer to write.
+         * @param [in] new_value The value to write.
+         */
+        inline void store(volatile tint32 &value,tint32 new_value)
+        {
+#ifdef _WINDOWS
+            _ReadWriteBarrier();
+            value = new_value;
+#elif defined(__ATOMIC_RELEASE)
+            __atomic_store_n(&value,new_value,__ATOMIC_RELEASE);
+#else
+            __sync_synchronize();
+            value = new_value;
+#endif
+        }
+
+        /**
+         * Atomically adds to an integer.
+         * @param [in, out] value The integer to add to.
+         * @param [in] delta The amount to add, may be negative.
+         * @return The new value of the integer.
+         */
+        inline tint32 add(volatile tint32 &value,tint32 delta)
+        {
+#ifdef _WINDOWS
+            return _InterlockedExchangeAdd(&value,delta) + delta;
+#else
+            return __sync_add_and_fetch(&value,delta);
+#endif
+        }
+
+        /**
+         * Atomically replaces the value of an integer.
+         * @param [in, out] value The integer to replace.
+         * @param [in] new_value The new value.
+         * @return The previous value of the integer.
+         */
+        inline tint32 exchange(volatile tint32 &value,tint32 new_value)
+        {
+#ifdef _WINDOWS
+            return _InterlockedExchange(&value,new_value);
+#elif defined(__ATOMIC_SEQ_CST)
+            return __atomic_exchange_n(&value,new_value,__ATOMIC_SEQ_CST);
+#else
+            __sync_synchronize();
+            return __sync_lock_test_and_set(&value,new_value);
+#endif
+        }
+
+        /**
+         * Atomically replaces the value of an integer if it's equal to an
+         * expected value.
+         * @param [in, out] value The integer to replace.
+         * @param [in] expected The expected current value.
+         * @param [in] new_value The new value.
+         * @return The previous value of the integer, if it's equal to
+         *         expected the integer was replaced.
+         */
+        inline tint32 compare_exchange(volatile tint32 &value,tint32 expected,
+                                       tint32 new_value)
+        {
+#ifdef _WINDOWS
+            return _InterlockedCompareExchange(&value,new_value,expected);
+#else
+            return __sync_val_compare_and_swap(&value,expected,new_value);
+#endif
+        }
+
+        /**
+         * Hints the processor that the calling thread is in a spin loop. This
+         * reduces the power consumption and frees resources for other
+         * hardware threads on the same core.
+         */
+        inline void pause()
+        {
+#ifdef _WINDOWS
+            _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+            __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__aarch64__)
+            __asm__ __volatile__("yield" ::: "memory");
+#endif
+        }
+    }
+}
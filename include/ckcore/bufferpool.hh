@@ -0,0 +1,251 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/bufferpool.hh
+ * @brief Pool of reusable page aligned buffers.
+ */
+
+#pragma once
+#include <vector>
+#include "ckcore/types.hh"
+#include "ckcore/thread.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Pool of page aligned I/O buffers.
+     *
+     * Buffer sizes are rounded up to a power of two size class. Released
+     * buffers are first kept in a small cache private to the releasing
+     * thread, which serves allocations without any locking. Buffers which
+     * don't fit in the thread cache are moved to a pool shared by all
+     * threads, limited by a byte budget. Buffers beyond the budget, and
+     * buffers larger than the largest size class, are returned to the
+     * system.
+     *
+     * Buffers of at least HUGE_PAGE_SIZE bytes are mapped directly from the
+     * system and may optionally be backed by huge pages.
+     */
+    class BufferPool
+    {
+    public:
+        /**
+         * @brief Defines constants specifying the class behaviour.
+         */
+        enum
+        {
+            MIN_BUFFER_SIZE = 4096,                 ///< Size of the smallest size class.
+            MAX_BUFFER_SIZE = 4 * 1024 * 1024,      ///< Size of the largest size class.
+            NUM_CLASSES = 11,
+            HUGE_PAGE_SIZE = 2 * 1024 * 1024,       ///< Buffers this large are mapped directly.
+            THREAD_CACHE_COUNT = 4,                 ///< Buffers of each size class cached per thread.
+            THREAD_CACHE_MAX_SIZE = 256 * 1024,     ///< Largest size class cached per thread.
+            DEFAULT_BUDGET = 64 * 1024 * 1024       ///< Default byte budget of the shared pool.
+        };
+
+    private:
+        /**
+         * @brief Buffers cached by a single thread.
+         */
+        struct ThreadCache
+        {
+            BufferPool *pool_;
+            std::vector<void *> buffers_[NUM_CLASSES];
+        };
+
+        unsigned long tls_key_;     ///< Thread local storage slot of the thread caches.
+        tuint64 budget_;
+        tuint64 cached_;            ///< Number of bytes in the shared pool.
+        bool huge_pages_;
+
+        std::vector<void *> buffers_[NUM_CLASSES];
+        std::vector<ThreadCache *> caches_;
+        mutable thread::Mutex mutex_;
+
+        BufferPool(const BufferPool &rhs);
+        BufferPool &operator=(const BufferPool &rhs);
+
+        /**
+         * Calculates the size class of a buffer.
+         * @param [in] size The requested buffer size.
+         * @return The size class index, NUM_CLASSES if the buffer is larger
+         *         than the largest size class.
+         */
+        static size_t size_class(size_t size);
+
+        /**
+         * Allocates memory from the system.
+         * @param [in] size The rounded buffer size.
+         * @return Pointer to the memory, NULL if unsuccessful.
+         */
+        void *allocate_system(size_t size);
+
+        /**
+         * Returns memory to the system.
+         * @param [in] buffer The memory.
+         * @param [in] size The rounded buffer size.
+         */
+        static void release_system(void *buffer,size_t size);
+
+        /**
+         * Returns the cache of the calling thread, creating it if necessary.
+         * @return The thread cache, NULL if it couldn't be created.
+         */
+        ThreadCache *thread_cache();
+
+        /**
+         * Moves all buffers of a thread cache to the shared pool. Must be
+         * called with the mutex locked.
+         * @param [in] cache The thread cache.
+         */
+        void flush(ThreadCache *cache);
+
+        /**
+         * Releases buffers from the shared pool until it fits the budget.
+         * Must be called with the mutex locked.
+         */
+        void enforce_budget();
+
+        /**
+         * Called when a thread with a cache exits.
+         * @param [in] param The thread cache.
+         */
+        static void destroy_cache(void *param);
+
+    public:
+        /**
+         * Constructs a BufferPool object.
+         * @param [in] budget The maximum number of bytes kept in the shared
+         *                    pool.
+         */
+        BufferPool(tuint64 budget = DEFAULT_BUDGET);
+
+        /**
+         * Destructs the BufferPool object, returning all cached buffers to
+         * the system. No thread may use the pool during destruction.
+         */
+        ~BufferPool();
+
+        /**
+         * Returns the pool used for the internal buffers of the library. The
+         * pool is never destroyed so that it remains usable by threads
+         * running while the application exits.
+         * @return The default pool.
+         */
+        static BufferPool &instance();
+
+        /**
+         * Calculates the actual size of a buffer allocated from the pool.
+         * Buffers larger than the largest size class are rounded up to a
+         * multiple of HUGE_PAGE_SIZE.
+         * @param [in] size The requested buffer size.
+         * @return The rounded buffer size.
+         */
+        static size_t buffer_size(size_t size);
+
+        /**
+         * Allocates a page aligned buffer.
+         * @param [in] size The requested buffer size.
+         * @return Pointer to a buffer of at least the requested size, NULL if
+         *         unsuccessful.
+         */
+        void *allocate(size_t size);
+
+        /**
+         * Returns a buffer to the pool.
+         * @param [in] buffer The buffer, may be NULL.
+         * @param [in] size The size the buffer was allocated with.
+         */
+        void release(void *buffer,size_t size);
+
+        /**
+         * Returns all buffers in the shared pool and the cache of the calling
+         * thread to the system.
+         */
+        void trim();
+
+        /**
+         * Sets the maximum number of bytes kept in the shared pool.
+         * @param [in] budget The budget in bytes.
+         */
+        void set_budget(tuint64 budget);
+
+        /**
+         * Enables or disables huge pages for buffers of at least
+         * HUGE_PAGE_SIZE bytes. If huge pages are not available normal pages
+         * are used.
+         * @param [in] enable Set to true to enable huge pages and false to
+         *                    disable them.
+         */
+        void set_huge_pages(bool enable);
+
+        /**
+         * Returns the number of bytes kept in the shared pool, not counting
+         * the thread caches.
+         * @return The number of cached bytes.
+         */
+        tuint64 cached() const;
+    };
+
+    /**
+     * @brief Buffer borrowed from a BufferPool for the lifetime of the
+     *        object.
+     */
+    class PooledBuffer
+    {
+    private:
+        BufferPool &pool_;
+        unsigned char *buffer_;
+        size_t size_;
+
+        PooledBuffer(const PooledBuffer &rhs);
+        PooledBuffer &operator=(const PooledBuffer &rhs);
+
+    public:
+        /**
+         * Constructs a PooledBuffer object.
+         * @param [in] size The requested buffer size.
+         * @param [in] pool The pool to allocate the buffer from.
+         */
+        PooledBuffer(size_t size,BufferPool &pool = BufferPool::instance())
+            : pool_(pool),
+              buffer_(static_cast<unsigned char *>(pool.allocate(size))),
+              size_(size)
+        {
+        }
+
+        /**
+         * Destructs the PooledBuffer object, returning the buffer to the
+         * pool.
+         */
+        ~PooledBuffer()
+        {
+            pool_.release(buffer_,size_);
+        }
+
+        /**
+         * Returns the buffer.
+         * @return Pointer to the buffer, NULL if the allocation failed.
+         */
+        unsigned char *data() const
+        {
+            return buffer_;
+        }
+    };
+}
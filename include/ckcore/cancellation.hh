@@ -0,0 +1,142 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/cancellation.hh
+ * @brief Cooperative cancellation of tasks and operations.
+ */
+
+#pragma once
+#include "ckcore/types.hh"
+#include "ckcore/atomic.hh"
+
+namespace ckcore
+{
+    class CancellationSource;
+
+    /**
+     * @brief Token for checking if an operation has been cancelled.
+     *
+     * Tokens are obtained from a CancellationSource and may be freely copied
+     * and passed between threads, all copies observe the cancellation of
+     * their source. Checking a token is a single memory read which makes it
+     * suitable for polling in tight loops. A default constructed token is
+     * never cancelled.
+     */
+    class CancellationToken
+    {
+    private:
+        friend class CancellationSource;
+
+        /**
+         * @brief Cancellation state shared between a source and its tokens.
+         */
+        class State
+        {
+        public:
+            volatile tint32 cancelled_;
+            volatile tint32 refs_;  ///< Number of sources and tokens using the state.
+
+            State() : cancelled_(0),refs_(1) {}
+        };
+
+        State *state_;
+
+        /**
+         * Constructs a token sharing the specified state.
+         * @param [in] state The shared cancellation state.
+         */
+        explicit CancellationToken(State *state);
+
+        /**
+         * Releases a reference to the state, deleting it when unused.
+         * @param [in] state The shared cancellation state.
+         */
+        static void release(State *state);
+
+    public:
+        /**
+         * Constructs a token that is never cancelled.
+         */
+        CancellationToken();
+        CancellationToken(const CancellationToken &rhs);
+        ~CancellationToken();
+
+        CancellationToken &operator=(const CancellationToken &rhs);
+
+        /**
+         * Checks if the operation has been cancelled.
+         * @return If the operation has been cancelled true is returned,
+         *         otherwise false is returned.
+         */
+        bool cancelled() const
+        {
+            return state_ != NULL && atomic::load(state_->cancelled_) != 0;
+        }
+
+        /**
+         * Checks if the token is associated with a source and can ever be
+         * cancelled.
+         * @return If the token can be cancelled true is returned, otherwise
+         *         false is returned.
+         */
+        bool cancellable() const
+        {
+            return state_ != NULL;
+        }
+    };
+
+    /**
+     * @brief Source of cancellation tokens.
+     *
+     * The source is held by the party that may want to abort an operation,
+     * for example a user interface, while tokens are handed to the tasks and
+     * functions performing it.
+     */
+    class CancellationSource
+    {
+    private:
+        CancellationToken::State *state_;
+
+        CancellationSource(const CancellationSource &rhs);
+        CancellationSource &operator=(const CancellationSource &rhs);
+
+    public:
+        CancellationSource();
+        ~CancellationSource();
+
+        /**
+         * Returns a token observing this source. The token remains valid
+         * after the source has been destroyed.
+         * @return A cancellation token.
+         */
+        CancellationToken token() const;
+
+        /**
+         * Cancels all operations observing the tokens of this source.
+         * Cancellation can not be undone.
+         */
+        void cancel();
+
+        /**
+         * Checks if the source has been cancelled.
+         * @return If cancelled true is returned, otherwise false is returned.
+         */
+        bool cancelled() const;
+    };
+}
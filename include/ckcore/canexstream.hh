@@ -133,6 +133,18 @@ namespace ckcore
 
     namespace canexstream
     {
+        /**
+         * Copies the contents of the input stream to the output stream. An
+         * internal buffer is used to optimize the process. The operation is
+         * aborted as soon as the token is cancelled.
+         * @param [in] from The source stream.
+         * @param [in] to The target stream.
+         * @param [in] token The token used to cancel the operation.
+         * @throw Exception On read or write errors.
+         */
+        void copy(CanexInStream &from,CanexOutStream &to,
+                  const CancellationToken &token);
+
         /**
          * Copies the contents of the input stream to the output stream. An
          * internal buffer is used to optimize the process. Progress is
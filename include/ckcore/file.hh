@@ -75,6 +75,8 @@ namespace ckcore
         };
 
     private:
+        friend class Process;
+
 #ifdef _WINDOWS
         HANDLE file_handle_;
 #else
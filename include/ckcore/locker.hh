@@ -22,6 +22,7 @@
  */
 
 #pragma once
+#include <vector>
 #include "ckcore/types.hh"
 
 namespace ckcore
@@ -95,5 +96,228 @@ namespace ckcore
             return locked_;
         }
     };
-}
 
+    /**
+     * @brief Template class for locking and unlocking lockable objects in
+     *        shared mode.
+     *
+     * The lockable object must provide lock_shared() and unlock_shared()
+     * functions, for example thread::RWLock.
+     */
+    template <typename T>
+    class SharedLocker
+    {
+    private:
+        T &lockable_;
+        bool locked_;
+
+        SharedLocker(const SharedLocker &rhs);
+        SharedLocker &operator=(const SharedLocker &rhs);
+
+    public:
+        /**
+         * Constructs the locker and locks the lockable object in shared mode.
+         * @param [in] lockable Object to lock.
+         */
+        explicit SharedLocker(T &lockable) : lockable_(lockable),
+            locked_(lockable.lock_shared())
+        {
+        }
+
+        /**
+         * Destructs the locker and unlocks the lockable object.
+         */
+        ~SharedLocker()
+        {
+            if (locked_)
+                locked_ = !lockable_.unlock_shared();
+        }
+
+        /**
+         * Explicitly unlock the lockable object.
+         * @return If the lockable object was successfully unlocked true is
+         *         returned if not false is returned.
+         */
+        bool unlock()
+        {
+            if (!locked_)
+                return false;
+
+            locked_ = !lockable_.unlock_shared();
+            return !locked_;
+        }
+
+        /**
+         * Explicitly relock the lockable object.
+         * @return If the lockable object was successfully relocked true is
+         *         returned if not false is returned.
+         */
+        bool relock()
+        {
+            if (locked_)
+                return false;
+
+            locked_ = lockable_.lock_shared();
+            return locked_;
+        }
+
+        /**
+         * Tests if the locable object is currently locked.
+         * @return If the locable is locked true is returned, if not false is
+         *         returned.
+         */
+        bool locked()
+        {
+            return locked_;
+        }
+    };
+
+    /**
+     * @brief Template class for locking multiple lockable objects without
+     *        risking deadlocks.
+     *
+     * The first object is locked by waiting while the remaining objects are
+     * locked using try_lock(). If any of them is busy all locks are released
+     * and the procedure starts over, waiting for the busy object first. This
+     * avoids deadlocks regardless of the order other threads lock the same
+     * objects in.
+     */
+    template <typename T>
+    class MultiLocker
+    {
+    private:
+        std::vector<T *> lockables_;
+        bool locked_;
+
+        MultiLocker(const MultiLocker &rhs);
+        MultiLocker &operator=(const MultiLocker &rhs);
+
+        /**
+         * Unlocks a range of the lockable objects.
+         * @param [in] first Index of the first object to unlock.
+         * @param [in] count Number of objects to unlock.
+         */
+        void unlock_range(size_t first,size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                lockables_[(first + i) % lockables_.size()]->unlock();
+        }
+
+        /**
+         * Locks all lockable objects.
+         * @return If successful true is returned, if not false is returned.
+         */
+        bool lock_all()
+        {
+            const size_t count = lockables_.size();
+            if (count == 0)
+                return true;
+
+            size_t first = 0;
+            for (;;)
+            {
+                if (!lockables_[first]->lock())
+                    return false;
+
+                size_t i = 1;
+                for (; i < count; i++)
+                {
+                    if (!lockables_[(first + i) % count]->try_lock())
+                        break;
+                }
+
+                if (i == count)
+                    return true;
+
+                unlock_range(first,i);
+                first = (first + i) % count;
+            }
+        }
+
+    public:
+        /**
+         * Constructs the locker and locks two lockable objects.
+         * @param [in] lockable1 First object to lock.
+         * @param [in] lockable2 Second object to lock.
+         */
+        MultiLocker(T &lockable1,T &lockable2)
+        {
+            lockables_.push_back(&lockable1);
+            lockables_.push_back(&lockable2);
+            locked_ = lock_all();
+        }
+
+        /**
+         * Constructs the locker and locks three lockable objects.
+         * @param [in] lockable1 First object to lock.
+         * @param [in] lockable2 Second object to lock.
+         * @param [in] lockable3 Third object to lock.
+         */
+        MultiLocker(T &lockable1,T &lockable2,T &lockable3)
+        {
+            lockables_.push_back(&lockable1);
+            lockables_.push_back(&lockable2);
+            lockables_.push_back(&lockable3);
+            locked_ = lock_all();
+        }
+
+        /**
+         * Constructs the locker and locks an arbitrary number of lockable
+         * objects.
+         * @param [in] lockables The objects to lock.
+         */
+        explicit MultiLocker(const std::vector<T *> &lockables) :
+            lockables_(lockables)
+        {
+            locked_ = lock_all();
+        }
+
+        /**
+         * Destructs the locker and unlocks all lockable objects.
+         */
+        ~MultiLocker()
+        {
+            if (locked_)
+                unlock_range(0,lockables_.size());
+        }
+
+        /**
+         * Explicitly unlock the lockable objects.
+         * @return If the lockable objects were unlocked true is returned if
+         *         not false is returned.
+         */
+        bool unlock()
+        {
+            if (!locked_)
+                return false;
+
+            unlock_range(0,lockables_.size());
+            locked_ = false;
+            return true;
+        }
+
+        /**
+         * Explicitly relock the lockable objects.
+         * @return If the lockable objects were successfully relocked true is
+         *         returned if not false is returned.
+         */
+        bool relock()
+        {
+            if (locked_)
+                return false;
+
+            locked_ = lock_all();
+            return locked_;
+        }
+
+        /**
+         * Tests if the locable objects are currently locked.
+         * @return If the locables are locked true is returned, if not false is
+         *         returned.
+         */
+        bool locked()
+        {
+            return locked_;
+        }
+    };
+}
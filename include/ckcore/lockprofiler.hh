@@ -0,0 +1,198 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/lockprofiler.hh
+ * @brief Lock contention profiling.
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include "ckcore/types.hh"
+#include "ckcore/spinlock.hh"
+
+namespace ckcore
+{
+    namespace thread
+    {
+        /**
+         * @brief Snapshot of the statistics collected for a named lock.
+         *
+         * Times are measured in microseconds. The histograms use logarithmic
+         * buckets, the first bucket counts times less than one microsecond
+         * and bucket i counts times in the range [2^(i-1),2^i) microseconds.
+         */
+        class LockStats
+        {
+        public:
+            /**
+             * @brief Defines constants specifying the class behaviour.
+             */
+            enum
+            {
+                HISTOGRAM_SIZE = 32
+            };
+
+            std::string name_;
+            tuint32 instances_;         ///< Number of locks sharing the name.
+            tuint64 acquisitions_;
+            tuint64 contended_;         ///< Acquisitions that had to wait.
+            tuint64 wait_time_;         ///< Total time spent waiting.
+            tuint64 hold_time_;         ///< Total time the lock was held.
+            tuint64 wait_histogram_[HISTOGRAM_SIZE];
+            tuint64 hold_histogram_[HISTOGRAM_SIZE];
+
+            /**
+             * Constructs an empty LockStats object.
+             */
+            LockStats();
+        };
+
+        /**
+         * @brief Statistics collector shared by all locks with the same name.
+         *
+         * Objects of this class are created by LockProfiler and live for the
+         * remaining life time of the process. The hooks are called by the
+         * lock implementations and do nothing while profiling is disabled.
+         */
+        class LockProfile
+        {
+        private:
+            SpinLock lock_;
+            LockStats stats_;
+
+            LockProfile(const LockProfile &rhs);
+            LockProfile &operator=(const LockProfile &rhs);
+
+            /**
+             * Adds a time to a histogram.
+             * @param [in] histogram The histogram.
+             * @param [in] time The time in microseconds.
+             */
+            static void add(tuint64 *histogram,tuint64 time);
+
+        public:
+            /**
+             * Constructs a LockProfile object.
+             * @param [in] name The lock name.
+             */
+            LockProfile(const char *name);
+
+            /**
+             * Returns the current time in microseconds if profiling is enabled.
+             * @return If profiling is enabled the current time is returned,
+             *         otherwise 0 is returned.
+             */
+            tuint64 start_wait();
+
+            /**
+             * Records an acquisition of the lock.
+             * @param [out] acquired Receives the acquisition time, to be
+             *                       passed to released().
+             * @param [in] contended Set to true if the lock was busy.
+             * @param [in] wait_start The time returned by start_wait() when
+             *                        the caller started waiting.
+             */
+            void acquired(tuint64 &acquired,bool contended,tuint64 wait_start = 0);
+
+            /**
+             * Records the release of the lock. Must be called before the lock
+             * is actually released.
+             * @param [in,out] acquired The acquisition time, reset to 0.
+             */
+            void released(tuint64 &acquired);
+
+            /**
+             * Registers another lock instance with this profile.
+             */
+            void attach();
+
+            /**
+             * Returns a copy of the collected statistics.
+             * @param [out] stats The statistics.
+             */
+            void snapshot(LockStats &stats);
+
+            /**
+             * Clears the collected statistics.
+             */
+            void reset();
+        };
+
+        /**
+         * @brief Lock contention profiler.
+         *
+         * Mutexes constructed with a name are registered with the profiler,
+         * mutexes with the same name share statistics. Profiling is disabled
+         * by default and costs only a test of a pointer per operation. When
+         * enabled, each acquisition and release of a named mutex reads the
+         * monotonic clock.
+         */
+        class LockProfiler
+        {
+        private:
+            static volatile tint32 enabled_;
+
+        public:
+            /**
+             * Enables or disables lock profiling.
+             * @param [in] enable Set to true to enable profiling.
+             */
+            static void enable(bool enable);
+
+            /**
+             * Checks if lock profiling is enabled.
+             * @return If profiling is enabled true is returned, otherwise false
+             *         is returned.
+             */
+            static bool enabled();
+
+            /**
+             * Returns the profile for the specified lock name, creating it if
+             * necessary.
+             * @param [in] name The lock name.
+             * @return The lock profile.
+             */
+            static LockProfile *profile(const char *name);
+
+            /**
+             * Returns the statistics of all named locks.
+             * @param [out] stats The statistics, sorted by name.
+             */
+            static void stats(std::vector<LockStats> &stats);
+
+            /**
+             * Clears the statistics of all named locks.
+             */
+            static void reset();
+
+            /**
+             * Formats the statistics of all named locks as a JSON document.
+             * @return The JSON document.
+             */
+            static std::string json();
+
+            /**
+             * Returns the current monotonic time in microseconds.
+             * @return The current time in microseconds.
+             */
+            static tuint64 now();
+        };
+    }
+}
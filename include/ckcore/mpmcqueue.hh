@@ -0,0 +1,270 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/mpmcqueue.hh
+ * @brief Lock-free multiple producer multiple consumer queue.
+ */
+
+#pragma once
+#include "ckcore/types.hh"
+#include "ckcore/atomic.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Bounded lock-free queue for any number of producer and consumer
+     *        threads.
+     *
+     * Each slot carries a sequence number telling which lap of the ring it
+     * belongs to and whether it is full or empty. Producers and consumers
+     * claim slots by advancing their shared index with a single atomic
+     * operation, and the indices are kept on separate cache lines. Items are
+     * transferred by copy and the queue never blocks.
+     * @param T The item type, must be default constructible and copyable.
+     */
+    template <typename T>
+    class MpmcQueue
+    {
+    public:
+        /**
+         * @brief Defines constants specifying the class behaviour.
+         */
+        enum
+        {
+            CACHE_LINE_SIZE = 64
+        };
+
+    private:
+        /**
+         * @brief Queue slot.
+         */
+        struct Cell
+        {
+            volatile tint32 seq_;
+            T item_;
+        };
+
+        char pad0_[CACHE_LINE_SIZE];
+        Cell *cells_;
+        tuint32 mask_;
+        char pad1_[CACHE_LINE_SIZE];
+        volatile tint32 enqueue_pos_;
+        char pad2_[CACHE_LINE_SIZE - sizeof(tint32)];
+        volatile tint32 dequeue_pos_;
+        char pad3_[CACHE_LINE_SIZE - sizeof(tint32)];
+
+        MpmcQueue(const MpmcQueue &rhs);
+        MpmcQueue &operator=(const MpmcQueue &rhs);
+
+        /**
+         * Returns the distance between a slot sequence number and a position.
+         * @param [in] cell The slot.
+         * @param [in] pos The position.
+         * @return The signed distance.
+         */
+        static tint32 distance(const Cell &cell,tuint32 pos)
+        {
+            return static_cast<tint32>(static_cast<tuint32>(atomic::load(cell.seq_)) - pos);
+        }
+
+    public:
+        /**
+         * Constructs an empty queue.
+         * @param [in] capacity The minimum capacity of the queue, rounded up
+         *                      to the nearest power of two.
+         */
+        explicit MpmcQueue(tuint32 capacity) : enqueue_pos_(0),dequeue_pos_(0)
+        {
+            tuint32 size = 2;
+            while (size < capacity)
+                size <<= 1;
+
+            cells_ = new Cell[size];
+            mask_ = size - 1;
+
+            for (tuint32 i = 0; i < size; i++)
+                cells_[i].seq_ = static_cast<tint32>(i);
+        }
+
+        /**
+         * Destructs the queue.
+         */
+        ~MpmcQueue()
+        {
+            delete [] cells_;
+        }
+
+        /**
+         * Pushes one item onto the queue.
+         * @param [in] item The item to push.
+         * @return If successful true is returned, if the queue is full false
+         *         is returned.
+         */
+        bool push(const T &item)
+        {
+            return push(&item,1) == 1;
+        }
+
+        /**
+         * Pushes multiple items onto the queue. The items are claimed with a
+         * single atomic operation and stored in consecutive slots.
+         * @param [in] items The items to push.
+         * @param [in] count The number of items to push.
+         * @return The number of items pushed, less than count if the queue
+         *         became full.
+         */
+        tuint32 push(const T *items,tuint32 count)
+        {
+            if (count == 0)
+                return 0;
+
+            for (;;)
+            {
+                const tuint32 pos = static_cast<tuint32>(atomic::load(enqueue_pos_));
+
+                // Count the consecutive free slots of this lap.
+                tuint32 free = 0;
+                while (free < count && free <= mask_ &&
+                       distance(cells_[(pos + free) & mask_],pos + free) == 0)
+                {
+                    free++;
+                }
+
+                if (free == 0)
+                {
+                    // The queue is full if the slot still belongs to the
+                    // previous lap, otherwise another producer got here first.
+                    if (distance(cells_[pos & mask_],pos) < 0)
+                        return 0;
+
+                    continue;
+                }
+
+                if (atomic::compare_exchange(enqueue_pos_,static_cast<tint32>(pos),
+                                             static_cast<tint32>(pos + free)) !=
+                    static_cast<tint32>(pos))
+                {
+                    continue;
+                }
+
+                for (tuint32 i = 0; i < free; i++)
+                {
+                    Cell &cell = cells_[(pos + i) & mask_];
+                    cell.item_ = items[i];
+                    atomic::store(cell.seq_,static_cast<tint32>(pos + i + 1));
+                }
+
+                return free;
+            }
+        }
+
+        /**
+         * Pops one item from the queue.
+         * @param [out] item The popped item.
+         * @return If successful true is returned, if the queue is empty false
+         *         is returned.
+         */
+        bool pop(T &item)
+        {
+            return pop(&item,1) == 1;
+        }
+
+        /**
+         * Pops multiple items from the queue. The items are claimed with a
+         * single atomic operation.
+         * @param [out] items Buffer receiving the popped items.
+         * @param [in] count The maximum number of items to pop.
+         * @return The number of items popped.
+         */
+        tuint32 pop(T *items,tuint32 count)
+        {
+            if (count == 0)
+                return 0;
+
+            for (;;)
+            {
+                const tuint32 pos = static_cast<tuint32>(atomic::load(dequeue_pos_));
+
+                // Count the consecutive slots that have been filled.
+                tuint32 full = 0;
+                while (full < count && full <= mask_ &&
+                       distance(cells_[(pos + full) & mask_],pos + full + 1) == 0)
+                {
+                    full++;
+                }
+
+                if (full == 0)
+                {
+                    // The queue is empty if the slot has not been filled yet,
+                    // otherwise another consumer got here first.
+                    if (distance(cells_[pos & mask_],pos + 1) < 0)
+                        return 0;
+
+                    continue;
+                }
+
+                if (atomic::compare_exchange(dequeue_pos_,static_cast<tint32>(pos),
+                                             static_cast<tint32>(pos + full)) !=
+                    static_cast<tint32>(pos))
+                {
+                    continue;
+                }
+
+                for (tuint32 i = 0; i < full; i++)
+                {
+                    Cell &cell = cells_[(pos + i) & mask_];
+                    items[i] = cell.item_;
+                    atomic::store(cell.seq_,static_cast<tint32>(pos + i + mask_ + 1));
+                }
+
+                return full;
+            }
+        }
+
+        /**
+         * Returns the approximate number of items in the queue.
+         * @return The number of items in the queue.
+         */
+        tuint32 size() const
+        {
+            const tuint32 head = static_cast<tuint32>(atomic::load(dequeue_pos_));
+            const tuint32 size = static_cast<tuint32>(atomic::load(enqueue_pos_)) - head;
+            return size <= mask_ ? size : mask_ + 1;
+        }
+
+        /**
+         * Checks if the queue is approximately empty.
+         * @return If the queue is empty true is returned, otherwise false is
+         *         returned.
+         */
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        /**
+         * Returns the capacity of the queue.
+         * @return The capacity of the queue.
+         */
+        tuint32 capacity() const
+        {
+            return mask_ + 1;
+        }
+    };
+}
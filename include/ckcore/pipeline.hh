@@ -0,0 +1,238 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/pipeline.hh
+ * @brief Staged streaming pipeline.
+ */
+
+#pragma once
+#include <vector>
+#include "ckcore/types.hh"
+#include "ckcore/stream.hh"
+#include "ckcore/pipestream.hh"
+#include "ckcore/task.hh"
+#include "ckcore/thread.hh"
+#include "ckcore/threadpool.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Interface for pipeline stages.
+     */
+    class PipelineStage
+    {
+    public:
+        virtual ~PipelineStage() {};
+
+        /**
+         * Transforms the data of the input stream and writes the result to
+         * the output stream. The function should return when the input stream
+         * is exhausted.
+         * @param [in] in The stream to read from.
+         * @param [in] out The stream to write to.
+         * @return If successful true is returned, otherwise false is returned.
+         */
+        virtual bool process(InStream &in,OutStream &out) = 0;
+    };
+
+    /**
+     * @brief Pipeline of stream transforms executing in parallel.
+     *
+     * Each stage executes as a task in a thread pool and the stages are
+     * connected by bounded PipeStream rings. A stage blocks when its input
+     * ring is empty or its output ring is full, so a slow stage applies
+     * backpressure to the stages before it while the other stages keep
+     * working on their own data. If a stage fails, its rings are closed which
+     * makes the stages around it fail in turn.
+     *
+     * The amount of data passing through each stage and the time the stage
+     * spent waiting for input and output are measured.
+     */
+    class Pipeline
+    {
+    public:
+        /**
+         * @brief Defines constants specifying the class behaviour.
+         */
+        enum
+        {
+            DEFAULT_BUFFER_SIZE = 256 * 1024
+        };
+
+        /**
+         * @brief Statistics of one pipeline stage.
+         *
+         * All times are measured in microseconds.
+         */
+        class StageStats
+        {
+        public:
+            tuint64 bytes_in_;      ///< Number of bytes read.
+            tuint64 bytes_out_;     ///< Number of bytes written.
+            tuint64 run_time_;      ///< Total execution time.
+            tuint64 input_wait_;    ///< Time spent reading input.
+            tuint64 output_wait_;   ///< Time spent writing output.
+
+            StageStats();
+
+            /**
+             * Calculates the input throughput of the stage.
+             * @return The number of bytes read per second.
+             */
+            tuint64 throughput() const;
+
+            /**
+             * Calculates the time the stage spent processing data.
+             * @return The execution time excluding input and output waits.
+             */
+            tuint64 busy_time() const;
+        };
+
+    private:
+        /**
+         * @brief Input stream measuring another input stream.
+         */
+        class MeteredInStream : public InStream
+        {
+        private:
+            InStream &stream_;
+            StageStats &stats_;
+
+        public:
+            MeteredInStream(InStream &stream,StageStats &stats);
+
+            tint64 read(void *buffer,tuint32 count);
+            tint64 size();
+            bool end();
+            bool seek(tuint32 distance,StreamWhence whence);
+        };
+
+        /**
+         * @brief Output stream measuring another output stream.
+         */
+        class MeteredOutStream : public OutStream
+        {
+        private:
+            OutStream &stream_;
+            StageStats &stats_;
+
+        public:
+            MeteredOutStream(OutStream &stream,StageStats &stats);
+
+            tint64 write(const void *buffer,tuint32 count);
+        };
+
+        /**
+         * @brief Task executing a stage in the thread pool.
+         */
+        class StageTask : public Task
+        {
+        private:
+            Pipeline &pipeline_;
+            tuint32 index_;
+            InStream &in_;
+            OutStream &out_;
+            PipeStream *in_pipe_;       ///< Input ring, NULL for the first stage.
+            PipeStream *out_pipe_;      ///< Output ring, NULL for the last stage.
+
+        public:
+            /**
+             * Constructs a stage task.
+             * @param [in] pipeline The pipeline the stage belongs to.
+             * @param [in] index The stage index.
+             * @param [in] in The stream to read from.
+             * @param [in] out The stream to write to.
+             * @param [in] in_pipe The input ring or NULL.
+             * @param [in] out_pipe The output ring or NULL.
+             */
+            StageTask(Pipeline &pipeline,tuint32 index,InStream &in,
+                      OutStream &out,PipeStream *in_pipe,PipeStream *out_pipe);
+
+            /**
+             * Executes the stage and closes its rings.
+             */
+            void start();
+        };
+
+        ThreadPool &pool_;
+        tuint32 buffer_size_;
+        std::vector<PipelineStage *> stages_;
+        std::vector<StageStats> stats_;
+
+        tuint32 remaining_;     ///< Number of stages still executing.
+        bool failed_;
+        thread::Mutex mutex_;
+        thread::WaitCondition finished_;
+
+        Pipeline(const Pipeline &rhs);
+        Pipeline &operator=(const Pipeline &rhs);
+
+        /**
+         * Called by each stage task when it has finished.
+         * @param [in] result The result of the stage.
+         */
+        void finished(bool result);
+
+    public:
+        /**
+         * Constructs a Pipeline object executing in the default thread pool.
+         * @param [in] buffer_size The size of the ring between each stage.
+         */
+        Pipeline(tuint32 buffer_size = DEFAULT_BUFFER_SIZE);
+
+        /**
+         * Constructs a Pipeline object.
+         * @param [in] pool The thread pool to execute the stages in.
+         * @param [in] buffer_size The size of the ring between each stage.
+         */
+        Pipeline(ThreadPool &pool,tuint32 buffer_size = DEFAULT_BUFFER_SIZE);
+
+        /**
+         * Appends a stage to the pipeline. The pipeline does not take
+         * ownership of the stage.
+         * @param [in] stage The stage to append.
+         * @return The index of the stage.
+         */
+        tuint32 add(PipelineStage &stage);
+
+        /**
+         * Executes the pipeline, feeding the source stream through all stages
+         * into the sink stream. The function returns when all stages have
+         * finished.
+         * @param [in] source The stream the first stage reads from.
+         * @param [in] sink The stream the last stage writes to.
+         * @return If all stages succeeded true is returned, otherwise false is
+         *         returned.
+         */
+        bool execute(InStream &source,OutStream &sink);
+
+        /**
+         * Returns the number of stages.
+         * @return The number of stages.
+         */
+        tuint32 size() const;
+
+        /**
+         * Returns the statistics of a stage from the last execution.
+         * @param [in] index The stage index.
+         * @return The stage statistics.
+         */
+        const StageStats &stats(tuint32 index) const;
+    };
+}
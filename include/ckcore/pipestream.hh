@@ -0,0 +1,246 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/pipestream.hh
+ * @brief In-process pipe between two threads.
+ */
+
+#pragma once
+#include "ckcore/types.hh"
+#include "ckcore/stream.hh"
+#include "ckcore/thread.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief In-process pipe stream class.
+     *
+     * The pipe transfers bytes from one writing thread to one reading thread
+     * through a bounded ring buffer. The ring is lock-free, a thread only
+     * blocks when the ring is full or empty. Besides the stream interfaces
+     * the writer can reserve space and write directly into the ring and the
+     * reader can inspect data in the ring before consuming it, avoiding any
+     * intermediate copies.
+     *
+     * The writer closes the pipe to signal the end of the stream. The reader
+     * can close the pipe to make further writes fail, for example when it
+     * gives up.
+     */
+    class PipeStream
+    {
+    public:
+        /**
+         * @brief Defines constants specifying the class behaviour.
+         */
+        enum
+        {
+            CACHE_LINE_SIZE = 64,
+            DEFAULT_CAPACITY = 64 * 1024
+        };
+
+        /**
+         * @brief The reading end of the pipe.
+         */
+        class Reader : public InStream
+        {
+        private:
+            PipeStream &pipe_;
+
+        public:
+            /**
+             * Constructs a Reader object.
+             * @param [in] pipe The pipe to read from.
+             */
+            Reader(PipeStream &pipe);
+
+            /**
+             * Returns a pointer to the data available in the ring, waiting
+             * until data is available or the writer has closed the pipe.
+             * @param [out] count Receives the number of contiguous bytes
+             *                    available at the returned pointer.
+             * @return Pointer to the available data. If the writer has closed
+             *         the pipe and all data has been consumed NULL is returned.
+             */
+            const unsigned char *peek(tuint32 &count);
+
+            /**
+             * Consumes data previously returned by peek(), freeing the space
+             * for the writer.
+             * @param [in] count The number of bytes to consume.
+             */
+            void consume(tuint32 count);
+
+            /**
+             * Closes the reading end of the pipe, further writes will fail.
+             */
+            void close();
+
+            /**
+             * Reads raw data from the pipe, waiting until at least one byte is
+             * available.
+             * @param [in] buffer Pointer to beginning of buffer to read to.
+             * @param [in] count The number of bytes to read.
+             * @return The number of bytes read, zero if the writer has closed
+             *         the pipe and all data has been read.
+             */
+            tint64 read(void *buffer,tuint32 count);
+
+            /**
+             * The size of a pipe is not known in advance.
+             * @return Always returns -1.
+             */
+            tint64 size();
+
+            /**
+             * Checks if the end of the stream has been reached. The function
+             * waits until data is available or the writer closes the pipe.
+             * @return If the writer has closed the pipe and all data has been
+             *         read true is returned, otherwise false is returned.
+             */
+            bool end();
+
+            /**
+             * Skips data in the pipe. Only relative seeking is supported.
+             * @param [in] distance The number of bytes to skip.
+             * @param [in] whence Must be ckSTREAM_CURRENT.
+             * @return If successfull true is returned, otherwise false is
+             *         returned.
+             */
+            bool seek(tuint32 distance,StreamWhence whence);
+        };
+
+        /**
+         * @brief The writing end of the pipe.
+         */
+        class Writer : public OutStream
+        {
+        private:
+            PipeStream &pipe_;
+
+        public:
+            /**
+             * Constructs a Writer object.
+             * @param [in] pipe The pipe to write to.
+             */
+            Writer(PipeStream &pipe);
+
+            /**
+             * Reserves space in the ring, waiting until space is available or
+             * the reader has closed the pipe.
+             * @param [in,out] count The number of bytes requested, receives
+             *                       the number of contiguous bytes reserved
+             *                       which may be less than requested.
+             * @return Pointer to the reserved space. If the reader has closed
+             *         the pipe NULL is returned.
+             */
+            unsigned char *reserve(tuint32 &count);
+
+            /**
+             * Makes data written to previously reserved space available to
+             * the reader.
+             * @param [in] count The number of bytes to commit.
+             */
+            void commit(tuint32 count);
+
+            /**
+             * Closes the writing end of the pipe, signaling the end of the
+             * stream to the reader.
+             */
+            void close();
+
+            /**
+             * Writes raw data to the pipe, waiting for space as necessary.
+             * @param [in] buffer Pointer to the beginning of the buffer
+             *                    containing the data to be written.
+             * @param [in] count The number of bytes to write.
+             * @return If the reader has closed the pipe before any data could
+             *         be written -1 is returned, otherwise the function returns
+             *         the number of bytes written.
+             */
+            tint64 write(const void *buffer,tuint32 count);
+        };
+
+    private:
+        unsigned char *buffer_;
+        tuint32 mask_;
+
+        char pad0_[CACHE_LINE_SIZE];
+        volatile tint32 head_;          ///< Read position.
+        volatile tint32 reader_waiting_;
+        char pad1_[CACHE_LINE_SIZE - 2 * sizeof(tint32)];
+        volatile tint32 tail_;          ///< Write position.
+        volatile tint32 writer_waiting_;
+        char pad2_[CACHE_LINE_SIZE - 2 * sizeof(tint32)];
+
+        volatile tint32 writer_closed_;
+        volatile tint32 reader_closed_;
+
+        thread::Event data_ready_;      ///< Set when data is added while the reader waits.
+        thread::Event space_ready_;     ///< Set when space is freed while the writer waits.
+
+        Reader reader_;
+        Writer writer_;
+
+        PipeStream(const PipeStream &rhs);
+        PipeStream &operator=(const PipeStream &rhs);
+
+        /**
+         * Waits until data is available or the writer has closed the pipe.
+         * @return The number of bytes available.
+         */
+        tuint32 wait_data();
+
+        /**
+         * Waits until space is available or the reader has closed the pipe.
+         * @return The number of bytes free.
+         */
+        tuint32 wait_space();
+
+    public:
+        /**
+         * Constructs a PipeStream object.
+         * @param [in] capacity The minimum capacity of the ring in bytes,
+         *                      rounded up to the nearest power of two.
+         */
+        PipeStream(tuint32 capacity = DEFAULT_CAPACITY);
+
+        /**
+         * Destructs the PipeStream object.
+         */
+        ~PipeStream();
+
+        /**
+         * Returns the reading end of the pipe.
+         * @return The reading end of the pipe.
+         */
+        Reader &reader();
+
+        /**
+         * Returns the writing end of the pipe.
+         * @return The writing end of the pipe.
+         */
+        Writer &writer();
+
+        /**
+         * Returns the capacity of the ring.
+         * @return The capacity of the ring in bytes.
+         */
+        tuint32 capacity() const;
+    };
+}
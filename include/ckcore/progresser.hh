@@ -24,6 +24,7 @@
 #pragma once
 #include "ckcore/types.hh"
 #include "ckcore/progress.hh"
+#include "ckcore/cancellation.hh"
 
 namespace ckcore
 {
@@ -38,6 +39,7 @@ namespace ckcore
         Progress &progress_;
         tuint64 total_;
         tuint64 count_;
+        CancellationToken token_;
 
     public:
         /**
@@ -47,6 +49,17 @@ namespace ckcore
          */
         Progresser(Progress &progress,tuint64 total);
 
+        /**
+         * Constructs a Progresser object using a cancellation token. The
+         * token is checked instead of asking the progress interface whether
+         * the operation has been cancelled, which is considerably cheaper.
+         * @param [in] progress The progress interface to report the progress to.
+         * @param [in] total The total number of units to progress.
+         * @param [in] token The token used to cancel the operation.
+         */
+        Progresser(Progress &progress,tuint64 total,
+                   const CancellationToken &token);
+
         /**
          * Updates the progress depending on the number of units processed.
          * @param [in] count The number of units processed..
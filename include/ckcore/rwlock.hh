@@ -0,0 +1,138 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/rwlock.hh
+ * @brief Reader-writer lock.
+ */
+
+#pragma once
+#include "ckcore/types.hh"
+#include "ckcore/thread.hh"
+
+namespace ckcore
+{
+    namespace thread
+    {
+        /**
+         * @brief Reader-writer lock class.
+         *
+         * The lock can be held by any number of readers or by a single writer.
+         * Readers acquire and release the lock using a single atomic operation
+         * as long as no writer holds or waits for the lock. The lock prefers
+         * writers, once a writer is waiting new readers are blocked until all
+         * waiting writers have released the lock.
+         *
+         * The exclusive lock is acquired using lock() and unlock() so the
+         * class can be used with Locker, SharedLocker locks it in shared mode.
+         */
+        class RWLock
+        {
+        private:
+            /**
+             * @brief Defines the state flags.
+             */
+            enum
+            {
+                READER_MASK = 0x1fffffff,   ///< Number of readers holding the lock.
+                WRITER_WAITING = 0x20000000,///< Set while writers are waiting.
+                WRITER = 0x40000000         ///< Set while a writer holds the lock.
+            };
+
+            volatile tint32 state_;
+            tuint32 writers_waiting_;
+
+            Mutex mutex_;
+            WaitCondition readers_cond_;
+            WaitCondition writers_cond_;
+
+            RWLock(const RWLock &rhs);
+            RWLock &operator=(const RWLock &rhs);
+
+            /**
+             * Tries to register a reader, fails if a writer holds or waits for
+             * the lock.
+             * @return If successful true is returned, otherwise false is
+             *         returned.
+             */
+            bool try_add_reader();
+
+            /**
+             * Atomically sets or clears flags in the state word.
+             * @param [in] set The flags to set.
+             * @param [in] clear The flags to clear.
+             */
+            void update(tint32 set,tint32 clear);
+
+        public:
+            /**
+             * Constructs an RWLock object.
+             */
+            RWLock();
+
+            /**
+             * Destructs the RWLock object.
+             */
+            ~RWLock();
+
+            /**
+             * Locks the lock for exclusive access.
+             * @return If successful true is returned, if unsuccessful false is
+             *         returned.
+             */
+            bool lock();
+
+            /**
+             * Releases exclusive access to the lock.
+             * @return If successful true is returned, if unsuccessful false is
+             *         returned.
+             */
+            bool unlock();
+
+            /**
+             * Tries to lock the lock for exclusive access and returns
+             * immediately if the lock is held by another thread.
+             * @return If the lock was successfully locked true is returned,
+             *         otherwise false is returned.
+             */
+            bool try_lock();
+
+            /**
+             * Locks the lock for shared access.
+             * @return If successful true is returned, if unsuccessful false is
+             *         returned.
+             */
+            bool lock_shared();
+
+            /**
+             * Releases shared access to the lock.
+             * @return If successful true is returned, if unsuccessful false is
+             *         returned.
+             */
+            bool unlock_shared();
+
+            /**
+             * Tries to lock the lock for shared access and returns immediately
+             * if a writer holds or waits for the lock.
+             * @return If the lock was successfully locked true is returned,
+             *         otherwise false is returned.
+             */
+            bool try_lock_shared();
+        };
+    }
+}
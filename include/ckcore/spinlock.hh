@@ -0,0 +1,89 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/spinlock.hh
+ * @brief Adaptive spin lock.
+ */
+
+#pragma once
+#include "ckcore/types.hh"
+
+namespace ckcore
+{
+    namespace thread
+    {
+        /**
+         * @brief Adaptive spin lock class.
+         *
+         * A spin lock never sleeps in the kernel and should only protect very
+         * short critical sections. Threads waiting for the lock back off
+         * exponentially between attempts. The number of attempts before
+         * yielding the processor adapts to how long the lock has recently
+         * been held, and on single processor systems the lock yields
+         * immediately since spinning can't succeed.
+         */
+        class SpinLock
+        {
+        public:
+            /**
+             * @brief Defines constants specifying the class behaviour.
+             */
+            enum
+            {
+                MIN_SPINS = 16,     ///< Minimum number of spins before yielding.
+                MAX_SPINS = 1024,   ///< Maximum number of spins before yielding.
+                MAX_BACKOFF = 64    ///< Maximum number of pauses between attempts.
+            };
+
+        private:
+            volatile tint32 state_;     ///< 1 if locked and 0 if unlocked.
+            volatile tint32 spins_;     ///< Estimate of the number of spins needed.
+
+            SpinLock(const SpinLock &rhs);
+            SpinLock &operator=(const SpinLock &rhs);
+
+        public:
+            /**
+             * Constructs a SpinLock object.
+             */
+            SpinLock();
+
+            /**
+             * Locks the spin lock.
+             * @return If successful true is returned, if unsuccessful false is
+             *         returned.
+             */
+            bool lock();
+
+            /**
+             * Unlocks the spin lock.
+             * @return If successful true is returned, if the lock was not
+             *         locked false is returned.
+             */
+            bool unlock();
+
+            /**
+             * Tries to lock the spin lock without waiting.
+             * @return If the lock was successfully locked true is returned,
+             *         otherwise false is returned.
+             */
+            bool try_lock();
+        };
+    }
+}
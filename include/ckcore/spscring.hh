@@ -0,0 +1,192 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/spscring.hh
+ * @brief Lock-free single producer single consumer ring buffer.
+ */
+
+#pragma once
+#include "ckcore/types.hh"
+#include "ckcore/atomic.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Lock-free ring buffer for one producer and one consumer thread.
+     *
+     * The producer and consumer indices are kept on separate cache lines and
+     * each side caches the index of the other side, so transferring items
+     * rarely touches shared cache lines. Items are transferred by copy. The
+     * ring never blocks, callers that need to wait for items or space should
+     * combine it with for example a thread::Event or thread::Semaphore.
+     *
+     * At most one thread may push and at most one thread may pop at any given
+     * time.
+     * @param T The item type, must be default constructible and copyable.
+     * @param N The capacity, must be a power of two.
+     */
+    template <typename T,tuint32 N>
+    class SpscRing
+    {
+    public:
+        /**
+         * @brief Defines constants specifying the class behaviour.
+         */
+        enum
+        {
+            CACHE_LINE_SIZE = 64,
+            CAPACITY = N
+        };
+
+    private:
+        // Fails to compile if N is not a power of two.
+        typedef char capacity_must_be_power_of_two[(N > 0 && (N & (N - 1)) == 0) ? 1 : -1];
+
+        volatile tint32 head_;      ///< Index of the next item to pop.
+        tint32 cached_tail_;        ///< Consumer's copy of the producer index.
+        char pad0_[CACHE_LINE_SIZE - 2 * sizeof(tint32)];
+
+        volatile tint32 tail_;      ///< Index of the next item to push.
+        tint32 cached_head_;        ///< Producer's copy of the consumer index.
+        char pad1_[CACHE_LINE_SIZE - 2 * sizeof(tint32)];
+
+        T items_[N];
+
+        SpscRing(const SpscRing &rhs);
+        SpscRing &operator=(const SpscRing &rhs);
+
+    public:
+        /**
+         * Constructs an empty ring.
+         */
+        SpscRing() : head_(0),cached_tail_(0),tail_(0),cached_head_(0)
+        {
+        }
+
+        /**
+         * Pushes one item onto the ring. Must only be called by the producer.
+         * @param [in] item The item to push.
+         * @return If successful true is returned, if the ring is full false is
+         *         returned.
+         */
+        bool push(const T &item)
+        {
+            return push(&item,1) == 1;
+        }
+
+        /**
+         * Pushes multiple items onto the ring, making them visible to the
+         * consumer at once. Must only be called by the producer.
+         * @param [in] items The items to push.
+         * @param [in] count The number of items to push.
+         * @return The number of items pushed, less than count if the ring
+         *         became full.
+         */
+        tuint32 push(const T *items,tuint32 count)
+        {
+            const tuint32 tail = static_cast<tuint32>(tail_);
+            tuint32 space = N - (tail - static_cast<tuint32>(cached_head_));
+            if (space < count)
+            {
+                cached_head_ = atomic::load(head_);
+                space = N - (tail - static_cast<tuint32>(cached_head_));
+            }
+
+            if (count > space)
+                count = space;
+
+            for (tuint32 i = 0; i < count; i++)
+                items_[(tail + i) & (N - 1)] = items[i];
+
+            atomic::store(tail_,static_cast<tint32>(tail + count));
+            return count;
+        }
+
+        /**
+         * Pops one item from the ring. Must only be called by the consumer.
+         * @param [out] item The popped item.
+         * @return If successful true is returned, if the ring is empty false is
+         *         returned.
+         */
+        bool pop(T &item)
+        {
+            return pop(&item,1) == 1;
+        }
+
+        /**
+         * Pops multiple items from the ring, releasing their slots to the
+         * producer at once. Must only be called by the consumer.
+         * @param [out] items Buffer receiving the popped items.
+         * @param [in] count The maximum number of items to pop.
+         * @return The number of items popped.
+         */
+        tuint32 pop(T *items,tuint32 count)
+        {
+            const tuint32 head = static_cast<tuint32>(head_);
+            tuint32 avail = static_cast<tuint32>(cached_tail_) - head;
+            if (avail < count)
+            {
+                cached_tail_ = atomic::load(tail_);
+                avail = static_cast<tuint32>(cached_tail_) - head;
+            }
+
+            if (count > avail)
+                count = avail;
+
+            for (tuint32 i = 0; i < count; i++)
+                items[i] = items_[(head + i) & (N - 1)];
+
+            atomic::store(head_,static_cast<tint32>(head + count));
+            return count;
+        }
+
+        /**
+         * Returns the number of items in the ring. The result is only a
+         * snapshot when called while other threads use the ring.
+         * @return The number of items in the ring.
+         */
+        tuint32 size() const
+        {
+            // Read the head first since it never passes the tail.
+            const tuint32 head = static_cast<tuint32>(atomic::load(head_));
+            const tuint32 size = static_cast<tuint32>(atomic::load(tail_)) - head;
+            return size < N ? size : N;
+        }
+
+        /**
+         * Checks if the ring is empty. The result is only a snapshot when
+         * called while other threads use the ring.
+         * @return If the ring is empty true is returned, otherwise false is
+         *         returned.
+         */
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        /**
+         * Returns the capacity of the ring.
+         * @return The capacity of the ring.
+         */
+        tuint32 capacity() const
+        {
+            return N;
+        }
+    };
+}
@@ -25,6 +25,7 @@
 #include "ckcore/types.hh"
 #include "ckcore/progress.hh"
 #include "ckcore/progresser.hh"
+#include "ckcore/cancellation.hh"
 
 namespace ckcore
 {
@@ -114,6 +115,18 @@ namespace ckcore
          */
         bool copy(InStream &from,OutStream &to);
 
+        /**
+         * Copies the contents of the input stream to the output stream. An
+         * internal buffer is used to optimize the process. The operation is
+         * aborted as soon as the token is cancelled.
+         * @param [in] from The source stream.
+         * @param [in] to The target stream.
+         * @param [in] token The token used to cancel the operation.
+         * @return If successfull true is returned, otherwise false is
+         *         returned. Cancelling the operation is considered a failure.
+         */
+        bool copy(InStream &from,OutStream &to,const CancellationToken &token);
+
         /**
          * Copies the contents of the input stream to the output stream. An
          * internal buffer is used to optimize the process. Progress is
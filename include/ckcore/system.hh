@@ -45,6 +45,14 @@ namespace ckcore
          */
         tuint64 time();
 
+        /**
+         * Returns the number of microseconds that has elapsed since some
+         * unspecified starting point, using a monotonic high resolution clock.
+         * Suitable for measuring short intervals.
+         * @return The current time in microseconds.
+         */
+        tuint64 time_us();
+
         /**
          * Returns the number of clock cycles executed by the host processor
          * since the system was started.
@@ -23,6 +23,7 @@
 
 #pragma once
 #include "ckcore/types.hh"
+#include "ckcore/cancellation.hh"
 
 namespace ckcore
 {
@@ -33,6 +34,7 @@ namespace ckcore
     {
     private:
         bool auto_delete_;
+        CancellationToken token_;
 
     public:
         Task() : auto_delete_(true) {}
@@ -64,6 +66,27 @@ namespace ckcore
         {
             auto_delete_ = enable;
         }
+
+        /**
+         * Returns the token used for cancelling the task.
+         * @return The cancellation token.
+         */
+        const CancellationToken &cancellation_token() const
+        {
+            return token_;
+        }
+
+        /**
+         * Sets the token used for cancelling the task. If the token is
+         * cancelled before the task has started, the task will not be
+         * started by the thread pool. A running task may poll the token to
+         * abort early.
+         * @param [in] token The cancellation token.
+         */
+        void set_cancellation_token(const CancellationToken &token)
+        {
+            token_ = token;
+        }
     };
 }
 
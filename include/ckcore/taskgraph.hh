@@ -0,0 +1,195 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/taskgraph.hh
+ * @brief Executor for tasks with dependencies.
+ */
+
+#pragma once
+#include <vector>
+#include "ckcore/types.hh"
+#include "ckcore/task.hh"
+#include "ckcore/thread.hh"
+#include "ckcore/threadpool.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Directed acyclic graph of tasks executed in a thread pool.
+     *
+     * Each node in the graph is a task which is started as soon as all its
+     * predecessors have finished, independent nodes execute in parallel. Each
+     * node keeps an atomic count of unfinished predecessors and the thread
+     * finishing the last predecessor starts the node, no lock is shared
+     * between the nodes. The execution time of each node is measured so that
+     * the critical path through the graph can be reported.
+     */
+    class TaskGraph
+    {
+    public:
+        typedef tuint32 Node;   ///< Node identifier.
+
+    private:
+        /**
+         * @brief Graph node.
+         */
+        class NodeData
+        {
+        public:
+            Task *task_;
+            std::vector<Node> successors_;
+            tuint32 predecessors_;      ///< Number of predecessors.
+            volatile tint32 pending_;   ///< Number of unfinished predecessors.
+            tuint64 start_time_;
+            tuint64 end_time_;
+
+            NodeData(Task *task);
+        };
+
+        /**
+         * @brief Task executing a graph node in the thread pool.
+         */
+        class NodeTask : public Task
+        {
+        private:
+            TaskGraph &graph_;
+            Node node_;
+
+        public:
+            /**
+             * Constructs a node task.
+             * @param [in] graph The graph the node belongs to.
+             * @param [in] node The node to execute.
+             */
+            NodeTask(TaskGraph &graph,Node node);
+
+            /**
+             * Executes the node task and starts the successors that have
+             * become ready.
+             */
+            void start();
+        };
+
+        ThreadPool &pool_;
+        std::vector<NodeData *> nodes_;
+        std::vector<Node> order_;       ///< Nodes in topological order.
+
+        volatile tint32 remaining_;     ///< Number of nodes left to execute.
+        bool done_;
+        thread::Mutex mutex_;
+        thread::WaitCondition finished_;
+
+        std::vector<Node> crit_path_;
+        tuint64 crit_time_;
+
+        TaskGraph(const TaskGraph &rhs);
+        TaskGraph &operator=(const TaskGraph &rhs);
+
+        /**
+         * Sorts the nodes in topological order.
+         * @return If the graph is acyclic true is returned, otherwise false
+         *         is returned.
+         */
+        bool sort();
+
+        /**
+         * Called when a node has finished executing.
+         * @param [in] node The node that finished.
+         */
+        void finished(Node node);
+
+        /**
+         * Calculates the critical path from the measured execution times.
+         */
+        void calc_critical_path();
+
+    public:
+        /**
+         * Constructs an empty graph executing in the default thread pool.
+         */
+        TaskGraph();
+
+        /**
+         * Constructs an empty graph executing in the specified thread pool.
+         * @param [in] pool The thread pool to execute the tasks in.
+         */
+        explicit TaskGraph(ThreadPool &pool);
+
+        /**
+         * Destructs the graph. Tasks that should be automatically deleted
+         * and have not been executed are deleted.
+         */
+        ~TaskGraph();
+
+        /**
+         * Adds a task to the graph. The task is deleted after execution if
+         * it should be automatically deleted.
+         * @param [in] task The task to add.
+         * @return The identifier of the new node.
+         */
+        Node add(Task *task);
+
+        /**
+         * Adds a dependency between two nodes.
+         * @param [in] node The dependent node.
+         * @param [in] predecessor The node that must finish before node is
+         *                         started.
+         * @return If successful true is returned, if any of the nodes does
+         *         not exist or if they are the same false is returned.
+         */
+        bool depend(Node node,Node predecessor);
+
+        /**
+         * Executes all tasks in the graph and waits for them to finish. The
+         * function must not be called from a thread pool task since it
+         * blocks the calling thread.
+         * @return If successful true is returned, if the graph contains a
+         *         cycle false is returned and no tasks are executed.
+         */
+        bool execute();
+
+        /**
+         * Returns the number of nodes in the graph.
+         * @return The number of nodes.
+         */
+        tuint32 size() const;
+
+        /**
+         * Returns the execution time of a node in the last execution.
+         * @param [in] node The node.
+         * @return The execution time in milliseconds.
+         */
+        tuint64 duration(Node node) const;
+
+        /**
+         * Returns the critical path of the last execution, the chain of
+         * dependent nodes with the longest total execution time which limits
+         * how fast the graph can be executed.
+         * @return The nodes in the critical path, in execution order.
+         */
+        const std::vector<Node> &critical_path() const;
+
+        /**
+         * Returns the total execution time of the nodes in the critical path
+         * of the last execution.
+         * @return The execution time in milliseconds.
+         */
+        tuint64 critical_path_time() const;
+    };
+}
@@ -22,6 +22,8 @@
  */
 
 #pragma once
+#include <vector>
+#include "ckcore/types.hh"
 
 namespace ckcore
 {
@@ -32,6 +34,42 @@ namespace ckcore
          */
         typedef void (* tfunction)(void *param);
     }
+
+    /**
+     * @brief Attributes used when starting a thread.
+     *
+     * All attributes are optional, the default constructed object describes
+     * a thread using the system defaults. Attributes not supported by the
+     * platform are silently ignored.
+     */
+    struct ThreadAttributes
+    {
+        /**
+         * Defines the scheduling policies.
+         */
+        enum SchedPolicy
+        {
+            ckSCHED_DEFAULT,    ///< Inherit the scheduling of the creating thread.
+            ckSCHED_OTHER,      ///< Normal time-shared scheduling.
+            ckSCHED_BATCH,      ///< Time-shared scheduling for CPU bound batch work.
+            ckSCHED_IDLE,       ///< Only run when the system is idle.
+            ckSCHED_FIFO,       ///< Real-time first in, first out scheduling.
+            ckSCHED_RR          ///< Real-time round robin scheduling.
+        };
+
+        tuint32 stack_size;     ///< Stack size in bytes, zero for the system default.
+        std::vector<tuint32> cpu_affinity;  ///< Processors the thread may run on, empty for all.
+        tint32 numa_node;       ///< NUMA node to run on and allocate memory from, -1 for any.
+        SchedPolicy sched_policy;   ///< Scheduling policy.
+        tint32 sched_priority;  ///< Scheduling priority, only used by real-time policies.
+        tstring name;           ///< Thread name, visible in debuggers and system tools.
+
+        ThreadAttributes()
+            : stack_size(0),numa_node(-1),sched_policy(ckSCHED_DEFAULT),
+              sched_priority(0)
+        {
+        }
+    };
 }
 
 #ifdef _WINDOWS
@@ -23,14 +23,21 @@
 
 #pragma once
 #include <queue>
+#include <vector>
 #include "ckcore/types.hh"
 #include "ckcore/task.hh"
 #include "ckcore/thread.hh"
+#include "ckcore/timerwheel.hh"
 
 namespace ckcore
 {
     /**
-     * @brief Thread pool singleton class.
+     * @brief Thread pool class.
+     *
+     * A default pool shared by the whole application is available through
+     * instance(). Additional pools can be created with their own size and
+     * retire policy, for example to keep tasks blocking on I/O from starving
+     * CPU bound tasks.
      */
     class ThreadPool
     {
@@ -43,6 +50,43 @@ namespace ckcore
             THREAD_RETIRE_TIMEOUT = 20000   ///< How long an idle thread will wait for a new task before retiring.
         };
 
+        /**
+         * @brief Scope guard for marking a blocking region in a task.
+         *
+         * While a task running in the pool is blocked, for example waiting on
+         * file I/O, the pool may start a compensating thread so that queued
+         * tasks can make progress. When the scope ends the pool shrinks back
+         * to its maximum size as soon as the extra thread finishes its task.
+         * The guard must only be used from a task executing in the pool. A
+         * guard entered from any other thread has no effect.
+         */
+        class BlockingScope
+        {
+        private:
+            ThreadPool &pool_;
+            bool counted_;      ///< Set to true if the pool counted the scope.
+
+            BlockingScope(const BlockingScope &rhs);
+            BlockingScope &operator=(const BlockingScope &rhs);
+
+        public:
+            /**
+             * Marks the beginning of a blocking region in the default pool.
+             */
+            BlockingScope();
+
+            /**
+             * Marks the beginning of a blocking region.
+             * @param [in] pool The pool executing the current task.
+             */
+            explicit BlockingScope(ThreadPool &pool);
+
+            /**
+             * Marks the end of the blocking region.
+             */
+            ~BlockingScope();
+        };
+
     private:
         /**
          * @brief Internal thread class.
@@ -59,6 +103,8 @@ namespace ckcore
 
         public:
             Task *task_;
+            ThreadAttributes attr_;     ///< Attributes used when starting the thread.
+            thandle id_;                ///< Identifier of the running thread, NULL when not running.
 
             /**
              * Constructs an internal thread object.
@@ -69,11 +115,13 @@ namespace ckcore
         };
 
     private:
+        const tstring name_;    ///< Pool name.
         bool exiting_;          ///< Set to true when thread pool is exiting.
         const tuint32 max_threads_;   ///< Maximum number of threads.
         tuint32 pol_threads_;   ///< Number of active threads in the pool.
         tuint32 res_threads_;   ///< Number of reserved threads.
         tuint32 idl_threads_;   ///< Number of idle threads.
+        tuint32 blk_threads_;   ///< Number of threads blocked in a BlockingScope.
         thread::Mutex mutex_;
 
         thread::WaitCondition task_ready_;          ///< Signaled to a thread when a task is ready for execution.
@@ -83,8 +131,13 @@ namespace ckcore
 
         tuint32 ret_timeout_;   ///< How long a thread can indle before being retired.
 
+        ThreadAttributes thr_attr_; ///< Attributes of new threads.
+        bool pin_threads_;      ///< Set to true to pin each thread to one processor.
+
         std::priority_queue<std::pair<Task *,tuint32> > queue_;
 
+        TimerWheel timers_;     ///< Delayed and periodic tasks.
+
         /**
          * Puts a task into the work queue.
          * @param [in] task Task to enqueue.
@@ -92,6 +145,13 @@ namespace ckcore
          */
         void enqueue(Task *task,tuint32 priority = 0);
 
+        /**
+         * Wakes up a number of threads waiting for new tasks.
+         * @param [in] count The number of threads to wake up.
+         * @param [in] waiting The number of threads currently waiting.
+         */
+        void wake(tuint32 count,tuint32 waiting);
+
         /**
          * Spawn a new thread and start executing the task.
          * @param [in] task The task to execute.
@@ -100,6 +160,13 @@ namespace ckcore
          */
         bool spawn(Task *task);
 
+        /**
+         * Returns the attributes to use for a new thread.
+         * @param [in] index The thread index in the pool.
+         * @return The thread attributes.
+         */
+        ThreadAttributes thread_attributes(tuint32 index) const;
+
         /**
          * Check if we're currently serving more threads than we should. This may
          * happen if threads are reserved while executing tasks.
@@ -111,36 +178,83 @@ namespace ckcore
          * Tries to start the specified task immediately. If that's not possible
          * the function will fail.
          * @param [in] task The task to execute.
+         * @param [in] priority The task priority.
+         * @param [in,out] wakeups If not NULL, tasks handed to idle threads
+         *                         will not signal the threads. Instead the
+         *                         counter is incremented and the caller is
+         *                         responsible for waking the threads.
          * @return If the task was started true is returned, otherwise false is
          *         returned.
          */
-        bool try_start(Task *);
+        bool try_start(Task *task,tuint32 priority = 0,tuint32 *wakeups = NULL);
 
         /**
-         * Constructs a thread pool object. The pool will configure itself to
-         * handle the ideal number of threads for the current system. That is the
-         * ideal number of threads the system can execute in parallel.
+         * Checks if the calling thread is one of the pool threads. The pool
+         * mutex must be held.
+         * @return If the calling thread belongs to the pool true is returned,
+         *         otherwise false is returned.
          */
-        ThreadPool();
-        ThreadPool(const ThreadPool &rhs);
+        bool is_pool_thread() const;
 
         /**
-         * Destructs the thread pool object.
+         * Called when a thread enters a blocking region. If there are queued
+         * tasks the top priority task is started in place of the blocked
+         * thread.
+         * @return If the calling thread is a pool thread and the region was
+         *         counted true is returned, otherwise false is returned.
          */
-        ~ThreadPool();
+        bool begin_blocking();
+
+        /**
+         * Called when a thread leaves a blocking region.
+         */
+        void end_blocking();
+
+        ThreadPool(const ThreadPool &rhs);
         ThreadPool &operator=(const ThreadPool &rhs);
 
     public:
+        /**
+         * Constructs a thread pool object.
+         * @param [in] name The pool name.
+         * @param [in] max_threads The maximum number of threads the pool may
+         *                         run in parallel. If zero the pool will
+         *                         configure itself to handle the ideal number
+         *                         of threads for the current system.
+         * @param [in] ret_timeout How long in milliseconds an idle thread will
+         *                         wait for a new task before retiring.
+         */
+        ThreadPool(const tchar *name,tuint32 max_threads = 0,
+                   tuint32 ret_timeout = THREAD_RETIRE_TIMEOUT);
+
+        /**
+         * Destructs the thread pool object. Waits for all tasks to finish.
+         */
+        ~ThreadPool();
+
         /**
          * Returns the single instance to the thread pool.
          * @return The single instance to the thread pool.
          */
         static ThreadPool &instance();
 
+        /**
+         * Returns the pool name.
+         * @return The pool name.
+         */
+        const tstring &name() const;
+
+        /**
+         * Returns the maximum number of threads the pool will run in parallel.
+         * @return The maximum number of threads.
+         */
+        tuint32 max_threads() const;
+
         /**
          * Returns the total number of active threads in the application. This is
          * the number of threads used by the pool plus the number of reserved
-         * threads.
+         * threads. Threads blocked in a BlockingScope are not considered
+         * active.
          * @return The total number of active threads.
          */
         tuint32 active_threads() const;
@@ -157,6 +271,12 @@ namespace ckcore
          */
         tuint32 retired_threads() const;
 
+        /**
+         * Returns the number of threads currently blocked in a BlockingScope.
+         * @return The number of blocked threads.
+         */
+        tuint32 blocked_threads() const;
+
         /**
          * Returns the number of queued tasks that are not yet assigned to a
          * thread.
@@ -166,13 +286,34 @@ namespace ckcore
 
         /**
          * Tries to start the specified task immediately, if that's not possible
-         * it will be queued with the specified task priority.
+         * it will be queued with the specified task priority. Queued tasks
+         * whose cancellation token is cancelled are dropped without being
+         * started.
          * @param [in] task The task to execute.
          * @param [in] priority The task priority.
          * @return If successful true is returned, otherwise false is returned.
          */
         bool start(Task *task,tuint32 priority = 0);
 
+        /**
+         * Starts a batch of tasks. This is equivalent to calling start() for
+         * each task but the pool is only locked once and idle threads are
+         * woken up together rather than once per task.
+         * @param [in] tasks Array of tasks to execute, NULL entries are ignored.
+         * @param [in] count The number of tasks in the array.
+         * @param [in] priority The priority of all tasks.
+         * @return If successful true is returned, otherwise false is returned.
+         */
+        bool start_batch(Task *const *tasks,size_t count,tuint32 priority = 0);
+
+        /**
+         * Starts a batch of tasks.
+         * @param [in] tasks Vector of tasks to execute.
+         * @param [in] priority The priority of all tasks.
+         * @return If successful true is returned, otherwise false is returned.
+         */
+        bool start_batch(const std::vector<Task *> &tasks,tuint32 priority = 0);
+
         /**
          * Executes the specified task immediatly if there is a free thread
          * available. If there is no free thread available so that the task can
@@ -184,6 +325,41 @@ namespace ckcore
          */
         bool start_now(Task *task);
 
+        /**
+         * Starts the specified task after a delay. The task is owned by the
+         * pool from the time it's scheduled, just as with start().
+         * @param [in] task The task to execute.
+         * @param [in] delay Time in milliseconds to wait before starting the
+         *                   task.
+         * @param [in] priority The task priority.
+         * @return If successful true is returned, if the task is already
+         *         scheduled false is returned.
+         */
+        bool start_after(Task *task,tuint32 delay,tuint32 priority = 0);
+
+        /**
+         * Starts the specified task periodically until it's cancelled using
+         * cancel_timer() or its cancellation token is cancelled. The first run
+         * happens after one period. If a run is still executing when the next
+         * one is due, that run is skipped. The task should not be
+         * automatically deleted until it's cancelled, it's deleted when
+         * cancelled if automatic deletion is enabled.
+         * @param [in] task The task to execute.
+         * @param [in] period Time in milliseconds between runs.
+         * @param [in] priority The task priority.
+         * @return If successful true is returned, otherwise false is returned.
+         */
+        bool start_every(Task *task,tuint32 period,tuint32 priority = 0);
+
+        /**
+         * Cancels a task scheduled using start_after() or start_every(). Tasks
+         * that have already been started are not affected.
+         * @param [in] task The task to cancel.
+         * @return If the task was scheduled true is returned, otherwise false
+         *         is returned.
+         */
+        bool cancel_timer(Task *task);
+
         /**
          * Waits for all tasks to finish and shutdown all threads essentially
          * restoing the thread pool. This does not reset the number of reserved
@@ -202,6 +378,25 @@ namespace ckcore
          * @param [in] timeout New timeout in milliseconds.
          */
         void set_retire_timeout(tuint32 timeout);
+
+        /**
+         * Sets the attributes of threads started by the pool. Threads already
+         * started are not affected. If no thread name is specified the
+         * threads will be named after the pool.
+         * @param [in] attr The thread attributes.
+         */
+        void set_thread_attributes(const ThreadAttributes &attr);
+
+        /**
+         * Enables or disables pinning of threads. When enabled each new
+         * thread is bound to a single processor, distributing the threads
+         * over all processors. Since memory is allocated from the node local
+         * to the processor first touching it, buffers allocated by tasks will
+         * be NUMA local.
+         * @param [in] enable Set to true to enable pinning and false to
+         *                    disable it.
+         */
+        void set_thread_pinning(bool enable);
     };
 }
 
@@ -0,0 +1,249 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/timerwheel.hh
+ * @brief Timer wheel for scheduling delayed and periodic tasks.
+ */
+
+#pragma once
+#include <map>
+#include <vector>
+#include "ckcore/types.hh"
+#include "ckcore/task.hh"
+#include "ckcore/thread.hh"
+
+namespace ckcore
+{
+    class ThreadPool;
+
+    /**
+     * @brief Hierarchical timer wheel starting tasks in a thread pool.
+     *
+     * Timers are kept in a number of wheels with increasing resolution,
+     * timers far in the future are cascaded down to the finer wheels as time
+     * progresses. This makes adding, cancelling and expiring timers constant
+     * time operations. All timers are served by a single thread which is
+     * started when the first timer is added.
+     */
+    class TimerWheel
+    {
+    public:
+        /**
+         * @brief Defines constants specifying the class behaviour.
+         */
+        enum
+        {
+            TICK_INTERVAL = 10,     ///< Timer resolution in milliseconds.
+            WHEEL_BITS = 6,         ///< Number of bits indexing a wheel.
+            WHEEL_SIZE = 1 << WHEEL_BITS,   ///< Number of slots in each wheel.
+            WHEEL_MASK = WHEEL_SIZE - 1,
+            WHEEL_LEVELS = 4        ///< Number of wheels.
+        };
+
+    private:
+        /**
+         * @brief Timer entry.
+         */
+        class Timer
+        {
+        public:
+            Timer *prev_;
+            Timer *next_;
+            Timer **head_;          ///< The wheel slot containing the timer.
+
+            Task *task_;
+            tuint64 expires_;       ///< Expiration time in ticks.
+            tuint32 period_;        ///< Period in ticks, zero for one-shot timers.
+            tuint32 priority_;
+            bool running_;          ///< Set to true while a periodic task is executing.
+            bool cancelled_;        ///< Set to true when cancelled while running.
+
+            /**
+             * Constructs a timer entry.
+             * @param [in] task The task to start when the timer expires.
+             */
+            Timer(Task *task);
+
+            /**
+             * Destructs the timer entry and deletes the task if it should be
+             * automatically deleted.
+             */
+            ~Timer();
+        };
+
+        /**
+         * @brief Task executing one run of a periodic timer.
+         *
+         * Periodic tasks are not started directly in the pool, instead they're
+         * wrapped in a runner so that the wheel knows when the task has
+         * finished executing and never starts the same task concurrently.
+         */
+        class Runner : public Task
+        {
+        private:
+            TimerWheel &host_;
+            Timer *timer_;
+
+        public:
+            /**
+             * Constructs a runner object.
+             * @param [in] host The hosting timer wheel.
+             * @param [in] timer The timer to run.
+             */
+            Runner(TimerWheel &host,Timer *timer);
+
+            /**
+             * Executes the periodic task.
+             */
+            void start();
+        };
+
+        /**
+         * @brief Timer thread class.
+         */
+        class TimerThread : public Thread
+        {
+        private:
+            TimerWheel &host_;
+
+            /**
+             * Executes the thread.
+             */
+            void run();
+
+        public:
+            /**
+             * Constructs a timer thread object.
+             * @param [in] host The hosting timer wheel.
+             */
+            TimerThread(TimerWheel &host);
+        };
+
+    private:
+        ThreadPool &pool_;
+        TimerThread thread_;
+        bool exiting_;          ///< Set to true when the timer thread should exit.
+        tuint64 cur_tick_;      ///< Current time in ticks.
+
+        mutable thread::Mutex mutex_;
+        thread::WaitCondition timer_added_;
+
+        Timer *wheels_[WHEEL_LEVELS][WHEEL_SIZE];
+        std::map<Task *,Timer *> timers_;   ///< All timers by task.
+
+        TimerWheel(const TimerWheel &rhs);
+        TimerWheel &operator=(const TimerWheel &rhs);
+
+        /**
+         * Returns the current system time in ticks.
+         * @return The current time in ticks.
+         */
+        static tuint64 now();
+
+        /**
+         * Inserts a timer into the wheel slot matching its expiration time.
+         * @param [in] timer The timer to insert.
+         */
+        void insert(Timer *timer);
+
+        /**
+         * Removes a timer from its wheel slot.
+         * @param [in] timer The timer to remove.
+         */
+        void unlink(Timer *timer);
+
+        /**
+         * Moves all timers from a slot in a coarse wheel to finer wheels.
+         * @param [in] level The wheel level.
+         * @param [in] index The slot index.
+         */
+        void cascade(int level,tuint32 index);
+
+        /**
+         * Advances the wheel to the current time and collects the expired
+         * timers.
+         * @param [out] expired The expired timers.
+         */
+        void advance(std::vector<Timer *> &expired);
+
+        /**
+         * Calculates the number of ticks until the wheel needs to be
+         * advanced again.
+         * @return The number of ticks to wait.
+         */
+        tuint32 ticks_until_next() const;
+
+        /**
+         * Called by a periodic timer when its task has finished executing.
+         * @param [in] timer The timer.
+         */
+        void finished(Timer *timer);
+
+        /**
+         * The timer thread main loop.
+         */
+        void run();
+
+    public:
+        /**
+         * Constructs a timer wheel object.
+         * @param [in] pool The thread pool to start expired tasks in.
+         */
+        TimerWheel(ThreadPool &pool);
+
+        /**
+         * Destructs the timer wheel object, stopping all timers.
+         */
+        ~TimerWheel();
+
+        /**
+         * Adds a timer for the specified task.
+         * @param [in] task The task to start when the timer expires.
+         * @param [in] delay Time in milliseconds until the task is started.
+         * @param [in] period Time in milliseconds between subsequent starts
+         *                    of the task, zero for tasks that should only
+         *                    be started once.
+         * @param [in] priority The task priority.
+         * @return If successful true is returned, if the task is already
+         *         scheduled false is returned.
+         */
+        bool add(Task *task,tuint32 delay,tuint32 period,tuint32 priority);
+
+        /**
+         * Cancels the timer of the specified task. If the task should be
+         * automatically deleted it's deleted, periodic tasks executing at the
+         * time are deleted as soon as they finish.
+         * @param [in] task The task to cancel.
+         * @return If the task was scheduled true is returned, otherwise false
+         *         is returned.
+         */
+        bool cancel(Task *task);
+
+        /**
+         * Cancels all timers and stops the timer thread.
+         */
+        void stop();
+
+        /**
+         * Returns the number of scheduled timers.
+         * @return The number of scheduled timers.
+         */
+        tuint32 pending() const;
+    };
+}
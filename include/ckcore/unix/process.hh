@@ -21,20 +21,171 @@
  * @brief Defines the Unix process class.
  */
 #pragma once
+#include <map>
 #include <vector>
-#include <set>
 #include "ckcore/types.hh"
+#include "ckcore/file.hh"
 #include "ckcore/stream.hh"
+#include "ckcore/thread.hh"
 
 namespace ckcore
 {
     /**
      * @brief The class for creating processes on Unix.
+     *
+     * The output of all processes is monitored by a single shared reactor
+     * thread which also delivers the output and finish events. On Linux the
+     * process exit is detected through a process file descriptor monitored by
+     * the reactor, on other systems a SIGCHLD handler is used to wake the
+     * reactor.
+     *
+     * Since the events of all processes are delivered by the same thread the
+     * event functions must return quickly, a slow event function delays the
+     * events of every other process. Lengthy work should be handed over to a
+     * ThreadPool. Waiting for another process from an event function would
+     * deadlock, wait() fails immediately when called from the reactor thread.
+     * Destroying a running process from an event function detaches it, no
+     * further events are delivered and the child is reaped in the background.
      */
     class Process : public OutStream
     {
     public:
         friend class ProcessMonitor;
+        friend class ProcessPipeline;
+
+        /**
+         * @brief Resource usage of a finished process.
+         */
+        struct Usage
+        {
+            ckcore::tuint64 user_time_;     ///< Time spent in user mode in microseconds.
+            ckcore::tuint64 system_time_;   ///< Time spent in kernel mode in microseconds.
+            ckcore::tuint64 max_rss_;       ///< Peak resident set size in bytes, zero if unknown.
+            ckcore::tuint64 block_input_;   ///< Number of block input operations.
+            ckcore::tuint64 block_output_;  ///< Number of block output operations.
+            ckcore::tuint64 voluntary_switches_;    ///< Number of voluntary context switches.
+            ckcore::tuint64 involuntary_switches_;  ///< Number of involuntary context switches.
+        };
+
+        /**
+         * @brief I/O scheduling classes, see ioprio_set(2). Only supported on
+         *        Linux.
+         */
+        enum IoClass
+        {
+            IO_CLASS_NONE = 0,
+            IO_CLASS_REALTIME = 1,
+            IO_CLASS_BEST_EFFORT = 2,
+            IO_CLASS_IDLE = 3
+        };
+
+        /**
+         * @brief Defines constants for resource limits.
+         */
+        enum
+        {
+            LIMIT_INFINITY = -1     ///< No limit, see set_limit().
+        };
+
+        /**
+         * Defines the type of functions notified when a process has finished.
+         * @param [in] param The parameter passed to notify_finished().
+         */
+        typedef void (*tcallback)(void *param);
+
+        /**
+         * @brief Block of process output.
+         *
+         * The block refers to an internal buffer and is only valid during the
+         * call to event_output_batch.
+         */
+        struct Block
+        {
+            const char *data_;      ///< Pointer to the first character, not null terminated.
+            size_t size_;           ///< Number of characters in the block.
+        };
+
+        /**
+         * @brief Defines how new processes are started.
+         */
+        enum Launcher
+        {
+            LAUNCHER_SPAWN,     ///< Use posix_spawn(), or clone() on Linux if options are set. fork() is used if not supported.
+            LAUNCHER_FORK       ///< Use fork() followed by execv().
+        };
+
+        /**
+         * @brief Stream for reading the raw standard output of a process.
+         *
+         * The stream reads directly from the output pipe, reading blocks until
+         * data is available. It remains readable after the process has
+         * finished until the next process is created.
+         */
+        class OutputStream : public InStream
+        {
+        private:
+            friend class Process;
+
+            int fd_;
+            unsigned char peek_;    ///< Character read ahead by end().
+            bool peeked_;
+            bool end_;
+
+            OutputStream(const OutputStream &rhs);
+            OutputStream &operator=(const OutputStream &rhs);
+
+            /**
+             * Closes the current pipe and starts reading from a new one.
+             * @param [in] fd The pipe file descriptor, the stream takes
+             *                ownership of it.
+             */
+            void reset(int fd);
+
+        public:
+            /**
+             * Constructs an OutputStream object.
+             */
+            OutputStream();
+
+            /**
+             * Destructs the OutputStream object, closing the pipe.
+             */
+            ~OutputStream();
+
+            /**
+             * Reads raw data from the process standard output.
+             * @param [out] buffer Pointer to the beginning of buffer to read to.
+             * @param [in] count The number of bytes to read.
+             * @return If the operation failed -1 is returned, otherwise the
+             *         function returns the number of bytes read (this may be
+             *         zero).
+             */
+            tint64 read(void *buffer,tuint32 count);
+
+            /**
+             * Returns -1 since the size of the output is unknown.
+             * @return -1.
+             */
+            tint64 size();
+
+            /**
+             * Checks if the end of the output has been reached, waiting for
+             * data if necessary.
+             * @return If the process has closed its standard output and all
+             *         data has been read true is returned, otherwise false is
+             *         returned.
+             */
+            bool end();
+
+            /**
+             * Skips data in the output. Only ckSTREAM_CURRENT is supported.
+             * @param [in] distance The number of bytes to skip.
+             * @param [in] whence Must be ckSTREAM_CURRENT.
+             * @return If successful true is returned, otherwise false is
+             *         returned.
+             */
+            bool seek(tuint32 distance,StreamWhence whence);
+        };
 
     protected:
         volatile bool invalid_inheritor_;   // Set to true to indicate that the
@@ -52,7 +203,9 @@ namespace ckcore
         enum
         {
             MAX_ARG_COUNT = 127,
-            READ_BUFFER_SIZE = 128
+            READ_BUFFER_SIZE = 65536,
+            FEED_PIPE_SIZE = 1 << 20,       // Requested standard input pipe size when feeding.
+            FEED_BUFFER_SIZE = 65536
         };
 
         enum State
@@ -68,10 +221,35 @@ namespace ckcore
         volatile pid_t pid_;            // Process identifier.
         volatile State state_;          // Process state.
         volatile ckcore::tuint32 exit_code_;    // Process exit code (if exited).
+        bool exited_;                   // Set when the process has been reaped.
+        int pid_fd_;                    // Process file descriptor, -1 if not used.
+        Usage usage_;                   // Resource usage (if exited).
+        Launcher launcher_;
+        bool raw_output_;               // Set if standard output is read through output_stream_.
 
-        std::set<char> block_delims_;
+        // Options applied to new processes.
+        bool nice_set_;
+        int nice_;
+        IoClass io_class_;
+        int io_level_;
+        std::vector<unsigned int> affinity_;
+        std::map<int,std::pair<ckcore::tuint64,ckcore::tuint64> > limits_;
+        std::vector<int> inherited_fds_;
+        OutputStream output_stream_;
+
+        std::vector<std::pair<tcallback,void *> > finish_callbacks_;    // Called when the process has finished.
+
+        bool delim_table_[256];         // Set for each character that is a block delimiter.
+        unsigned int delim_count_;      // Number of block delimiters.
+        char single_delim_;             // The delimiter if there's only one.
         std::string block_buffer_out_;  // For buffering partial standard output blocks before commiting them.
         std::string block_buffer_err_;  // For buffering partial standard error blocks before commiting them.
+        std::vector<Block> blocks_;
+
+        /**
+         * Closes all internal pipes. The caller must hold mutex_.
+         */
+        void close_pipes();
 
         /**
          * Closes all internal pipes and resets the internal state of the object.
@@ -79,33 +257,90 @@ namespace ckcore
         void close();
 
         /**
-         * Reads from the specified file descriptor to the standard output buffer.
-         * @return If successful true is returned, if unsuccessful false is
-         *         returned.
+         * Finds the first block delimiter in a range of characters.
+         * @param [in] begin Pointer to the first character.
+         * @param [in] end Pointer past the last character.
+         * @return Pointer to the delimiter, or end if there is none.
          */
-        bool read_stdout(int fd);
+        const char *find_delim(const char *begin,const char *end) const;
 
         /**
-         * Reads from the specified file descriptor to the standard error buffer.
+         * Reads from the specified file descriptor and delivers all complete
+         * blocks in a single event_output_batch call.
+         * @param [in] fd The file descriptor to read from.
+         * @param [in,out] block_buffer Buffer holding the partial block from
+         *                              the previous read.
          * @return If successful true is returned, if unsuccessful false is
          *         returned.
          */
-        bool read_stderr(int fd);
+        bool read_blocks(int fd,std::string &block_buffer);
 
         // For multi-threading.
-        pthread_mutex_t mutex_;
-        pthread_mutex_t mutex_exec_;    // This mutex will be locked through the entire execution.
+        mutable thread::Mutex mutex_;
+        mutable thread::WaitCondition finished_cond_;   // Signaled when the process has finished.
 
         /**
-         * The thread entry for listening on the process output pipes.
+         * Reactor callback called when an output pipe is readable or has been
+         * closed.
          * @param [in] param A pointer to the Process object being executed.
+         * @param [in] fd The ready file descriptor.
+         */
+        static void output_ready(void *param,int fd);
+
+        /**
+         * Reads available data from an output pipe, closing the pipe when the
+         * other end has been closed.
+         * @param [in] fd The pipe file descriptor.
+         * @param [in] drain Set to true to read until no more data is
+         *                   available rather than performing a single read.
          */
-        static void *listen(void *param);
+        void read_output(int fd,bool drain);
 
-        // For signaling that the process has been started.
-        pthread_mutex_t started_mutex_;
-        pthread_cond_t started_cond_;
-        bool started_event_;
+        /**
+         * Stops monitoring and closes an output pipe.
+         * @param [in,out] fd The pipe file descriptor, set to -1.
+         */
+        void close_output(int &fd);
+
+        /**
+         * Reactor callback called when the process file descriptor becomes
+         * readable, meaning that the process has exited.
+         * @param [in] param A pointer to the Process object being executed.
+         * @param [in] fd The process file descriptor.
+         */
+        static void pid_ready(void *param,int fd);
+
+        /**
+         * Called when the process has been reaped.
+         * @param [in] status The status returned by wait4, -1 if unknown.
+         * @param [in] usage The resource usage of the process.
+         */
+        void exited(int status,const Usage &usage);
+
+        /**
+         * Stops monitoring the running process without waiting for it. Must
+         * be called on the reactor thread.
+         */
+        void detach();
+
+        /**
+         * Completes the execution if the process has exited and all output
+         * pipes have been closed.
+         */
+        void try_finish();
+
+        /**
+         * Creates a new process with optional redirection of its standard
+         * input and output.
+         * @param [in] cmd_line The complete command line to execute.
+         * @param [in] stdin_fd Descriptor to use as standard input, -1 to
+         *                      create a pipe written through this object.
+         * @param [in] stdout_fd Descriptor to use as standard output, -1 to
+         *                       create a pipe read by this object.
+         * @return If successful true is returned, if unsuccessful false is
+         *         returned.
+         */
+        bool create(const tchar *cmd_line,int stdin_fd,int stdout_fd);
 
         /**
          * Parses the specified command line into a vector of command line arguments.
@@ -121,7 +356,9 @@ namespace ckcore
         Process();
 
         /**
-         * Destructs the Process object.
+         * Destructs the Process object. Waits for the running process to
+         * complete unless called from an event function, in which case the
+         * process is detached.
          */
         virtual ~Process();
 
@@ -141,9 +378,12 @@ namespace ckcore
         bool running() const;
 
         /**
-         * Wait until the running process completes.
-         * @return If successful and a process is running true is returned,
-         *         otherwise false is returned.
+         * Wait until the running process completes. Waiting from an event
+         * function of any process would deadlock the reactor thread, the
+         * function then fails immediately if the process is still running.
+         * @return If the process has completed true is returned, if called
+         *         from an event function while the process is running false
+         *         is returned.
          */
         bool wait() const;
 
@@ -161,6 +401,100 @@ namespace ckcore
          */
         bool exit_code(ckcore::tuint32 &exit_code) const;
 
+        /**
+         * Obtains the resource usage of the process.
+         * @param [out] usage The resource usage of the process.
+         * @return If the process has finished true is returned, if not false
+         *         is returned.
+         */
+        bool usage(Usage &usage) const;
+
+        /**
+         * Registers a function to call once when the running process has
+         * finished, after event_finished() has been called. The function is
+         * called from the thread delivering the process events and must not
+         * block. The object may already have been destroyed when the function
+         * is called.
+         * @param [in] callback The function to call.
+         * @param [in] param Parameter to pass to the callback.
+         * @return If a process is running and the function was registered
+         *         true is returned, otherwise false is returned and the
+         *         function will not be called.
+         */
+        bool notify_finished(tcallback callback,void *param);
+
+        /**
+         * Selects how new processes are started, posix_spawn() is used by
+         * default.
+         * @param [in] launcher The launch method.
+         */
+        void set_launcher(Launcher launcher);
+
+        /**
+         * Sets the nice level of new processes.
+         * @param [in] nice The nice level, -20 to 19.
+         */
+        void set_nice(int nice);
+
+        /**
+         * Sets the I/O scheduling class and priority of new processes. This is
+         * only supported on Linux.
+         * @param [in] io_class The I/O scheduling class.
+         * @param [in] level The priority within the class, 0 (highest) to 7.
+         */
+        void set_io_priority(IoClass io_class,int level = 4);
+
+        /**
+         * Restricts new processes to the specified processors. This is only
+         * supported on Linux.
+         * @param [in] cpus The indices of the processors to run on, an empty
+         *                  vector removes the restriction.
+         */
+        void set_affinity(const std::vector<unsigned int> &cpus);
+
+        /**
+         * Sets a resource limit of new processes, see setrlimit(2). Unlike
+         * the scheduling options, processes fail to start if a limit can't be
+         * applied. With the fork launcher the failure can't be reported to
+         * the parent, the process exits with a non-zero exit code instead.
+         * @param [in] resource The resource, for example RLIMIT_AS.
+         * @param [in] soft The soft limit, or LIMIT_INFINITY.
+         * @param [in] hard The hard limit, or LIMIT_INFINITY.
+         */
+        void set_limit(int resource,ckcore::tuint64 soft,ckcore::tuint64 hard);
+
+        /**
+         * Makes new processes inherit a descriptor of this process under the
+         * same number, for example the handle of a SharedMemoryOutStream.
+         * All other descriptors except standard input, output and error are
+         * closed on exec.
+         * @param [in] fd The descriptor to inherit.
+         */
+        void add_inherited_fd(int fd);
+
+        /**
+         * Removes all scheduling options, resource limits and inherited
+         * descriptors.
+         */
+        void clear_options();
+
+        /**
+         * Selects if the standard output of processes should be split into
+         * blocks delivered through the event functions, or be read as raw data
+         * through output_stream(). Standard error is always delivered through
+         * the event functions. Must be called before creating the process.
+         * @param [in] raw Set to true to read raw standard output.
+         */
+        void set_raw_output(bool raw);
+
+        /**
+         * Returns the stream for reading the raw standard output of the
+         * process, see set_raw_output(). The output should be read before
+         * waiting for the process since it may block when the pipe is full.
+         * @return The standard output stream.
+         */
+        InStream &output_stream();
+
         /**
          * Adds a new block delimiter to be used when splitting process output
          * into blocks.
@@ -186,6 +520,34 @@ namespace ckcore
          */
         tint64 write(const void *buffer,tuint32 count);
 
+        /**
+         * Writes all data from a stream to the process standard input. On
+         * Linux the data is moved into the pipe using vmsplice() to avoid
+         * copying it through the kernel.
+         * @param [in] in The stream to read from.
+         * @return If the operation failed -1 is returned, otherwise the
+         *         function returns the number of bytes written.
+         */
+        tint64 feed(InStream &in);
+
+        /**
+         * Writes the remaining data of an open file to the process standard
+         * input. On Linux the data is moved directly from the file to the pipe
+         * using splice() without passing through user space.
+         * @param [in] file The file to read from, it must be open for reading.
+         * @return If the operation failed -1 is returned, otherwise the
+         *         function returns the number of bytes written.
+         */
+        tint64 feed(File &file);
+
+        /**
+         * Closes the process standard input, letting the process know that no
+         * more data will be written.
+         * @return If successful true is returned, if the standard input
+         *         already has been closed false is returned.
+         */
+        bool close_input();
+
         /**
          * Called when the process has finished.
          */
@@ -197,5 +559,14 @@ namespace ckcore
          * @param [in] block The block that has been read.
          */
         virtual void event_output(const std::string &block) = 0;
+
+        /**
+         * Called when one or more blocks have been read from either standard
+         * output or standard error. The default implementation calls
+         * event_output for each block, inheritors that produce a lot of output
+         * can override this function to avoid copying each block.
+         * @param [in] blocks The blocks that have been read.
+         */
+        virtual void event_output_batch(const std::vector<Block> &blocks);
     };
 }
@@ -0,0 +1,224 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/unix/processpipeline.hh
+ * @brief Defines the Unix process pipeline class.
+ */
+
+#pragma once
+#include <vector>
+#include "ckcore/types.hh"
+#include "ckcore/file.hh"
+#include "ckcore/stream.hh"
+#include "ckcore/process.hh"
+#include "ckcore/thread.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Class for running a chain of processes like a shell pipeline.
+     *
+     * The standard output of each process is connected directly to the
+     * standard input of the next process so the data never passes through
+     * this process. Data written to the pipeline goes to the first process.
+     * The output of the last process and the standard error of all processes
+     * are delivered through the event functions.
+     */
+    class ProcessPipeline : public OutStream
+    {
+    private:
+        /**
+         * @brief A single process in the pipeline.
+         */
+        class Stage : public Process
+        {
+        private:
+            ProcessPipeline &host_;
+
+        public:
+            /**
+             * Constructs a Stage object.
+             * @param [in] host The hosting pipeline.
+             */
+            Stage(ProcessPipeline &host);
+
+            /**
+             * Destructs the Stage object.
+             */
+            ~Stage();
+
+            /**
+             * Called when the process has finished.
+             */
+            void event_finished();
+
+            /**
+             * Called when a block has been read from the process.
+             * @param [in] block The block that has been read.
+             */
+            void event_output(const std::string &block);
+
+            /**
+             * Starts the process.
+             * @param [in] cmd_line The complete command line to execute.
+             * @param [in] stdin_fd Descriptor to use as standard input, -1 to
+             *                      create a pipe.
+             * @param [in] stdout_fd Descriptor to use as standard output, -1
+             *                       to create a pipe.
+             * @return If successful true is returned, if unsuccessful false
+             *         is returned.
+             */
+            bool start(const tchar *cmd_line,int stdin_fd,int stdout_fd);
+        };
+
+        std::vector<Stage *> stages_;
+        tuint32 running_stages_;        ///< Number of stages that have not finished.
+        bool notify_;                   ///< Set when event_finished should be called.
+        thread::Mutex mutex_;
+
+        ProcessPipeline(const ProcessPipeline &rhs);
+        ProcessPipeline &operator=(const ProcessPipeline &rhs);
+
+        /**
+         * Called by each stage when it has finished.
+         */
+        void stage_finished();
+
+        /**
+         * Waits for and deletes all stages.
+         */
+        void clear();
+
+    protected:
+        volatile bool invalid_inheritor_;   // Set to true to indicate that the
+                                            // inheritor is no longer valid and
+                                            // thus the events are purely
+                                            // virtual.
+
+    public:
+        /**
+         * Constructs a ProcessPipeline object.
+         */
+        ProcessPipeline();
+
+        /**
+         * Destructs the ProcessPipeline object, waiting for all processes to
+         * finish.
+         */
+        virtual ~ProcessPipeline();
+
+        /**
+         * Creates the processes of the pipeline.
+         * @param [in] cmd_lines The command lines of the processes in the
+         *                       order data flows through them.
+         * @return If all processes were created true is returned, otherwise
+         *         all created processes are killed and false is returned.
+         */
+        bool create(const std::vector<tstring> &cmd_lines);
+
+        /**
+         * Checks if any process in the pipeline is running.
+         * @return If a process is running true is returned, if not false is
+         *         returned.
+         */
+        bool running() const;
+
+        /**
+         * Waits until all processes have finished. Must not be called from
+         * the event functions.
+         * @return If successful true is returned, otherwise false is returned.
+         */
+        bool wait() const;
+
+        /**
+         * Kills all processes in the pipeline.
+         * @return If any process was killed true is returned, otherwise false
+         *         is returned.
+         */
+        bool kill() const;
+
+        /**
+         * Returns the number of processes in the pipeline.
+         * @return The number of processes.
+         */
+        size_t size() const;
+
+        /**
+         * Obtains the exit code of the last process in the pipeline.
+         * @param [out] exit_code The process exit code.
+         * @return If successful true is returned, if not false is returned.
+         */
+        bool exit_code(tuint32 &exit_code) const;
+
+        /**
+         * Obtains the exit code of a process in the pipeline.
+         * @param [in] index The index of the process.
+         * @param [out] exit_code The process exit code.
+         * @return If successful true is returned, if not false is returned.
+         */
+        bool exit_code(size_t index,tuint32 &exit_code) const;
+
+        /**
+         * Writes raw data to the standard input of the first process.
+         * @param [in] buffer Pointer to the beginning of the buffer
+         *                    containing the data to be written.
+         * @param [in] count The number of bytes to write.
+         * @return If the operation failed -1 is returned, otherwise the
+         *         function returns the number of bytes written.
+         */
+        tint64 write(const void *buffer,tuint32 count);
+
+        /**
+         * Writes all data from a stream to the standard input of the first
+         * process.
+         * @param [in] in The stream to read from.
+         * @return If the operation failed -1 is returned, otherwise the
+         *         function returns the number of bytes written.
+         */
+        tint64 feed(InStream &in);
+
+        /**
+         * Writes the remaining data of an open file to the standard input of
+         * the first process.
+         * @param [in] file The file to read from.
+         * @return If the operation failed -1 is returned, otherwise the
+         *         function returns the number of bytes written.
+         */
+        tint64 feed(File &file);
+
+        /**
+         * Closes the standard input of the first process.
+         * @return If successful true is returned, otherwise false is
+         *         returned.
+         */
+        bool close_input();
+
+        /**
+         * Called when all processes have finished.
+         */
+        virtual void event_finished() = 0;
+
+        /**
+         * Called when a block has been read from the standard output of the
+         * last process or the standard error of any process.
+         * @param [in] block The block that has been read.
+         */
+        virtual void event_output(const std::string &block) = 0;
+    };
+}
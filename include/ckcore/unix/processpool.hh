@@ -0,0 +1,308 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/unix/processpool.hh
+ * @brief Defines the Unix process pool class.
+ */
+
+#pragma once
+#include <queue>
+#include <string>
+#include <vector>
+#include "ckcore/types.hh"
+#include "ckcore/mpmcqueue.hh"
+#include "ckcore/process.hh"
+#include "ckcore/task.hh"
+#include "ckcore/thread.hh"
+#include "ckcore/threadpool.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Class for keeping a number of helper processes ready for work.
+     *
+     * Starting a process, executing and linking the program often costs more
+     * than the work the process does. The pool keeps a number of instances
+     * of the same command running and hands jobs to idle instances through
+     * their standard input and output. Each instance is replaced after a
+     * number of jobs to keep leaks in the helper from accumulating.
+     *
+     * Jobs are queued by priority and executed as tasks in a thread pool,
+     * one task per job. Jobs of the default priority are kept in a ring in
+     * the order they were started, only jobs with a higher priority need to
+     * be sorted. Requests and responses are framed by a four byte
+     * big endian length followed by the payload. The helper must read
+     * request frames from its standard input until it's closed, answering
+     * each request with exactly one response frame on its standard output.
+     * Anything written to standard error is discarded.
+     */
+    class ProcessPool
+    {
+    public:
+        /**
+         * @brief Defines constants specifying the class behaviour.
+         */
+        enum
+        {
+            FRAME_HEADER_SIZE = 4,
+            MAX_FRAME_SIZE = 64 * 1024 * 1024,  ///< Largest accepted response.
+            JOB_RING_SIZE = 1024                ///< Default priority jobs queued without sorting.
+        };
+
+        /**
+         * @brief Job interface.
+         */
+        class Job
+        {
+        private:
+            bool auto_delete_;
+
+        public:
+            Job() : auto_delete_(true) {}
+            virtual ~Job() {}
+
+            /**
+             * Called by the pool to obtain the request to send to the
+             * helper.
+             * @param [out] request The request payload.
+             */
+            virtual void request(std::string &request) = 0;
+
+            /**
+             * Called when the job has finished.
+             * @param [in] success Set to true if the helper answered the
+             *                     request and false if it failed to start,
+             *                     exited or sent a malformed frame.
+             * @param [in] response The response payload.
+             */
+            virtual void event_finished(bool success,const std::string &response) = 0;
+
+            /**
+             * Check whether the job should be automatically deleted after
+             * it has finished.
+             * @return If the job should be automatically deleted true is
+             *         returned, if not false is returned.
+             */
+            bool auto_delete() const
+            {
+                return auto_delete_;
+            }
+
+            /**
+             * Sets whether to automatically delete the job after it has
+             * finished or not.
+             * @param [in] enable Set to true to enable automatic deletion and
+             *                    false to disable it.
+             */
+            void set_auto_delete(bool enable)
+            {
+                auto_delete_ = enable;
+            }
+        };
+
+    private:
+        /**
+         * @brief A single helper process.
+         */
+        class Worker : public Process
+        {
+        public:
+            tuint32 jobs_;          ///< Number of jobs run by the current instance.
+
+            /**
+             * Constructs a Worker object.
+             */
+            Worker();
+
+            /**
+             * Destructs the Worker object.
+             */
+            ~Worker();
+
+            /**
+             * Called when the process has finished.
+             */
+            void event_finished();
+
+            /**
+             * Called when a block has been read from standard error.
+             * @param [in] block The block that has been read.
+             */
+            void event_output(const std::string &block);
+        };
+
+        /**
+         * @brief Task running a single job in the thread pool.
+         */
+        class Runner : public Task
+        {
+        private:
+            ProcessPool &host_;
+            Worker *worker_;
+            Job *job_;
+
+        public:
+            /**
+             * Constructs a Runner object.
+             * @param [in] host The hosting process pool.
+             * @param [in] worker The worker to run the job on.
+             * @param [in] job The job to run.
+             */
+            Runner(ProcessPool &host,Worker *worker,Job *job);
+
+            /**
+             * Runs the job.
+             */
+            void start();
+        };
+
+        /**
+         * @brief A job waiting for an idle worker.
+         */
+        struct QueuedJob
+        {
+            Job *job_;
+            tuint32 priority_;
+            tuint64 sequence_;      ///< Keeps jobs of equal priority in order.
+
+            bool operator<(const QueuedJob &rhs) const
+            {
+                if (priority_ != rhs.priority_)
+                    return priority_ < rhs.priority_;
+
+                return sequence_ > rhs.sequence_;
+            }
+        };
+
+        const tstring cmd_line_;
+        const tuint32 max_jobs_;
+        ThreadPool &pool_;
+
+        std::vector<Worker *> workers_;
+        std::vector<Worker *> idle_workers_;
+        std::priority_queue<QueuedJob> queue_;
+        MpmcQueue<Job *> ring_;     ///< Queued jobs of the default priority.
+        tuint32 ring_overflow_;     ///< Default priority jobs in queue_ since the ring was full.
+        tuint64 sequence_;
+        tuint32 busy_workers_;  ///< Number of workers running a job.
+
+        mutable thread::Mutex mutex_;
+        mutable thread::WaitCondition idle_cond_;
+
+        ProcessPool(const ProcessPool &rhs);
+        ProcessPool &operator=(const ProcessPool &rhs);
+
+        /**
+         * Makes sure that the worker process is running.
+         * @param [in] worker The worker.
+         * @return If the process is running true is returned, otherwise
+         *         false is returned.
+         */
+        bool launch(Worker &worker);
+
+        /**
+         * Sends a request to a worker and reads its response.
+         * @param [in] worker The worker.
+         * @param [in] request The request payload.
+         * @param [out] response The response payload.
+         * @return If successful true is returned, otherwise false is
+         *         returned.
+         */
+        bool transact(Worker &worker,const std::string &request,
+                      std::string &response);
+
+        /**
+         * Queues a job until a worker becomes idle. Must be called with the
+         * mutex locked.
+         * @param [in] job The job to queue.
+         * @param [in] priority The job priority.
+         */
+        void queue_job(Job *job,tuint32 priority);
+
+        /**
+         * Takes the next job from the queue. Must be called with the mutex
+         * locked.
+         * @param [out] next The next job.
+         * @return If a job was queued true is returned, otherwise false is
+         *         returned.
+         */
+        bool next_job(QueuedJob &next);
+
+        /**
+         * Runs a job on a worker and hands the worker the next queued job.
+         * @param [in] worker The worker.
+         * @param [in] job The job to run.
+         */
+        void run(Worker *worker,Job *job);
+
+    public:
+        /**
+         * Constructs a ProcessPool object. No processes are started until
+         * create() is called or the first job is started.
+         * @param [in] cmd_line The command line of the helper.
+         * @param [in] size The number of helper instances.
+         * @param [in] max_jobs The number of jobs after which an instance is
+         *                      replaced, zero to never replace instances.
+         * @param [in] pool The thread pool to run the jobs in.
+         */
+        ProcessPool(const tchar *cmd_line,tuint32 size,tuint32 max_jobs = 0,
+                    ThreadPool &pool = ThreadPool::instance());
+
+        /**
+         * Destructs the ProcessPool object. Waits for all jobs to finish and
+         * for the helpers to exit after their standard input is closed.
+         */
+        ~ProcessPool();
+
+        /**
+         * Starts all helper instances that are not already running.
+         * @return If all instances are running true is returned, otherwise
+         *         false is returned.
+         */
+        bool create();
+
+        /**
+         * Runs a job on the next idle helper. If all helpers are busy the
+         * job is queued with the specified priority.
+         * @param [in] job The job to run.
+         * @param [in] priority The job priority.
+         * @return If successful true is returned, otherwise false is
+         *         returned.
+         */
+        bool start(Job *job,tuint32 priority = 0);
+
+        /**
+         * Waits for all started jobs to finish. Must not be called from a
+         * job.
+         */
+        void wait() const;
+
+        /**
+         * Returns the number of helper instances.
+         * @return The number of helper instances.
+         */
+        tuint32 size() const;
+
+        /**
+         * Returns the number of jobs waiting for an idle helper.
+         * @return The number of queued jobs.
+         */
+        tuint32 queued() const;
+    };
+}
@@ -0,0 +1,389 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file include/ckcore/unix/sharedmemorystream.hh
+ * @brief Stream between processes through a shared memory ring.
+ */
+
+#pragma once
+#include <stddef.h>
+#include "ckcore/types.hh"
+#include "ckcore/stream.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Ring buffer in memory shared between two processes.
+     *
+     * The ring lives in an anonymous memory file, created with memfd_create()
+     * or shm_open() if not available. The other process inherits one end of
+     * a socket pair, see Process::add_inherited_fd(), over which the memory
+     * file is handed over when opening the ring. Like PipeStream the ring is
+     * lock-free, a process only blocks when the ring is full or empty.
+     * Blocking and waking up is done with futexes in the shared memory on
+     * Linux, other systems poll.
+     *
+     * A process that exits without closing its end of the ring is detected
+     * through the socket being hung up. A waiting process checks this every
+     * PEER_CHECK_INTERVAL milliseconds, the creating process only notices it
+     * once its own copy of handle() has been closed with close_handle().
+     */
+    class SharedMemoryRing
+    {
+    public:
+        /**
+         * @brief Defines constants specifying the class behaviour.
+         */
+        enum
+        {
+            CACHE_LINE_SIZE = 64,
+            DEFAULT_CAPACITY = 1024 * 1024,
+            PEER_CHECK_INTERVAL = 100   ///< How often a waiting process checks if the other process is alive (in milliseconds).
+        };
+
+    private:
+        struct Control;
+
+        int fd_;
+        int sock_;              ///< Socket connected to the other process.
+        int peer_sock_;         ///< Socket to be inherited by the other process, -1 when closed.
+        bool peer_lost_;        ///< Set when the other process is gone.
+        void *map_;
+        size_t map_size_;
+        Control *control_;
+        unsigned char *buffer_;
+        tuint32 mask_;
+
+        SharedMemoryRing(const SharedMemoryRing &rhs);
+        SharedMemoryRing &operator=(const SharedMemoryRing &rhs);
+
+        /**
+         * Maps the memory file.
+         * @param [in] fd The memory file descriptor, owned by the ring.
+         * @param [in] capacity The capacity of a new ring, zero to map an
+         *                      existing ring.
+         * @return If successful true is returned, otherwise false is
+         *         returned.
+         */
+        bool map(int fd,tuint32 capacity);
+
+        /**
+         * Checks if the other process still has its end of the ring open.
+         * @return If the other process may still be alive true is returned,
+         *         if its end of the socket has been closed false is returned.
+         */
+        bool peer_alive() const;
+
+    public:
+        /**
+         * Constructs an unmapped SharedMemoryRing object.
+         */
+        SharedMemoryRing();
+
+        /**
+         * Destructs the SharedMemoryRing object, unmapping the ring.
+         */
+        ~SharedMemoryRing();
+
+        /**
+         * Creates a new ring.
+         * @param [in] capacity The minimum capacity of the ring in bytes,
+         *                      rounded up to the nearest power of two.
+         * @return If successful true is returned, otherwise false is
+         *         returned.
+         */
+        bool create(tuint32 capacity);
+
+        /**
+         * Maps a ring created by another process.
+         * @param [in] fd The inherited descriptor returned by handle() in the
+         *                creating process. The ring takes ownership of the
+         *                descriptor, also if unsuccessful.
+         * @return If successful true is returned, otherwise false is
+         *         returned.
+         */
+        bool open(int fd);
+
+        /**
+         * Unmaps the ring and closes all descriptors.
+         */
+        void close();
+
+        /**
+         * Closes the copy of handle() kept by the creating process. Must be
+         * called once the other process has been started in order to detect
+         * if it exits without closing the ring.
+         */
+        void close_handle();
+
+        /**
+         * Waits until data is available, the writer has closed the ring or
+         * the writer is gone.
+         * @param [out] pos Receives the ring offset of the available data.
+         * @return The number of bytes available, zero if the ring isn't
+         *         mapped, the writer has closed it or the writer is gone.
+         */
+        tuint32 wait_data(tuint32 &pos);
+
+        /**
+         * Waits until space is available, the reader has closed the ring or
+         * the reader is gone.
+         * @param [out] pos Receives the ring offset of the free space.
+         * @return The number of bytes free, zero if the ring isn't mapped,
+         *         the reader has closed it or the reader is gone.
+         */
+        tuint32 wait_space(tuint32 &pos);
+
+        /**
+         * Releases data to the writer.
+         * @param [in] count The number of bytes consumed.
+         */
+        void consume(tuint32 count);
+
+        /**
+         * Publishes data to the reader.
+         * @param [in] count The number of bytes written.
+         */
+        void commit(tuint32 count);
+
+        /**
+         * Marks the reading end as closed and wakes up the writer.
+         */
+        void close_reader();
+
+        /**
+         * Marks the writing end as closed and wakes up the reader.
+         */
+        void close_writer();
+
+        /**
+         * Returns the ring data.
+         * @return Pointer to the beginning of the ring data.
+         */
+        unsigned char *buffer() const;
+
+        /**
+         * Returns the descriptor to be inherited by the other process.
+         * @return The descriptor, -1 if the ring hasn't been created or
+         *         close_handle() has been called.
+         */
+        int handle() const;
+
+        /**
+         * Checks if the other process has exited without closing its end of
+         * the ring.
+         * @return If the other process is gone true is returned, otherwise
+         *         false is returned.
+         */
+        bool peer_lost() const;
+
+        /**
+         * Returns the capacity of the ring.
+         * @return The capacity of the ring in bytes, zero if the ring isn't
+         *         mapped.
+         */
+        tuint32 capacity() const;
+    };
+
+    /**
+     * @brief The writing end of a shared memory ring.
+     *
+     * The writer creates the ring and passes handle() to the reading
+     * process, which opens a SharedMemoryInStream on the inherited
+     * descriptor. Closing the stream signals the end of the data. Once the
+     * reading process has been started close_handle() should be called,
+     * otherwise writes block forever if the reader exits without closing
+     * the stream.
+     */
+    class SharedMemoryOutStream : public OutStream
+    {
+    private:
+        SharedMemoryRing ring_;
+        const tuint32 capacity_;
+
+        SharedMemoryOutStream(const SharedMemoryOutStream &rhs);
+        SharedMemoryOutStream &operator=(const SharedMemoryOutStream &rhs);
+
+    public:
+        /**
+         * Constructs a SharedMemoryOutStream object.
+         * @param [in] capacity The minimum capacity of the ring in bytes.
+         */
+        SharedMemoryOutStream(tuint32 capacity = SharedMemoryRing::DEFAULT_CAPACITY);
+
+        /**
+         * Destructs the SharedMemoryOutStream object, closing the stream.
+         */
+        ~SharedMemoryOutStream();
+
+        /**
+         * Creates the shared memory ring.
+         * @return If successful true is returned, otherwise false is
+         *         returned.
+         */
+        bool create();
+
+        /**
+         * Closes the writing end, signaling the end of the stream to the
+         * reader.
+         */
+        void close();
+
+        /**
+         * Returns the descriptor to be inherited by the reading process. The
+         * descriptor is closed on exec unless inherited explicitly.
+         * @return The descriptor, -1 if the ring hasn't been created or
+         *         close_handle() has been called.
+         */
+        int handle() const;
+
+        /**
+         * Closes this process' copy of handle() after the reading process
+         * has been started, allowing the stream to detect if the reader
+         * exits without closing the stream.
+         */
+        void close_handle();
+
+        /**
+         * Returns the capacity of the ring.
+         * @return The capacity of the ring in bytes.
+         */
+        tuint32 capacity() const;
+
+        /**
+         * Reserves space in the ring, waiting until space is available or
+         * the reader has closed the stream.
+         * @param [in,out] count The number of bytes requested, receives the
+         *                       number of contiguous bytes reserved which may
+         *                       be less than requested.
+         * @return Pointer to the reserved space. If the reader has closed the
+         *         stream NULL is returned.
+         */
+        unsigned char *reserve(tuint32 &count);
+
+        /**
+         * Makes data written to previously reserved space available to the
+         * reader.
+         * @param [in] count The number of bytes to commit.
+         */
+        void commit(tuint32 count);
+
+        /**
+         * Writes raw data to the ring, waiting for space as necessary.
+         * @param [in] buffer Pointer to the beginning of the buffer
+         *                    containing the data to be written.
+         * @param [in] count The number of bytes to write.
+         * @return If the reader has closed the stream or exited before any
+         *         data could be written -1 is returned, otherwise the
+         *         function returns the number of bytes written.
+         */
+        tint64 write(const void *buffer,tuint32 count);
+    };
+
+    /**
+     * @brief The reading end of a shared memory ring.
+     */
+    class SharedMemoryInStream : public InStream
+    {
+    private:
+        SharedMemoryRing ring_;
+
+        SharedMemoryInStream(const SharedMemoryInStream &rhs);
+        SharedMemoryInStream &operator=(const SharedMemoryInStream &rhs);
+
+    public:
+        /**
+         * Constructs a SharedMemoryInStream object.
+         */
+        SharedMemoryInStream();
+
+        /**
+         * Destructs the SharedMemoryInStream object, closing the stream.
+         */
+        ~SharedMemoryInStream();
+
+        /**
+         * Opens a ring created by another process.
+         * @param [in] fd The inherited descriptor. The stream takes ownership
+         *                of the descriptor, also if unsuccessful.
+         * @return If successful true is returned, otherwise false is
+         *         returned.
+         */
+        bool open(int fd);
+
+        /**
+         * Closes the reading end, further writes will fail.
+         */
+        void close();
+
+        /**
+         * Returns a pointer to the data available in the ring, waiting until
+         * data is available or the writer has closed the stream.
+         * @param [out] count Receives the number of contiguous bytes
+         *                    available at the returned pointer.
+         * @return Pointer to the available data. If the writer has closed the
+         *         stream and all data has been consumed NULL is returned.
+         */
+        const unsigned char *peek(tuint32 &count);
+
+        /**
+         * Consumes data previously returned by peek(), freeing the space for
+         * the writer.
+         * @param [in] count The number of bytes to consume.
+         */
+        void consume(tuint32 count);
+
+        /**
+         * Reads raw data from the ring, waiting until at least one byte is
+         * available.
+         * @param [in] buffer Pointer to beginning of buffer to read to.
+         * @param [in] count The number of bytes to read.
+         * @return The number of bytes read, zero if the writer has closed the
+         *         stream and all data has been read. If the writer exited
+         *         without closing the stream -1 is returned once all data has
+         *         been read.
+         */
+        tint64 read(void *buffer,tuint32 count);
+
+        /**
+         * The size of a shared memory stream is not known in advance.
+         * @return Always returns -1.
+         */
+        tint64 size();
+
+        /**
+         * Checks if the end of the stream has been reached. The function
+         * waits until data is available or the writer closes the stream.
+         * @return If the writer has closed the stream and all data has been
+         *         read true is returned, otherwise false is returned. If the
+         *         writer exited without closing the stream false is returned
+         *         and the next read fails.
+         */
+        bool end();
+
+        /**
+         * Skips data in the stream. Only relative seeking is supported.
+         * @param [in] distance The number of bytes to skip.
+         * @param [in] whence Must be ckSTREAM_CURRENT.
+         * @return If successfull true is returned, otherwise false is
+         *         returned.
+         */
+        bool seek(tuint32 distance,StreamWhence whence);
+    };
+}
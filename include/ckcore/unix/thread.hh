@@ -22,6 +22,7 @@
  */
 #pragma once
 #include <limits>
+#include <pthread.h>
 #include "ckcore/types.hh"
 #include "ckcore/locker.hh"
 
@@ -60,13 +61,26 @@ namespace ckcore
          */
         thandle identifier();
 
+        class LockProfile;
+
         /**
          * @brief Thead mutex class.
+         *
+         * On Linux the mutex is implemented directly on top of futexes. A
+         * thread failing to lock the mutex spins for a short while before
+         * sleeping in the kernel, and unlocking a mutex without waiters does
+         * not require any system call.
          */
         class Mutex
         {
         private:
+#ifdef __linux__
+            volatile tint32 state_; ///< 0 if unlocked, 1 if locked and 2 if locked with waiters.
+#else
             pthread_mutex_t mutex_;
+#endif
+            LockProfile *profile_;  ///< Contention profile, NULL if not named.
+            tuint64 acquired_;      ///< Acquisition time when profiled.
 
         public:
             /**
@@ -74,6 +88,14 @@ namespace ckcore
              */
             Mutex();
 
+            /**
+             * Constructs a named Mutex object. Named mutexes are registered
+             * with the lock profiler.
+             * @param [in] name The mutex name, mutexes with the same name share
+             *                  the same statistics.
+             */
+            explicit Mutex(const char *name);
+
             /**
              * Destructs the Mutex object.
              */
@@ -104,14 +126,45 @@ namespace ckcore
 
         /**
          * @brief Wait condition class.
+         *
+         * On Linux the wait condition is implemented using futexes and does
+         * not use any internal lock, the only locking performed when waiting
+         * is releasing and re-acquiring the caller's mutex. Time outs are
+         * measured using the monotonic clock.
          */
         class WaitCondition
         {
         private:
+#ifdef __linux__
+            volatile tint32 state_; ///< Number of waiters in the upper and number of pending wakeups in the lower 16 bits.
+            volatile tint32 seq_;   ///< Futex word, incremented on each signal.
+
+            /**
+             * Tries to consume a pending wakeup.
+             * @return If a wakeup was consumed true is returned, otherwise
+             *         false is returned.
+             */
+            bool try_wake();
+
+            /**
+             * Stops waiting after a time out or a cancellation, consuming a
+             * wakeup if one is pending.
+             * @return If a wakeup was consumed true is returned, otherwise
+             *         false is returned.
+             */
+            bool leave();
+
+            /**
+             * Cleanup handler for threads cancelled while waiting.
+             * @param [in] param Pointer to the cancellation parameters.
+             */
+            static void cancelled(void *param);
+#else
             tuint32 waiters_;
             tuint32 wakeups_;
             pthread_mutex_t mutex_;
             pthread_cond_t cond_;
+#endif
 
             /**
              * Waits on the condition until it is signaled or a time out occurs.
@@ -151,6 +204,123 @@ namespace ckcore
              */
             void signal_all();
         };
+
+        /**
+         * @brief Event class.
+         *
+         * An event is either set or not set, threads waiting on the event are
+         * released when it's set. An auto-reset event is reset as soon as it
+         * has released one waiting thread while a manual-reset event stays
+         * set until it's explicitly reset.
+         */
+        class Event
+        {
+        private:
+            const bool manual_reset_;
+#ifdef __linux__
+            volatile tint32 state_; ///< 1 if set and 0 if not set.
+            volatile tint32 waiters_;
+
+            /**
+             * Tries to pass the event, resetting it if it's an auto-reset
+             * event.
+             * @return If the event was set true is returned, otherwise false
+             *         is returned.
+             */
+            bool try_pass();
+#else
+            bool state_;
+            pthread_mutex_t mutex_;
+            pthread_cond_t cond_;
+#endif
+
+            Event(const Event &rhs);
+            Event &operator=(const Event &rhs);
+
+        public:
+            /**
+             * Constructs an event object which initially is not set.
+             * @param [in] manual_reset Set to true to create a manual-reset
+             *                          event and false to create an auto-reset
+             *                          event.
+             */
+            explicit Event(bool manual_reset = false);
+
+            /**
+             * Destructs the event object.
+             */
+            ~Event();
+
+            /**
+             * Sets the event, releasing waiting threads.
+             */
+            void set();
+
+            /**
+             * Resets the event.
+             */
+            void reset();
+
+            /**
+             * Waits until the event is set.
+             * @param [in] timeout Time out in milliseconds.
+             * @return If the event was set before the time out true is
+             *         returned, otherwise false is returned.
+             */
+            bool wait(tuint32 timeout = std::numeric_limits<tuint32>::max());
+        };
+
+        /**
+         * @brief Counting semaphore class.
+         */
+        class Semaphore
+        {
+        private:
+#ifdef __linux__
+            volatile tint32 count_;
+            volatile tint32 waiters_;
+
+            /**
+             * Tries to decrement the semaphore count without blocking.
+             * @return If the count was decremented true is returned, otherwise
+             *         false is returned.
+             */
+            bool try_acquire();
+#else
+            tuint32 count_;
+            pthread_mutex_t mutex_;
+            pthread_cond_t cond_;
+#endif
+
+            Semaphore(const Semaphore &rhs);
+            Semaphore &operator=(const Semaphore &rhs);
+
+        public:
+            /**
+             * Constructs a semaphore object.
+             * @param [in] count The initial count.
+             */
+            explicit Semaphore(tuint32 count = 0);
+
+            /**
+             * Destructs the semaphore object.
+             */
+            ~Semaphore();
+
+            /**
+             * Waits until the count is greater than zero and decrements it.
+             * @param [in] timeout Time out in milliseconds.
+             * @return If the count was decremented before the time out true
+             *         is returned, otherwise false is returned.
+             */
+            bool wait(tuint32 timeout = std::numeric_limits<tuint32>::max());
+
+            /**
+             * Increments the count, releasing waiting threads.
+             * @param [in] count The number to increment the count with.
+             */
+            void release(tuint32 count = 1);
+        };
     }
 
     /**
@@ -161,6 +331,8 @@ namespace ckcore
     private:
         pthread_t thread_;
         bool running_;
+        tstring name_;          ///< Name to assign the thread when started.
+        tint32 numa_node_;      ///< NUMA node to allocate memory from.
         mutable thread::Mutex mutex_;
         thread::WaitCondition thread_done_;
 
@@ -198,6 +370,14 @@ namespace ckcore
          */
         bool start();
 
+        /**
+         * Starts the thread using the specified attributes.
+         * @param [in] attr The thread attributes.
+         * @return If the thread was successfully started true is returned,
+         *         otherwise false is returned.
+         */
+        bool start(const ThreadAttributes &attr);
+
         /**
          * Waits until the thread has finished.
          * @param [in] timout Maximum time to wait in milliseconds.
@@ -207,8 +387,11 @@ namespace ckcore
         bool wait(tuint32 timeout = std::numeric_limits<tuint32>::max());
 
         /**
-         * Immediately kills the thread, the function does not return until the
-         * the thread has exited.
+         * Kills the thread, the function does not return until the the thread
+         * has exited. The thread is cancelled at its next cancellation point,
+         * which includes blocking system calls and waiting on wait
+         * conditions, events and semaphores. Locking a mutex is not a
+         * cancellation point.
          * @return If the thread was successfully killed true is returned, if not
          *         false is returned.
          */
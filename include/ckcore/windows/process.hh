@@ -23,8 +23,8 @@
 #pragma once
 #include <windows.h>
 #include <vector>
-#include <set>
 #include "ckcore/types.hh"
+#include "ckcore/file.hh"
 #include "ckcore/stream.hh"
 
 namespace ckcore
@@ -37,6 +37,38 @@ namespace ckcore
     public:
         friend class ProcessMonitor;
 
+        /**
+         * @brief Resource usage of a finished process.
+         */
+        struct Usage
+        {
+            ckcore::tuint64 user_time_;     ///< Time spent in user mode in microseconds.
+            ckcore::tuint64 system_time_;   ///< Time spent in kernel mode in microseconds.
+            ckcore::tuint64 max_rss_;       ///< Peak resident set size in bytes, zero if unknown.
+            ckcore::tuint64 block_input_;   ///< Number of block input operations.
+            ckcore::tuint64 block_output_;  ///< Number of block output operations.
+            ckcore::tuint64 voluntary_switches_;    ///< Number of voluntary context switches.
+            ckcore::tuint64 involuntary_switches_;  ///< Number of involuntary context switches.
+        };
+
+        /**
+         * Defines the type of functions notified when a process has finished.
+         * @param [in] param The parameter passed to notify_finished().
+         */
+        typedef void (*tcallback)(void *param);
+
+        /**
+         * @brief Block of process output.
+         *
+         * The block refers to an internal buffer and is only valid during the
+         * call to event_output_batch.
+         */
+        struct Block
+        {
+            const char *data_;      ///< Pointer to the first character, not null terminated.
+            size_t size_;           ///< Number of characters in the block.
+        };
+
     protected:
         volatile bool invalid_inheritor_;   // Set to true to indicate that the
                                             // inheritor is no loner valid and
@@ -47,7 +79,8 @@ namespace ckcore
         enum
         {
             MAX_ARG_COUNT = 127,
-            READ_BUFFER_SIZE = 128
+            READ_BUFFER_SIZE = 65536,
+            FEED_BUFFER_SIZE = 65536
         };
 
         enum State
@@ -66,15 +99,29 @@ namespace ckcore
         volatile unsigned long thread_id_;  // Thread identifier.
         volatile State state_;              // Process state.
         ckcore::tuint32 exit_code_;
+        Usage usage_;
 
-        std::set<char> block_delims_;
+        bool delim_table_[256];         // Set for each character that is a block delimiter.
+        unsigned int delim_count_;      // Number of block delimiters.
+        char single_delim_;             // The delimiter if there's only one.
         std::string block_buffer_;      // For buffering partial standard output blocks before commiting them.
+        std::vector<Block> blocks_;
+
+        std::vector<std::pair<tcallback,void *> > finish_callbacks_;    // Called when the process has finished.
 
         /**
          * Closes all internal pipes and resets the internal state of the object.
          */
         void close();
 
+        /**
+         * Finds the first block delimiter in a range of characters.
+         * @param [in] begin Pointer to the first character.
+         * @param [in] end Pointer past the last character.
+         * @return Pointer to the delimiter, or end if there is none.
+         */
+        const char *find_delim(const char *begin,const char *end) const;
+
         /**
          * Reads from the specified file descriptor to the standard output buffer.
          * @return If successful true is returned, if unsuccessful false is
@@ -139,6 +186,28 @@ namespace ckcore
          */
         bool exit_code(ckcore::tuint32 &exit_code) const;
 
+        /**
+         * Obtains the resource usage of the process.
+         * @param [out] usage The resource usage of the process.
+         * @return If the process has finished true is returned, if not false
+         *         is returned.
+         */
+        bool usage(Usage &usage) const;
+
+        /**
+         * Registers a function to call once when the running process has
+         * finished, after event_finished() has been called. The function is
+         * called from the thread delivering the process events and must not
+         * block. The object may already have been destroyed when the function
+         * is called.
+         * @param [in] callback The function to call.
+         * @param [in] param Parameter to pass to the callback.
+         * @return If a process is running and the function was registered
+         *         true is returned, otherwise false is returned and the
+         *         function will not be called.
+         */
+        bool notify_finished(tcallback callback,void *param);
+
         /**
          * Adds a new block delimiter to be used when splitting process output
          * into blocks.
@@ -164,6 +233,31 @@ namespace ckcore
          */
         tint64 write(const void *buffer,tuint32 count);
 
+        /**
+         * Writes all data from a stream to the process standard input.
+         * @param [in] in The stream to read from.
+         * @return If the operation failed -1 is returned, otherwise the
+         *         function returns the number of bytes written.
+         */
+        tint64 feed(InStream &in);
+
+        /**
+         * Writes the remaining data of an open file to the process standard
+         * input.
+         * @param [in] file The file to read from, it must be open for reading.
+         * @return If the operation failed -1 is returned, otherwise the
+         *         function returns the number of bytes written.
+         */
+        tint64 feed(File &file);
+
+        /**
+         * Closes the process standard input, letting the process know that no
+         * more data will be written.
+         * @return If successful true is returned, if the standard input
+         *         already has been closed false is returned.
+         */
+        bool close_input();
+
         /**
          * Called when the process has finished.
          */
@@ -175,5 +269,14 @@ namespace ckcore
          * @param [in] block The block that has been read.
          */
         virtual void event_output(const std::string &block) = 0;
+
+        /**
+         * Called when one or more blocks have been read from either standard
+         * output or standard error. The default implementation calls
+         * event_output for each block, inheritors that produce a lot of output
+         * can override this function to avoid copying each block.
+         * @param [in] blocks The blocks that have been read.
+         */
+        virtual void event_output_batch(const std::vector<Block> &blocks);
     };
 };
@@ -68,6 +68,8 @@ namespace ckcore
          */
         thandle identifier();
 
+        class LockProfile;
+
         /**
          * @brief Thead mutex class.
          */
@@ -78,6 +80,8 @@ namespace ckcore
 
         private:
             HANDLE handle_;
+            LockProfile *profile_;  ///< Contention profile, NULL if not named.
+            tuint64 acquired_;      ///< Acquisition time when profiled.
 
         public:
             /**
@@ -85,6 +89,14 @@ namespace ckcore
              */
             Mutex();
 
+            /**
+             * Constructs a named Mutex object. Named mutexes are registered
+             * with the lock profiler.
+             * @param [in] name The mutex name, mutexes with the same name share
+             *                  the same statistics.
+             */
+            explicit Mutex(const char *name);
+
             /**
              * Destructs the Mutex object.
              */
@@ -155,6 +167,93 @@ namespace ckcore
              */
             void signal_all();
         };
+
+        /**
+         * @brief Event class.
+         *
+         * An event is either set or not set, threads waiting on the event are
+         * released when it's set. An auto-reset event is reset as soon as it
+         * has released one waiting thread while a manual-reset event stays
+         * set until it's explicitly reset.
+         */
+        class Event
+        {
+        private:
+            HANDLE handle_;
+
+            Event(const Event &rhs);
+            Event &operator=(const Event &rhs);
+
+        public:
+            /**
+             * Constructs an event object which initially is not set.
+             * @param [in] manual_reset Set to true to create a manual-reset
+             *                          event and false to create an auto-reset
+             *                          event.
+             */
+            explicit Event(bool manual_reset = false);
+
+            /**
+             * Destructs the event object.
+             */
+            ~Event();
+
+            /**
+             * Sets the event, releasing waiting threads.
+             */
+            void set();
+
+            /**
+             * Resets the event.
+             */
+            void reset();
+
+            /**
+             * Waits until the event is set.
+             * @param [in] timeout Time out in milliseconds.
+             * @return If the event was set before the time out true is
+             *         returned, otherwise false is returned.
+             */
+            bool wait(tuint32 timeout = std::numeric_limits<tuint32>::max());
+        };
+
+        /**
+         * @brief Counting semaphore class.
+         */
+        class Semaphore
+        {
+        private:
+            HANDLE handle_;
+
+            Semaphore(const Semaphore &rhs);
+            Semaphore &operator=(const Semaphore &rhs);
+
+        public:
+            /**
+             * Constructs a semaphore object.
+             * @param [in] count The initial count.
+             */
+            explicit Semaphore(tuint32 count = 0);
+
+            /**
+             * Destructs the semaphore object.
+             */
+            ~Semaphore();
+
+            /**
+             * Waits until the count is greater than zero and decrements it.
+             * @param [in] timeout Time out in milliseconds.
+             * @return If the count was decremented before the time out true
+             *         is returned, otherwise false is returned.
+             */
+            bool wait(tuint32 timeout = std::numeric_limits<tuint32>::max());
+
+            /**
+             * Increments the count, releasing waiting threads.
+             * @param [in] count The number to increment the count with.
+             */
+            void release(tuint32 count = 1);
+        };
     };
 
     /**
@@ -197,6 +296,14 @@ namespace ckcore
          */
         bool start();
 
+        /**
+         * Starts the thread using the specified attributes.
+         * @param [in] attr The thread attributes.
+         * @return If the thread was successfully started true is returned,
+         *         otherwise false is returned.
+         */
+        bool start(const ThreadAttributes &attr);
+
         /**
          * Waits until the thread has finished.
          * @param [in] timout Maximum time to wait in milliseconds.
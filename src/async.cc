@@ -0,0 +1,276 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ckcore/async.hh"
+
+namespace ckcore
+{
+    namespace async
+    {
+        /**
+         * @brief Base class for operations executing in the thread pool.
+         *
+         * The operation shares the cancellation token of its completion. If
+         * the operation is never executed its completion is deleted together
+         * with the operation.
+         */
+        class Operation : public Task
+        {
+        private:
+            bool completed_;
+
+        protected:
+            ThreadPool &pool_;
+            Completion *completion_;
+
+            /**
+             * Performs the operation.
+             * @return The operation result.
+             */
+            virtual tint64 execute() = 0;
+
+        public:
+            Operation(ThreadPool &pool,Completion *completion)
+                : completed_(false),pool_(pool),completion_(completion)
+            {
+                set_cancellation_token(completion->cancellation_token());
+            }
+
+            virtual ~Operation()
+            {
+                if (!completed_ && completion_->auto_delete())
+                    delete completion_;
+            }
+
+            /**
+             * Performs the operation and starts the completion with the
+             * result, exceptions are reported as failures.
+             */
+            void start()
+            {
+                tint64 result = -1;
+                try
+                {
+                    result = execute();
+                }
+                catch (...)
+                {
+                }
+
+                completed_ = true;
+                completion_->set_result(result);
+                pool_.start(completion_);
+            }
+        };
+
+        /**
+         * @brief Reads from a file.
+         */
+        class FileReadOperation : public Operation
+        {
+        private:
+            File &file_;
+            void *buffer_;
+            tuint32 count_;
+
+        public:
+            FileReadOperation(ThreadPool &pool,Completion *completion,
+                              File &file,void *buffer,tuint32 count)
+                : Operation(pool,completion),file_(file),buffer_(buffer),
+                  count_(count)
+            {
+            }
+
+            tint64 execute()
+            {
+                return file_.read(buffer_,count_);
+            }
+        };
+
+        /**
+         * @brief Writes to a file.
+         */
+        class FileWriteOperation : public Operation
+        {
+        private:
+            File &file_;
+            const void *buffer_;
+            tuint32 count_;
+
+        public:
+            FileWriteOperation(ThreadPool &pool,Completion *completion,
+                               File &file,const void *buffer,tuint32 count)
+                : Operation(pool,completion),file_(file),buffer_(buffer),
+                  count_(count)
+            {
+            }
+
+            tint64 execute()
+            {
+                return file_.write(buffer_,count_);
+            }
+        };
+
+        /**
+         * @brief Reads from a stream.
+         */
+        class StreamReadOperation : public Operation
+        {
+        private:
+            InStream &stream_;
+            void *buffer_;
+            tuint32 count_;
+
+        public:
+            StreamReadOperation(ThreadPool &pool,Completion *completion,
+                                InStream &stream,void *buffer,tuint32 count)
+                : Operation(pool,completion),stream_(stream),buffer_(buffer),
+                  count_(count)
+            {
+            }
+
+            tint64 execute()
+            {
+                return stream_.read(buffer_,count_);
+            }
+        };
+
+        /**
+         * @brief Writes to a stream.
+         */
+        class StreamWriteOperation : public Operation
+        {
+        private:
+            OutStream &stream_;
+            const void *buffer_;
+            tuint32 count_;
+
+        public:
+            StreamWriteOperation(ThreadPool &pool,Completion *completion,
+                                 OutStream &stream,const void *buffer,
+                                 tuint32 count)
+                : Operation(pool,completion),stream_(stream),buffer_(buffer),
+                  count_(count)
+            {
+            }
+
+            tint64 execute()
+            {
+                return stream_.write(buffer_,count_);
+            }
+        };
+
+        /**
+         * @brief Obtains the exit code of a finished process.
+         */
+        class ProcessWaitOperation : public Operation
+        {
+        private:
+            Process &process_;
+
+        public:
+            /**
+             * Called by the process when it has finished, starts the
+             * operation in the thread pool.
+             * @param [in] param The operation.
+             */
+            static void finished(void *param)
+            {
+                ProcessWaitOperation *operation = static_cast<ProcessWaitOperation *>(param);
+                operation->pool_.start(operation);
+            }
+
+            ProcessWaitOperation(ThreadPool &pool,Completion *completion,
+                                 Process &process)
+                : Operation(pool,completion),process_(process)
+            {
+            }
+
+            tint64 execute()
+            {
+                tuint32 exit_code = 0;
+                if (process_.exit_code(exit_code))
+                    return exit_code;
+
+                return -1;
+            }
+        };
+
+        bool read(File &file,void *buffer,tuint32 count,Completion *completion,
+                  ThreadPool &pool)
+        {
+            if (completion == NULL)
+                return false;
+
+            return pool.start(new FileReadOperation(pool,completion,file,
+                                                    buffer,count));
+        }
+
+        bool write(File &file,const void *buffer,tuint32 count,
+                   Completion *completion,ThreadPool &pool)
+        {
+            if (completion == NULL)
+                return false;
+
+            return pool.start(new FileWriteOperation(pool,completion,file,
+                                                     buffer,count));
+        }
+
+        bool read(InStream &stream,void *buffer,tuint32 count,
+                  Completion *completion,ThreadPool &pool)
+        {
+            if (completion == NULL)
+                return false;
+
+            return pool.start(new StreamReadOperation(pool,completion,stream,
+                                                      buffer,count));
+        }
+
+        bool write(OutStream &stream,const void *buffer,tuint32 count,
+                   Completion *completion,ThreadPool &pool)
+        {
+            if (completion == NULL)
+                return false;
+
+            return pool.start(new StreamWriteOperation(pool,completion,stream,
+                                                       buffer,count));
+        }
+
+        bool sleep(tuint32 delay,Completion *completion,ThreadPool &pool)
+        {
+            if (completion == NULL)
+                return false;
+
+            completion->set_result(0);
+            return pool.start_after(completion,delay);
+        }
+
+        bool wait(Process &process,Completion *completion,ThreadPool &pool)
+        {
+            if (completion == NULL)
+                return false;
+
+            ProcessWaitOperation *operation = new ProcessWaitOperation(pool,completion,process);
+            if (process.notify_finished(ProcessWaitOperation::finished,operation))
+                return true;
+
+            // The process is not running, complete immediately.
+            return pool.start(operation);
+        }
+    }
+}
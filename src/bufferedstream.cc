@@ -18,6 +18,7 @@
 
 #include <string.h>
 #include "ckcore/system.hh"
+#include "ckcore/bufferpool.hh"
 #include "ckcore/bufferedstream.hh"
 
 namespace ckcore
@@ -30,7 +31,7 @@ namespace ckcore
         if (buffer_size_ == 0)*/
             buffer_size_ = 8192;
 
-        buffer_ = new unsigned char[buffer_size_];
+        buffer_ = static_cast<unsigned char *>(BufferPool::instance().allocate(buffer_size_));
 
         // Make sure that the memory allocation succeeded.
         if (buffer_ == NULL)
@@ -45,7 +46,7 @@ namespace ckcore
         if (buffer_size_ == 0)
             buffer_size_ = 8192;
 
-        buffer_ = new unsigned char[buffer_size_];
+        buffer_ = static_cast<unsigned char *>(BufferPool::instance().allocate(buffer_size_));
 
         // Make sure that the memory allocation succeeded.
         if (buffer_ == NULL)
@@ -54,10 +55,10 @@ namespace ckcore
 
     BufferedInStream::~BufferedInStream()
     {
-        // Free the memory allocated for the internal buffer.
+        // Return the internal buffer to the pool.
         if (buffer_ != NULL)
         {
-            delete [] buffer_;
+            BufferPool::instance().release(buffer_,buffer_size_);
             buffer_ = NULL;
         }
     }
@@ -83,24 +84,50 @@ namespace ckcore
         if (distance == 0)
             return true;
 
-        // Perform the seek operation.
-        tuint32 buffer_size = buffer_size_ == 0 ? 8192 : buffer_size_;
-        unsigned char *temp_buffer = new unsigned char[buffer_size];
-        while (distance > 0)
+        // Without an internal buffer the data is skipped through a temporary
+        // buffer.
+        if (buffer_size_ == 0)
         {
-            tuint32 read_bytes = distance > buffer_size ? buffer_size : distance;
+            PooledBuffer temp_buffer(8192);
+            if (temp_buffer.data() == NULL)
+                return false;
 
-            tint64 res = read(temp_buffer,read_bytes);
-            if (res == -1)
+            while (distance > 0)
             {
-                delete [] temp_buffer;
-                return false;
+                tuint32 read_bytes = distance > 8192 ? 8192 : distance;
+
+                tint64 res = stream_.read(temp_buffer.data(),read_bytes);
+                if (res <= 0)
+                    return false;
+
+                distance -= (tuint32)res;
+            }
+
+            return true;
+        }
+
+        // Skip the data in place, refilling the internal buffer as needed.
+        while (distance > 0)
+        {
+            if (buffer_data_ == 0)
+            {
+                if (stream_.end())
+                    return false;
+
+                tint64 res = stream_.read(buffer_,buffer_size_);
+                if (res <= 0)
+                    return false;
+
+                buffer_pos_ = 0;
+                buffer_data_ = (tuint32)res;
             }
 
-            distance -= (tuint32)res;
+            tuint32 skip = distance > buffer_data_ ? buffer_data_ : distance;
+            buffer_pos_ += skip;
+            buffer_data_ -= skip;
+            distance -= skip;
         }
 
-        delete [] temp_buffer;
         return true;
     }
 
@@ -154,7 +181,7 @@ namespace ckcore
         if (buffer_size_ == 0)*/
             buffer_size_ = 8192;
 
-        buffer_ = new unsigned char[buffer_size_];
+        buffer_ = static_cast<unsigned char *>(BufferPool::instance().allocate(buffer_size_));
 
         // Make sure that the memory allocation succeeded.
         if (buffer_ == NULL)
@@ -168,7 +195,7 @@ namespace ckcore
         if (buffer_size_ == 0)
             buffer_size_ = 8192;
 
-        buffer_ = new unsigned char[buffer_size_];
+        buffer_ = static_cast<unsigned char *>(BufferPool::instance().allocate(buffer_size_));
 
         // Make sure that the memory allocation succeeded.
         if (buffer_ == NULL)
@@ -179,10 +206,10 @@ namespace ckcore
     {
         flush();
 
-        // Free the memory allocated for the internal buffer.
+        // Return the internal buffer to the pool.
         if (buffer_ != NULL)
         {
-            delete [] buffer_;
+            BufferPool::instance().release(buffer_,buffer_size_);
             buffer_ = NULL;
         }
     }
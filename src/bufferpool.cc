@@ -0,0 +1,347 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _WINDOWS
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+#include "ckcore/locker.hh"
+#include "ckcore/bufferpool.hh"
+
+namespace ckcore
+{
+    BufferPool::BufferPool(tuint64 budget) : tls_key_(0),budget_(budget),
+        cached_(0),huge_pages_(false),mutex_("BufferPool")
+    {
+#ifdef _WINDOWS
+        // Windows doesn't notify us when a thread exits, the caches of exited
+        // threads are released with the pool.
+        tls_key_ = TlsAlloc();
+#else
+        pthread_key_t key;
+        if (pthread_key_create(&key,destroy_cache) == 0)
+            tls_key_ = static_cast<unsigned long>(key) + 1;
+#endif
+    }
+
+    BufferPool::~BufferPool()
+    {
+#ifdef _WINDOWS
+        if (tls_key_ != TLS_OUT_OF_INDEXES)
+            TlsFree(tls_key_);
+#else
+        if (tls_key_ != 0)
+            pthread_key_delete(static_cast<pthread_key_t>(tls_key_ - 1));
+#endif
+        Locker<thread::Mutex> lock(mutex_);
+        for (size_t i = 0; i < caches_.size(); i++)
+        {
+            flush(caches_[i]);
+            delete caches_[i];
+        }
+        caches_.clear();
+
+        budget_ = 0;
+        enforce_budget();
+    }
+
+    BufferPool &BufferPool::instance()
+    {
+        static BufferPool *instance = new BufferPool();
+        return *instance;
+    }
+
+    size_t BufferPool::size_class(size_t size)
+    {
+        size_t class_size = MIN_BUFFER_SIZE;
+        for (size_t i = 0; i < NUM_CLASSES; i++,class_size <<= 1)
+        {
+            if (size <= class_size)
+                return i;
+        }
+
+        return NUM_CLASSES;
+    }
+
+    size_t BufferPool::buffer_size(size_t size)
+    {
+        size_t index = size_class(size);
+        if (index < NUM_CLASSES)
+            return static_cast<size_t>(MIN_BUFFER_SIZE) << index;
+
+        // Huge page mappings can only be unmapped in whole huge pages.
+        return (size + HUGE_PAGE_SIZE - 1) & ~static_cast<size_t>(HUGE_PAGE_SIZE - 1);
+    }
+
+    void *BufferPool::allocate_system(size_t size)
+    {
+#ifdef _WINDOWS
+        if (size >= HUGE_PAGE_SIZE)
+        {
+            // Large pages require the lock pages privilege.
+            void *buffer = NULL;
+            SIZE_T large_page_size = GetLargePageMinimum();
+            if (huge_pages_ && large_page_size != 0 && size % large_page_size == 0)
+            {
+                buffer = VirtualAlloc(NULL,size,MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                      PAGE_READWRITE);
+            }
+
+            if (buffer == NULL)
+                buffer = VirtualAlloc(NULL,size,MEM_RESERVE | MEM_COMMIT,PAGE_READWRITE);
+
+            return buffer;
+        }
+
+        return _aligned_malloc(size,MIN_BUFFER_SIZE);
+#else
+        if (size >= HUGE_PAGE_SIZE)
+        {
+            void *buffer = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            if (huge_pages_ && size % HUGE_PAGE_SIZE == 0)
+            {
+                buffer = mmap(NULL,size,PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,-1,0);
+            }
+#endif
+            // Fall back to transparent huge pages if no huge pages have been
+            // reserved.
+            if (buffer == MAP_FAILED)
+            {
+                buffer = mmap(NULL,size,PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+                if (buffer == MAP_FAILED)
+                    return NULL;
+#ifdef MADV_HUGEPAGE
+                if (huge_pages_)
+                    madvise(buffer,size,MADV_HUGEPAGE);
+#endif
+            }
+
+            return buffer;
+        }
+
+        void *buffer = NULL;
+        if (posix_memalign(&buffer,MIN_BUFFER_SIZE,size) != 0)
+            return NULL;
+
+        return buffer;
+#endif
+    }
+
+    void BufferPool::release_system(void *buffer,size_t size)
+    {
+#ifdef _WINDOWS
+        if (size >= HUGE_PAGE_SIZE)
+            VirtualFree(buffer,0,MEM_RELEASE);
+        else
+            _aligned_free(buffer);
+#else
+        if (size >= HUGE_PAGE_SIZE)
+            munmap(buffer,size);
+        else
+            free(buffer);
+#endif
+    }
+
+    BufferPool::ThreadCache *BufferPool::thread_cache()
+    {
+#ifdef _WINDOWS
+        if (tls_key_ == TLS_OUT_OF_INDEXES)
+            return NULL;
+
+        ThreadCache *cache = static_cast<ThreadCache *>(TlsGetValue(tls_key_));
+#else
+        if (tls_key_ == 0)
+            return NULL;
+
+        pthread_key_t key = static_cast<pthread_key_t>(tls_key_ - 1);
+        ThreadCache *cache = static_cast<ThreadCache *>(pthread_getspecific(key));
+#endif
+        if (cache != NULL)
+            return cache;
+
+        cache = new ThreadCache();
+        cache->pool_ = this;
+        for (size_t i = 0; i < NUM_CLASSES; i++)
+            cache->buffers_[i].reserve(THREAD_CACHE_COUNT);
+
+        Locker<thread::Mutex> lock(mutex_);
+        caches_.push_back(cache);
+        lock.unlock();
+
+#ifdef _WINDOWS
+        TlsSetValue(tls_key_,cache);
+#else
+        pthread_setspecific(key,cache);
+#endif
+        return cache;
+    }
+
+    void BufferPool::flush(ThreadCache *cache)
+    {
+        for (size_t i = 0; i < NUM_CLASSES; i++)
+        {
+            buffers_[i].insert(buffers_[i].end(),cache->buffers_[i].begin(),
+                               cache->buffers_[i].end());
+            cached_ += static_cast<tuint64>(cache->buffers_[i].size()) *
+                       (static_cast<tuint64>(MIN_BUFFER_SIZE) << i);
+            cache->buffers_[i].clear();
+        }
+    }
+
+    void BufferPool::enforce_budget()
+    {
+        // Release the largest buffers first.
+        for (size_t i = NUM_CLASSES; i-- > 0 && cached_ > budget_;)
+        {
+            const size_t size = static_cast<size_t>(MIN_BUFFER_SIZE) << i;
+            while (!buffers_[i].empty() && cached_ > budget_)
+            {
+                release_system(buffers_[i].back(),size);
+                buffers_[i].pop_back();
+                cached_ -= size;
+            }
+        }
+    }
+
+    void BufferPool::destroy_cache(void *param)
+    {
+        ThreadCache *cache = static_cast<ThreadCache *>(param);
+        BufferPool *pool = cache->pool_;
+
+        Locker<thread::Mutex> lock(pool->mutex_);
+        pool->flush(cache);
+        pool->enforce_budget();
+
+        for (size_t i = 0; i < pool->caches_.size(); i++)
+        {
+            if (pool->caches_[i] == cache)
+            {
+                pool->caches_.erase(pool->caches_.begin() + i);
+                break;
+            }
+        }
+
+        delete cache;
+    }
+
+    void *BufferPool::allocate(size_t size)
+    {
+        const size_t index = size_class(size);
+        const size_t rounded_size = buffer_size(size);
+        if (index == NUM_CLASSES)
+            return allocate_system(rounded_size);
+
+        if (rounded_size <= THREAD_CACHE_MAX_SIZE)
+        {
+            ThreadCache *cache = thread_cache();
+            if (cache != NULL && !cache->buffers_[index].empty())
+            {
+                void *buffer = cache->buffers_[index].back();
+                cache->buffers_[index].pop_back();
+                return buffer;
+            }
+        }
+
+        Locker<thread::Mutex> lock(mutex_);
+        if (!buffers_[index].empty())
+        {
+            void *buffer = buffers_[index].back();
+            buffers_[index].pop_back();
+            cached_ -= rounded_size;
+            return buffer;
+        }
+
+        lock.unlock();
+        return allocate_system(rounded_size);
+    }
+
+    void BufferPool::release(void *buffer,size_t size)
+    {
+        if (buffer == NULL)
+            return;
+
+        const size_t index = size_class(size);
+        const size_t rounded_size = buffer_size(size);
+        if (index == NUM_CLASSES)
+        {
+            release_system(buffer,rounded_size);
+            return;
+        }
+
+        if (rounded_size <= THREAD_CACHE_MAX_SIZE)
+        {
+            ThreadCache *cache = thread_cache();
+            if (cache != NULL && cache->buffers_[index].size() < THREAD_CACHE_COUNT)
+            {
+                cache->buffers_[index].push_back(buffer);
+                return;
+            }
+        }
+
+        Locker<thread::Mutex> lock(mutex_);
+        if (cached_ + rounded_size > budget_)
+        {
+            lock.unlock();
+            release_system(buffer,rounded_size);
+            return;
+        }
+
+        buffers_[index].push_back(buffer);
+        cached_ += rounded_size;
+    }
+
+    void BufferPool::trim()
+    {
+        ThreadCache *cache = thread_cache();
+
+        Locker<thread::Mutex> lock(mutex_);
+        if (cache != NULL)
+            flush(cache);
+
+        tuint64 budget = budget_;
+        budget_ = 0;
+        enforce_budget();
+        budget_ = budget;
+    }
+
+    void BufferPool::set_budget(tuint64 budget)
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        budget_ = budget;
+        enforce_budget();
+    }
+
+    void BufferPool::set_huge_pages(bool enable)
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        huge_pages_ = enable;
+    }
+
+    tuint64 BufferPool::cached() const
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        return cached_;
+    }
+}
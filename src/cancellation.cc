@@ -0,0 +1,86 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ckcore/cancellation.hh"
+
+namespace ckcore
+{
+    CancellationToken::CancellationToken()
+        : state_(NULL)
+    {
+    }
+
+    CancellationToken::CancellationToken(State *state)
+        : state_(state)
+    {
+        atomic::add(state_->refs_,1);
+    }
+
+    CancellationToken::CancellationToken(const CancellationToken &rhs)
+        : state_(rhs.state_)
+    {
+        if (state_ != NULL)
+            atomic::add(state_->refs_,1);
+    }
+
+    CancellationToken::~CancellationToken()
+    {
+        release(state_);
+    }
+
+    CancellationToken &CancellationToken::operator=(const CancellationToken &rhs)
+    {
+        if (rhs.state_ != NULL)
+            atomic::add(rhs.state_->refs_,1);
+
+        release(state_);
+        state_ = rhs.state_;
+        return *this;
+    }
+
+    void CancellationToken::release(State *state)
+    {
+        if (state != NULL && atomic::add(state->refs_,-1) == 0)
+            delete state;
+    }
+
+    CancellationSource::CancellationSource()
+        : state_(new CancellationToken::State())
+    {
+    }
+
+    CancellationSource::~CancellationSource()
+    {
+        CancellationToken::release(state_);
+    }
+
+    CancellationToken CancellationSource::token() const
+    {
+        return CancellationToken(state_);
+    }
+
+    void CancellationSource::cancel()
+    {
+        atomic::store(state_->cancelled_,1);
+    }
+
+    bool CancellationSource::cancelled() const
+    {
+        return atomic::load(state_->cancelled_) != 0;
+    }
+}
@@ -87,6 +87,22 @@ namespace ckcore
 
     namespace canexstream
     {
+        void copy(CanexInStream &from,CanexOutStream &to,
+                  const CancellationToken &token)
+        {
+            unsigned char buffer[8192];
+
+            while (!from.end())
+            {
+                // Check if we should cancel.
+                if (token.cancelled())
+                    return;
+
+                tint64 res = from.read(buffer,sizeof(buffer));
+                to.write(buffer,(tuint32)res);
+            }
+        }
+
         void copy(CanexInStream &from,CanexOutStream &to,Progresser &progresser)
         {
             unsigned char buffer[8192];
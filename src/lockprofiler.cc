@@ -0,0 +1,272 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <map>
+#include <string.h>
+#include "ckcore/atomic.hh"
+#include "ckcore/locker.hh"
+#include "ckcore/system.hh"
+#include "ckcore/thread.hh"
+#include "ckcore/lockprofiler.hh"
+
+namespace ckcore
+{
+    namespace thread
+    {
+        LockStats::LockStats() : instances_(0),acquisitions_(0),contended_(0),
+            wait_time_(0),hold_time_(0)
+        {
+            memset(wait_histogram_,0,sizeof(wait_histogram_));
+            memset(hold_histogram_,0,sizeof(hold_histogram_));
+        }
+
+        LockProfile::LockProfile(const char *name)
+        {
+            stats_.name_ = name;
+        }
+
+        void LockProfile::add(tuint64 *histogram,tuint64 time)
+        {
+            int bucket = 0;
+            while (time > 0 && bucket < LockStats::HISTOGRAM_SIZE - 1)
+            {
+                time >>= 1;
+                bucket++;
+            }
+
+            histogram[bucket]++;
+        }
+
+        tuint64 LockProfile::start_wait()
+        {
+            return LockProfiler::enabled() ? LockProfiler::now() : 0;
+        }
+
+        void LockProfile::acquired(tuint64 &acquired,bool contended,tuint64 wait_start)
+        {
+            if (!LockProfiler::enabled())
+            {
+                acquired = 0;
+                return;
+            }
+
+            acquired = LockProfiler::now();
+
+            Locker<SpinLock> lock(lock_);
+            stats_.acquisitions_++;
+            if (contended)
+            {
+                stats_.contended_++;
+
+                // Profiling may have been enabled while waiting.
+                if (wait_start != 0)
+                {
+                    tuint64 time = acquired - wait_start;
+                    stats_.wait_time_ += time;
+                    add(stats_.wait_histogram_,time);
+                }
+            }
+        }
+
+        void LockProfile::released(tuint64 &acquired)
+        {
+            if (acquired == 0)
+                return;
+
+            tuint64 time = LockProfiler::now() - acquired;
+            acquired = 0;
+
+            if (!LockProfiler::enabled())
+                return;
+
+            Locker<SpinLock> lock(lock_);
+            stats_.hold_time_ += time;
+            add(stats_.hold_histogram_,time);
+        }
+
+        void LockProfile::attach()
+        {
+            Locker<SpinLock> lock(lock_);
+            stats_.instances_++;
+        }
+
+        void LockProfile::snapshot(LockStats &stats)
+        {
+            Locker<SpinLock> lock(lock_);
+            stats = stats_;
+        }
+
+        void LockProfile::reset()
+        {
+            Locker<SpinLock> lock(lock_);
+
+            LockStats stats;
+            stats.name_ = stats_.name_;
+            stats.instances_ = stats_.instances_;
+            stats_ = stats;
+        }
+
+        volatile tint32 LockProfiler::enabled_ = 0;
+
+        /**
+         * Returns the registry of all lock profiles. The registry mutex is not
+         * named and thus never profiled itself.
+         * @param [out] mutex Receives the mutex protecting the registry.
+         * @return The registry.
+         */
+        static std::map<std::string,LockProfile *> &registry(Mutex *&mutex)
+        {
+            static Mutex registry_mutex;
+            static std::map<std::string,LockProfile *> registry;
+
+            mutex = &registry_mutex;
+            return registry;
+        }
+
+        void LockProfiler::enable(bool enable)
+        {
+            atomic::store(enabled_,enable ? 1 : 0);
+        }
+
+        bool LockProfiler::enabled()
+        {
+            return atomic::load(enabled_) != 0;
+        }
+
+        LockProfile *LockProfiler::profile(const char *name)
+        {
+            Mutex *mutex = NULL;
+            std::map<std::string,LockProfile *> &profiles = registry(mutex);
+
+            Locker<Mutex> lock(*mutex);
+
+            LockProfile *&profile = profiles[name];
+            if (profile == NULL)
+                profile = new LockProfile(name);
+
+            profile->attach();
+            return profile;
+        }
+
+        void LockProfiler::stats(std::vector<LockStats> &stats)
+        {
+            Mutex *mutex = NULL;
+            std::map<std::string,LockProfile *> &profiles = registry(mutex);
+
+            Locker<Mutex> lock(*mutex);
+
+            stats.resize(profiles.size());
+
+            size_t i = 0;
+            std::map<std::string,LockProfile *>::const_iterator it;
+            for (it = profiles.begin(); it != profiles.end(); ++it)
+                it->second->snapshot(stats[i++]);
+        }
+
+        void LockProfiler::reset()
+        {
+            Mutex *mutex = NULL;
+            std::map<std::string,LockProfile *> &profiles = registry(mutex);
+
+            Locker<Mutex> lock(*mutex);
+
+            std::map<std::string,LockProfile *>::const_iterator it;
+            for (it = profiles.begin(); it != profiles.end(); ++it)
+                it->second->reset();
+        }
+
+        /**
+         * Writes a string as a quoted JSON string.
+         * @param [in] out The output stream.
+         * @param [in] str The string to write.
+         */
+        static void write_json_string(std::ostringstream &out,const std::string &str)
+        {
+            static const char *hex = "0123456789abcdef";
+
+            out << '"';
+            for (size_t i = 0; i < str.size(); i++)
+            {
+                unsigned char c = static_cast<unsigned char>(str[i]);
+                if (c == '"' || c == '\\')
+                    out << '\\' << str[i];
+                else if (c < 0x20)
+                    out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+                else
+                    out << str[i];
+            }
+            out << '"';
+        }
+
+        /**
+         * Writes a histogram as a JSON array.
+         * @param [in] out The output stream.
+         * @param [in] histogram The histogram.
+         */
+        static void write_json_histogram(std::ostringstream &out,
+                                         const tuint64 *histogram)
+        {
+            out << '[';
+            for (int i = 0; i < LockStats::HISTOGRAM_SIZE; i++)
+            {
+                if (i > 0)
+                    out << ',';
+                out << histogram[i];
+            }
+            out << ']';
+        }
+
+        std::string LockProfiler::json()
+        {
+            std::vector<LockStats> all;
+            stats(all);
+
+            std::ostringstream out;
+            out << "{\"enabled\":" << (enabled() ? "true" : "false")
+                << ",\"locks\":[";
+
+            for (size_t i = 0; i < all.size(); i++)
+            {
+                const LockStats &s = all[i];
+                if (i > 0)
+                    out << ',';
+
+                out << "{\"name\":";
+                write_json_string(out,s.name_);
+                out << ",\"instances\":" << s.instances_
+                    << ",\"acquisitions\":" << s.acquisitions_
+                    << ",\"contended\":" << s.contended_
+                    << ",\"wait_time_us\":" << s.wait_time_
+                    << ",\"hold_time_us\":" << s.hold_time_
+                    << ",\"wait_histogram\":";
+                write_json_histogram(out,s.wait_histogram_);
+                out << ",\"hold_histogram\":";
+                write_json_histogram(out,s.hold_histogram_);
+                out << '}';
+            }
+
+            out << "]}";
+            return out.str();
+        }
+
+        tuint64 LockProfiler::now()
+        {
+            return system::time_us();
+        }
+    }
+}
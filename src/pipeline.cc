@@ -0,0 +1,224 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ckcore/assert.hh"
+#include "ckcore/locker.hh"
+#include "ckcore/system.hh"
+#include "ckcore/pipeline.hh"
+
+namespace ckcore
+{
+    Pipeline::StageStats::StageStats()
+        : bytes_in_(0),bytes_out_(0),run_time_(0),input_wait_(0),output_wait_(0)
+    {
+    }
+
+    tuint64 Pipeline::StageStats::throughput() const
+    {
+        if (run_time_ == 0)
+            return 0;
+
+        return bytes_in_ * 1000000 / run_time_;
+    }
+
+    tuint64 Pipeline::StageStats::busy_time() const
+    {
+        tuint64 wait = input_wait_ + output_wait_;
+        return run_time_ > wait ? run_time_ - wait : 0;
+    }
+
+    Pipeline::MeteredInStream::MeteredInStream(InStream &stream,StageStats &stats)
+        : stream_(stream),stats_(stats)
+    {
+    }
+
+    tint64 Pipeline::MeteredInStream::read(void *buffer,tuint32 count)
+    {
+        tuint64 start = system::time_us();
+        tint64 res = stream_.read(buffer,count);
+        stats_.input_wait_ += system::time_us() - start;
+
+        if (res > 0)
+            stats_.bytes_in_ += res;
+
+        return res;
+    }
+
+    tint64 Pipeline::MeteredInStream::size()
+    {
+        return stream_.size();
+    }
+
+    bool Pipeline::MeteredInStream::end()
+    {
+        // Checking for the end of a ring waits for input.
+        tuint64 start = system::time_us();
+        bool res = stream_.end();
+        stats_.input_wait_ += system::time_us() - start;
+
+        return res;
+    }
+
+    bool Pipeline::MeteredInStream::seek(tuint32 distance,StreamWhence whence)
+    {
+        return stream_.seek(distance,whence);
+    }
+
+    Pipeline::MeteredOutStream::MeteredOutStream(OutStream &stream,StageStats &stats)
+        : stream_(stream),stats_(stats)
+    {
+    }
+
+    tint64 Pipeline::MeteredOutStream::write(const void *buffer,tuint32 count)
+    {
+        tuint64 start = system::time_us();
+        tint64 res = stream_.write(buffer,count);
+        stats_.output_wait_ += system::time_us() - start;
+
+        if (res > 0)
+            stats_.bytes_out_ += res;
+
+        return res;
+    }
+
+    Pipeline::StageTask::StageTask(Pipeline &pipeline,tuint32 index,InStream &in,
+                                   OutStream &out,PipeStream *in_pipe,
+                                   PipeStream *out_pipe)
+        : pipeline_(pipeline),index_(index),in_(in),out_(out),
+          in_pipe_(in_pipe),out_pipe_(out_pipe)
+    {
+    }
+
+    void Pipeline::StageTask::start()
+    {
+        // Stages spend much of their time waiting on each other, let the
+        // pool start the remaining stages even if it runs out of threads.
+        ThreadPool::BlockingScope scope(pipeline_.pool_);
+
+        StageStats &stats = pipeline_.stats_[index_];
+        MeteredInStream in(in_,stats);
+        MeteredOutStream out(out_,stats);
+
+        tuint64 start = system::time_us();
+
+        bool res = false;
+        try
+        {
+            res = pipeline_.stages_[index_]->process(in,out);
+        }
+        catch (...)
+        {
+        }
+
+        // Signal the end of the stream to the next stage, and make the
+        // previous stage fail if it still has data to write.
+        if (out_pipe_ != NULL)
+            out_pipe_->writer().close();
+        if (in_pipe_ != NULL)
+            in_pipe_->reader().close();
+
+        stats.run_time_ = system::time_us() - start;
+
+        pipeline_.finished(res);
+    }
+
+    Pipeline::Pipeline(tuint32 buffer_size)
+        : pool_(ThreadPool::instance()),buffer_size_(buffer_size),
+          remaining_(0),failed_(false),mutex_("Pipeline")
+    {
+    }
+
+    Pipeline::Pipeline(ThreadPool &pool,tuint32 buffer_size)
+        : pool_(pool),buffer_size_(buffer_size),remaining_(0),failed_(false),
+          mutex_("Pipeline")
+    {
+    }
+
+    void Pipeline::finished(bool result)
+    {
+        Locker<thread::Mutex> lock(mutex_);
+
+        if (!result)
+            failed_ = true;
+
+        if (--remaining_ == 0)
+            finished_.signal_all();
+    }
+
+    tuint32 Pipeline::add(PipelineStage &stage)
+    {
+        stages_.push_back(&stage);
+        stats_.push_back(StageStats());
+
+        return static_cast<tuint32>(stages_.size() - 1);
+    }
+
+    bool Pipeline::execute(InStream &source,OutStream &sink)
+    {
+        const size_t count = stages_.size();
+        if (count == 0)
+            return stream::copy(source,sink);
+
+        std::vector<PipeStream *> pipes;
+        for (size_t i = 0; i + 1 < count; i++)
+            pipes.push_back(new PipeStream(buffer_size_));
+
+        std::vector<Task *> tasks;
+        for (size_t i = 0; i < count; i++)
+        {
+            stats_[i] = StageStats();
+
+            PipeStream *in_pipe = i > 0 ? pipes[i - 1] : NULL;
+            PipeStream *out_pipe = i + 1 < count ? pipes[i] : NULL;
+
+            InStream &in = in_pipe != NULL ? in_pipe->reader() : source;
+            OutStream &out = out_pipe != NULL ?
+                static_cast<OutStream &>(out_pipe->writer()) : sink;
+
+            tasks.push_back(new StageTask(*this,static_cast<tuint32>(i),in,out,
+                                          in_pipe,out_pipe));
+        }
+
+        remaining_ = static_cast<tuint32>(count);
+        failed_ = false;
+
+        ckVERIFY(pool_.start_batch(tasks));
+
+        Locker<thread::Mutex> lock(mutex_);
+        while (remaining_ > 0)
+            finished_.wait(mutex_);
+        bool res = !failed_;
+        ckVERIFY(lock.unlock());
+
+        for (size_t i = 0; i < pipes.size(); i++)
+            delete pipes[i];
+
+        return res;
+    }
+
+    tuint32 Pipeline::size() const
+    {
+        return static_cast<tuint32>(stages_.size());
+    }
+
+    const Pipeline::StageStats &Pipeline::stats(tuint32 index) const
+    {
+        ckASSERT(index < stats_.size());
+        return stats_[index];
+    }
+}
@@ -0,0 +1,260 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <new>
+#include "ckcore/atomic.hh"
+#include "ckcore/bufferpool.hh"
+#include "ckcore/pipestream.hh"
+
+namespace ckcore
+{
+    PipeStream::Reader::Reader(PipeStream &pipe) : pipe_(pipe)
+    {
+    }
+
+    const unsigned char *PipeStream::Reader::peek(tuint32 &count)
+    {
+        tuint32 avail = pipe_.wait_data();
+        if (avail == 0)
+        {
+            count = 0;
+            return NULL;
+        }
+
+        const tuint32 pos = static_cast<tuint32>(pipe_.head_) & pipe_.mask_;
+        const tuint32 contiguous = pipe_.mask_ + 1 - pos;
+
+        count = avail < contiguous ? avail : contiguous;
+        return pipe_.buffer_ + pos;
+    }
+
+    void PipeStream::Reader::consume(tuint32 count)
+    {
+        // A full barrier is needed between publishing the new position and
+        // checking whether the writer is waiting.
+        atomic::exchange(pipe_.head_,static_cast<tint32>(
+            static_cast<tuint32>(pipe_.head_) + count));
+
+        if (atomic::load(pipe_.writer_waiting_) != 0)
+            pipe_.space_ready_.set();
+    }
+
+    void PipeStream::Reader::close()
+    {
+        atomic::exchange(pipe_.reader_closed_,1);
+        pipe_.space_ready_.set();
+    }
+
+    tint64 PipeStream::Reader::read(void *buffer,tuint32 count)
+    {
+        if (count == 0)
+            return 0;
+
+        tuint32 avail = pipe_.wait_data();
+        if (avail > count)
+            avail = count;
+
+        // Copy in up to two pieces if the data wraps around the ring.
+        const tuint32 pos = static_cast<tuint32>(pipe_.head_) & pipe_.mask_;
+        const tuint32 first = avail < pipe_.mask_ + 1 - pos ? avail : pipe_.mask_ + 1 - pos;
+
+        memcpy(buffer,pipe_.buffer_ + pos,first);
+        memcpy(static_cast<unsigned char *>(buffer) + first,pipe_.buffer_,avail - first);
+
+        if (avail > 0)
+            consume(avail);
+
+        return avail;
+    }
+
+    tint64 PipeStream::Reader::size()
+    {
+        return -1;
+    }
+
+    bool PipeStream::Reader::end()
+    {
+        return pipe_.wait_data() == 0;
+    }
+
+    bool PipeStream::Reader::seek(tuint32 distance,StreamWhence whence)
+    {
+        if (whence != ckSTREAM_CURRENT)
+            return false;
+
+        while (distance > 0)
+        {
+            tuint32 count = 0;
+            if (peek(count) == NULL)
+                return false;
+
+            if (count > distance)
+                count = distance;
+
+            consume(count);
+            distance -= count;
+        }
+
+        return true;
+    }
+
+    PipeStream::Writer::Writer(PipeStream &pipe) : pipe_(pipe)
+    {
+    }
+
+    unsigned char *PipeStream::Writer::reserve(tuint32 &count)
+    {
+        tuint32 free = pipe_.wait_space();
+        if (free == 0)
+        {
+            count = 0;
+            return NULL;
+        }
+
+        const tuint32 pos = static_cast<tuint32>(pipe_.tail_) & pipe_.mask_;
+        const tuint32 contiguous = pipe_.mask_ + 1 - pos;
+
+        if (count > free)
+            count = free;
+        if (count > contiguous)
+            count = contiguous;
+
+        return pipe_.buffer_ + pos;
+    }
+
+    void PipeStream::Writer::commit(tuint32 count)
+    {
+        // A full barrier is needed between publishing the new position and
+        // checking whether the reader is waiting.
+        atomic::exchange(pipe_.tail_,static_cast<tint32>(
+            static_cast<tuint32>(pipe_.tail_) + count));
+
+        if (atomic::load(pipe_.reader_waiting_) != 0)
+            pipe_.data_ready_.set();
+    }
+
+    void PipeStream::Writer::close()
+    {
+        atomic::exchange(pipe_.writer_closed_,1);
+        pipe_.data_ready_.set();
+    }
+
+    tint64 PipeStream::Writer::write(const void *buffer,tuint32 count)
+    {
+        const unsigned char *data = static_cast<const unsigned char *>(buffer);
+
+        tuint32 written = 0;
+        while (written < count)
+        {
+            tuint32 reserved = count - written;
+            unsigned char *space = reserve(reserved);
+            if (space == NULL)
+                return written > 0 ? static_cast<tint64>(written) : -1;
+
+            memcpy(space,data + written,reserved);
+            commit(reserved);
+            written += reserved;
+        }
+
+        return written;
+    }
+
+    PipeStream::PipeStream(tuint32 capacity)
+        : head_(0),reader_waiting_(0),tail_(0),writer_waiting_(0),
+          writer_closed_(0),reader_closed_(0),reader_(*this),writer_(*this)
+    {
+        tuint32 size = 1;
+        while (size < capacity)
+            size <<= 1;
+
+        buffer_ = static_cast<unsigned char *>(BufferPool::instance().allocate(size));
+        if (buffer_ == NULL)
+            throw std::bad_alloc();
+        mask_ = size - 1;
+    }
+
+    PipeStream::~PipeStream()
+    {
+        BufferPool::instance().release(buffer_,mask_ + 1);
+    }
+
+    tuint32 PipeStream::wait_data()
+    {
+        const tuint32 head = static_cast<tuint32>(head_);
+        for (;;)
+        {
+            tuint32 avail = static_cast<tuint32>(atomic::load(tail_)) - head;
+            if (avail > 0)
+                return avail;
+
+            // The writer commits all data before closing the pipe.
+            if (atomic::load(writer_closed_) != 0)
+                return static_cast<tuint32>(atomic::load(tail_)) - head;
+
+            // Announce that we're about to wait and check again, the writer
+            // sets the event if it adds data after seeing the flag.
+            atomic::exchange(reader_waiting_,1);
+            if (static_cast<tuint32>(atomic::load(tail_)) == head &&
+                atomic::load(writer_closed_) == 0)
+            {
+                data_ready_.wait();
+            }
+
+            atomic::store(reader_waiting_,0);
+        }
+    }
+
+    tuint32 PipeStream::wait_space()
+    {
+        const tuint32 tail = static_cast<tuint32>(tail_);
+        for (;;)
+        {
+            if (atomic::load(reader_closed_) != 0)
+                return 0;
+
+            tuint32 free = mask_ + 1 - (tail - static_cast<tuint32>(atomic::load(head_)));
+            if (free > 0)
+                return free;
+
+            atomic::exchange(writer_waiting_,1);
+            if (tail - static_cast<tuint32>(atomic::load(head_)) == mask_ + 1 &&
+                atomic::load(reader_closed_) == 0)
+            {
+                space_ready_.wait();
+            }
+
+            atomic::store(writer_waiting_,0);
+        }
+    }
+
+    PipeStream::Reader &PipeStream::reader()
+    {
+        return reader_;
+    }
+
+    PipeStream::Writer &PipeStream::writer()
+    {
+        return writer_;
+    }
+
+    tuint32 PipeStream::capacity() const
+    {
+        return mask_ + 1;
+    }
+}
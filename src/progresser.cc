@@ -26,6 +26,12 @@ namespace ckcore
     {
     }
 
+    Progresser::Progresser(Progress &progress,tuint64 total,
+                           const CancellationToken &token) :
+        progress_(progress),total_(total),count_(0),token_(token)
+    {
+    }
+
     void Progresser::update(tuint64 count)
     {
         count_ += count;
@@ -44,6 +50,9 @@ namespace ckcore
 
     bool Progresser::cancelled()
     {
+        if (token_.cancellable())
+            return token_.cancelled();
+
         return progress_.cancelled();
     }
 }
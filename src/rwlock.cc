@@ -0,0 +1,164 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ckcore/atomic.hh"
+#include "ckcore/rwlock.hh"
+
+namespace ckcore
+{
+    namespace thread
+    {
+        RWLock::RWLock() : state_(0),writers_waiting_(0)
+        {
+        }
+
+        RWLock::~RWLock()
+        {
+        }
+
+        bool RWLock::try_add_reader()
+        {
+            tint32 state = atomic::load(state_);
+            while (!(state & (WRITER | WRITER_WAITING)))
+            {
+                if ((state & READER_MASK) == READER_MASK)
+                    return false;
+
+                tint32 prev = atomic::compare_exchange(state_,state,state + 1);
+                if (prev == state)
+                    return true;
+
+                state = prev;
+            }
+
+            return false;
+        }
+
+        void RWLock::update(tint32 set,tint32 clear)
+        {
+            tint32 state = atomic::load(state_);
+            for (;;)
+            {
+                tint32 prev = atomic::compare_exchange(state_,state,
+                                                       (state | set) & ~clear);
+                if (prev == state)
+                    break;
+
+                state = prev;
+            }
+        }
+
+        bool RWLock::lock()
+        {
+            if (!mutex_.lock())
+                return false;
+
+            writers_waiting_++;
+            update(WRITER_WAITING,0);
+
+            // Readers releasing the lock signal us while holding the mutex, so
+            // checking the state while holding the mutex can't miss a wakeup.
+            for (;;)
+            {
+                tint32 state = atomic::load(state_);
+                if (!(state & (WRITER | READER_MASK)))
+                {
+                    if (atomic::compare_exchange(state_,state,state | WRITER) == state)
+                        break;
+
+                    continue;
+                }
+
+                writers_cond_.wait(mutex_);
+            }
+
+            if (--writers_waiting_ == 0)
+                update(0,WRITER_WAITING);
+
+            return mutex_.unlock();
+        }
+
+        bool RWLock::unlock()
+        {
+            if (!(atomic::load(state_) & WRITER))
+                return false;
+
+            if (!mutex_.lock())
+                return false;
+
+            update(0,WRITER);
+
+            // Prefer writers over readers.
+            if (writers_waiting_ > 0)
+                writers_cond_.signal_one();
+            else
+                readers_cond_.signal_all();
+
+            return mutex_.unlock();
+        }
+
+        bool RWLock::try_lock()
+        {
+            tint32 state = atomic::load(state_);
+            if (state & (WRITER | READER_MASK))
+                return false;
+
+            return atomic::compare_exchange(state_,state,state | WRITER) == state;
+        }
+
+        bool RWLock::lock_shared()
+        {
+            if (try_add_reader())
+                return true;
+
+            if (!mutex_.lock())
+                return false;
+
+            while (!try_add_reader())
+                readers_cond_.wait(mutex_);
+
+            return mutex_.unlock();
+        }
+
+        bool RWLock::unlock_shared()
+        {
+            tint32 state = atomic::load(state_);
+            if ((state & READER_MASK) == 0)
+                return false;
+
+            state = atomic::add(state_,-1);
+
+            // Wake a writer if this was the last reader.
+            if ((state & READER_MASK) == 0 && (state & WRITER_WAITING))
+            {
+                if (!mutex_.lock())
+                    return false;
+
+                writers_cond_.signal_one();
+                return mutex_.unlock();
+            }
+
+            return true;
+        }
+
+        bool RWLock::try_lock_shared()
+        {
+            return try_add_reader();
+        }
+    }
+}
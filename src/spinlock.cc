@@ -0,0 +1,115 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _WINDOWS
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+#include "ckcore/atomic.hh"
+#include "ckcore/thread.hh"
+#include "ckcore/spinlock.hh"
+
+namespace ckcore
+{
+    namespace thread
+    {
+        /**
+         * Gives up the remaining time slice of the calling thread.
+         */
+        static void yield_processor()
+        {
+#ifdef _WINDOWS
+            SwitchToThread();
+#else
+            sched_yield();
+#endif
+        }
+
+        SpinLock::SpinLock() : state_(0),spins_(MIN_SPINS)
+        {
+        }
+
+        bool SpinLock::lock()
+        {
+            if (atomic::exchange(state_,1) == 0)
+                return true;
+
+            static const bool multiprocessor = ideal_count() > 1;
+
+            tint32 max_spins = 0;
+            if (multiprocessor)
+            {
+                max_spins = atomic::load(spins_) * 2;
+                if (max_spins > MAX_SPINS)
+                    max_spins = MAX_SPINS;
+            }
+
+            tint32 spins = 0;
+            tint32 backoff = 1;
+            for (;;)
+            {
+                // Only attempt the exchange when the lock looks free to avoid
+                // bouncing the cache line between processors.
+                if (atomic::load(state_) == 0 &&
+                    atomic::exchange(state_,1) == 0)
+                {
+                    break;
+                }
+
+                if (spins < max_spins)
+                {
+                    for (tint32 i = 0; i < backoff; i++)
+                        atomic::pause();
+
+                    spins++;
+                    if (backoff < MAX_BACKOFF)
+                        backoff <<= 1;
+                }
+                else
+                {
+                    yield_processor();
+                }
+            }
+
+            // Move the estimate an eighth of the way towards the number of
+            // spins used this time.
+            if (multiprocessor)
+            {
+                tint32 estimate = atomic::load(spins_);
+                estimate += (spins - estimate) / 8;
+                if (estimate < MIN_SPINS)
+                    estimate = MIN_SPINS;
+
+                atomic::store(spins_,estimate);
+            }
+
+            return true;
+        }
+
+        bool SpinLock::unlock()
+        {
+            return atomic::exchange(state_,0) == 1;
+        }
+
+        bool SpinLock::try_lock()
+        {
+            return atomic::load(state_) == 0 && atomic::exchange(state_,1) == 0;
+        }
+    }
+}
@@ -18,6 +18,7 @@
 
 #include <string.h>
 #include "ckcore/system.hh"
+#include "ckcore/bufferpool.hh"
 #include "ckcore/stream.hh"
 
 namespace ckcore
@@ -32,7 +33,8 @@ namespace ckcore
             if (buffer_size == 0)
                 buffer_size = 8192;*/
 
-            unsigned char *buffer = new unsigned char[buffer_size];
+            PooledBuffer pooled_buffer(buffer_size);
+            unsigned char *buffer = pooled_buffer.data();
             if (buffer == NULL)
                 return false;
 
@@ -41,20 +43,41 @@ namespace ckcore
             {
                 res = from.read(buffer,buffer_size);
                 if (res == -1)
-                {
-                    delete [] buffer;
                     return false;
-                }
 
                 res = to.write(buffer,(tuint32)res);
                 if (res == -1)
-                {
-                    delete [] buffer;
                     return false;
-                }
             }
 
-            delete [] buffer;
+            return true;
+        }
+
+        bool copy(InStream &from,OutStream &to,const CancellationToken &token)
+        {
+            tuint32 buffer_size = 8192;
+
+            PooledBuffer pooled_buffer(buffer_size);
+            unsigned char *buffer = pooled_buffer.data();
+            if (buffer == NULL)
+                return false;
+
+            tint64 res = 0;
+            while (!from.end())
+            {
+                // Check if we should cancel.
+                if (token.cancelled())
+                    return false;
+
+                res = from.read(buffer,buffer_size);
+                if (res == -1)
+                    return false;
+
+                res = to.write(buffer,(tuint32)res);
+                if (res == -1)
+                    return false;
+            }
+
             return true;
         }
 
@@ -66,7 +89,8 @@ namespace ckcore
             if (buffer_size == 0)
                 buffer_size = 8192;*/
 
-            unsigned char *buffer = new unsigned char[buffer_size];
+            PooledBuffer pooled_buffer(buffer_size);
+            unsigned char *buffer = pooled_buffer.data();
             if (buffer == NULL)
                 return false;
 
@@ -83,17 +107,11 @@ namespace ckcore
 
                 res = from.read(buffer,buffer_size);
                 if (res == -1)
-                {
-                    delete [] buffer;
                     return false;
-                }
 
                 res = to.write(buffer,(tuint32)res);
                 if (res == -1)
-                {
-                    delete [] buffer;
                     return false;
-                }
 
                 // Update progress.
                 if (total != -1)
@@ -107,7 +125,6 @@ namespace ckcore
             if (total != -1)
                 progress.set_progress(100);
 
-            delete [] buffer;
             return true;
         }
 
@@ -119,7 +136,8 @@ namespace ckcore
             if (buffer_size == 0)
                 buffer_size = 8192;*/
 
-            unsigned char *buffer = new unsigned char[buffer_size];
+            PooledBuffer pooled_buffer(buffer_size);
+            unsigned char *buffer = pooled_buffer.data();
             if (buffer == NULL)
                 return false;
 
@@ -132,23 +150,16 @@ namespace ckcore
 
                 res = from.read(buffer,buffer_size);
                 if (res == -1)
-                {
-                    delete [] buffer;
                     return false;
-                }
 
                 res = to.write(buffer,(tuint32)res);
                 if (res == -1)
-                {
-                    delete [] buffer;
                     return false;
-                }
 
                 // Update progress.
                 progresser.update(res);
             }
 
-            delete [] buffer;
             return true;
         }
 
@@ -161,7 +172,8 @@ namespace ckcore
             if (buffer_size == 0)
                 buffer_size = 8192;*/
 
-            unsigned char *buffer = new unsigned char[buffer_size];
+            PooledBuffer pooled_buffer(buffer_size);
+            unsigned char *buffer = pooled_buffer.data();
             if (buffer == NULL)
                 return false;
 
@@ -176,17 +188,11 @@ namespace ckcore
                                   static_cast<tuint32>(size) : buffer_size;
                 res = from.read(buffer,to_read);
                 if (res == -1)
-                {
-                    delete [] buffer;
                     return false;
-                }
 
                 res = to.write(buffer,static_cast<tuint32>(res));
                 if (res == -1)
-                {
-                    delete [] buffer;
                     return false;
-                }
 
                 size -= res;
 
@@ -204,10 +210,7 @@ namespace ckcore
 
                 res = to.write(buffer,to_write);
                 if (res == -1)
-                {
-                    delete [] buffer;
                     return false;
-                }
 
                 size -= res;
 
@@ -215,7 +218,6 @@ namespace ckcore
                 progresser.update(res);
             }
 
-            delete [] buffer;
             return true;
         }
     }
@@ -23,6 +23,7 @@
 #include <intrin.h>
 #elif defined(_UNIX)
 #include <sys/time.h>
+#include <time.h>
 #else
 #error "Unknown platform."
 #endif
@@ -37,6 +38,12 @@ namespace ckcore
         {
 #ifdef _WINDOWS
             return GetTickCount();
+#elif defined(CLOCK_MONOTONIC)
+            // Use the monotonic clock so that the result is not affected by
+            // changes to the wall-clock time.
+            struct timespec time;
+            clock_gettime(CLOCK_MONOTONIC,&time);
+            return (tuint64)time.tv_sec * 1000 + (time.tv_nsec / 1000000);
 #else
             struct timeval time;
             gettimeofday(&time,(struct timezone *)0);
@@ -44,6 +51,29 @@ namespace ckcore
 #endif
         }
 
+        tuint64 time_us()
+        {
+#ifdef _WINDOWS
+            static LARGE_INTEGER frequency = { 0 };
+            if (frequency.QuadPart == 0)
+                QueryPerformanceFrequency(&frequency);
+
+            LARGE_INTEGER counter;
+            QueryPerformanceCounter(&counter);
+            return (tuint64)(counter.QuadPart / frequency.QuadPart * 1000000 +
+                             counter.QuadPart % frequency.QuadPart * 1000000 /
+                             frequency.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+            struct timespec time;
+            clock_gettime(CLOCK_MONOTONIC,&time);
+            return (tuint64)time.tv_sec * 1000000 + (time.tv_nsec / 1000);
+#else
+            struct timeval time;
+            gettimeofday(&time,(struct timezone *)0);
+            return (tuint64)time.tv_sec * 1000000 + time.tv_usec;
+#endif
+        }
+
         tuint64 ticks()
         {
 #ifdef _WINDOWS
@@ -0,0 +1,267 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ckcore/assert.hh"
+#include "ckcore/atomic.hh"
+#include "ckcore/locker.hh"
+#include "ckcore/system.hh"
+#include "ckcore/taskgraph.hh"
+
+namespace ckcore
+{
+    TaskGraph::NodeData::NodeData(Task *task)
+        : task_(task),predecessors_(0),pending_(0),start_time_(0),end_time_(0)
+    {
+    }
+
+    TaskGraph::NodeTask::NodeTask(TaskGraph &graph,Node node)
+        : graph_(graph),node_(node)
+    {
+    }
+
+    void TaskGraph::NodeTask::start()
+    {
+        NodeData &node = *graph_.nodes_[node_];
+        node.start_time_ = system::time();
+
+        if (node.task_ != NULL && !node.task_->cancellation_token().cancelled())
+        {
+            try
+            {
+                node.task_->start();
+            }
+            catch (...)
+            {
+            }
+        }
+
+        node.end_time_ = system::time();
+
+        if (node.task_ != NULL && node.task_->auto_delete())
+        {
+            delete node.task_;
+            node.task_ = NULL;
+        }
+
+        graph_.finished(node_);
+    }
+
+    TaskGraph::TaskGraph()
+        : pool_(ThreadPool::instance()),remaining_(0),done_(false),
+          mutex_("TaskGraph"),crit_time_(0)
+    {
+    }
+
+    TaskGraph::TaskGraph(ThreadPool &pool)
+        : pool_(pool),remaining_(0),done_(false),mutex_("TaskGraph"),
+          crit_time_(0)
+    {
+    }
+
+    TaskGraph::~TaskGraph()
+    {
+        std::vector<NodeData *>::iterator it;
+        for (it = nodes_.begin(); it != nodes_.end(); it++)
+        {
+            if ((*it)->task_ != NULL && (*it)->task_->auto_delete())
+                delete (*it)->task_;
+
+            delete *it;
+        }
+    }
+
+    bool TaskGraph::sort()
+    {
+        order_.clear();
+        order_.reserve(nodes_.size());
+
+        std::vector<tuint32> pending(nodes_.size());
+        for (size_t i = 0; i < nodes_.size(); i++)
+        {
+            pending[i] = nodes_[i]->predecessors_;
+            if (pending[i] == 0)
+                order_.push_back(static_cast<Node>(i));
+        }
+
+        // The order vector doubles as the work list.
+        for (size_t i = 0; i < order_.size(); i++)
+        {
+            const std::vector<Node> &successors = nodes_[order_[i]]->successors_;
+
+            std::vector<Node>::const_iterator it;
+            for (it = successors.begin(); it != successors.end(); it++)
+            {
+                if (--pending[*it] == 0)
+                    order_.push_back(*it);
+            }
+        }
+
+        return order_.size() == nodes_.size();
+    }
+
+    void TaskGraph::finished(Node node)
+    {
+        // Start all successors that don't have any unfinished predecessors.
+        std::vector<Task *> ready;
+
+        const std::vector<Node> &successors = nodes_[node]->successors_;
+        std::vector<Node>::const_iterator it;
+        for (it = successors.begin(); it != successors.end(); it++)
+        {
+            if (atomic::add(nodes_[*it]->pending_,-1) == 0)
+                ready.push_back(new NodeTask(*this,*it));
+        }
+
+        if (!ready.empty())
+            pool_.start_batch(ready);
+
+        if (atomic::add(remaining_,-1) == 0)
+        {
+            Locker<thread::Mutex> lock(mutex_);
+            done_ = true;
+            finished_.signal_all();
+        }
+    }
+
+    void TaskGraph::calc_critical_path()
+    {
+        crit_path_.clear();
+        crit_time_ = 0;
+
+        if (order_.empty())
+            return;
+
+        // Longest path to the end of each node, and the predecessor on it.
+        std::vector<tuint64> time(nodes_.size(),0);
+        std::vector<tint64> prev(nodes_.size(),-1);
+
+        Node last = order_.front();
+
+        std::vector<Node>::const_iterator it;
+        for (it = order_.begin(); it != order_.end(); it++)
+        {
+            tuint64 end = time[*it] + duration(*it);
+
+            const std::vector<Node> &successors = nodes_[*it]->successors_;
+            std::vector<Node>::const_iterator it_succ;
+            for (it_succ = successors.begin(); it_succ != successors.end(); it_succ++)
+            {
+                if (prev[*it_succ] == -1 || end > time[*it_succ])
+                {
+                    time[*it_succ] = end;
+                    prev[*it_succ] = *it;
+                }
+            }
+
+            time[*it] = end;
+            if (end > crit_time_)
+            {
+                crit_time_ = end;
+                last = *it;
+            }
+        }
+
+        for (tint64 node = last; node != -1; node = prev[static_cast<size_t>(node)])
+            crit_path_.insert(crit_path_.begin(),static_cast<Node>(node));
+    }
+
+    TaskGraph::Node TaskGraph::add(Task *task)
+    {
+        nodes_.push_back(new NodeData(task));
+        return static_cast<Node>(nodes_.size() - 1);
+    }
+
+    bool TaskGraph::depend(Node node,Node predecessor)
+    {
+        if (node >= nodes_.size() || predecessor >= nodes_.size() ||
+            node == predecessor)
+        {
+            return false;
+        }
+
+        std::vector<Node> &successors = nodes_[predecessor]->successors_;
+        for (size_t i = 0; i < successors.size(); i++)
+        {
+            if (successors[i] == node)
+                return true;
+        }
+
+        successors.push_back(node);
+        nodes_[node]->predecessors_++;
+        return true;
+    }
+
+    bool TaskGraph::execute()
+    {
+        if (!sort())
+            return false;
+
+        if (nodes_.empty())
+        {
+            calc_critical_path();
+            return true;
+        }
+
+        done_ = false;
+        atomic::store(remaining_,static_cast<tint32>(nodes_.size()));
+
+        std::vector<Task *> roots;
+        for (size_t i = 0; i < nodes_.size(); i++)
+        {
+            NodeData &node = *nodes_[i];
+            node.start_time_ = node.end_time_ = 0;
+            atomic::store(node.pending_,static_cast<tint32>(node.predecessors_));
+
+            if (node.predecessors_ == 0)
+                roots.push_back(new NodeTask(*this,static_cast<Node>(i)));
+        }
+
+        pool_.start_batch(roots);
+
+        Locker<thread::Mutex> lock(mutex_);
+        while (!done_)
+            finished_.wait(mutex_);
+        ckVERIFY(lock.unlock());
+
+        calc_critical_path();
+        return true;
+    }
+
+    tuint32 TaskGraph::size() const
+    {
+        return static_cast<tuint32>(nodes_.size());
+    }
+
+    tuint64 TaskGraph::duration(Node node) const
+    {
+        if (node >= nodes_.size())
+            return 0;
+
+        return nodes_[node]->end_time_ - nodes_[node]->start_time_;
+    }
+
+    const std::vector<TaskGraph::Node> &TaskGraph::critical_path() const
+    {
+        return crit_path_;
+    }
+
+    tuint64 TaskGraph::critical_path_time() const
+    {
+        return crit_time_;
+    }
+}
@@ -18,36 +18,61 @@
 
 #include "ckcore/assert.hh"
 #include "ckcore/locker.hh"
+#include "ckcore/string.hh"
 #include "ckcore/thread.hh"
 #include "ckcore/threadpool.hh"
 
 namespace ckcore
 {
+    ThreadPool::BlockingScope::BlockingScope()
+        : pool_(ThreadPool::instance()),counted_(false)
+    {
+        counted_ = pool_.begin_blocking();
+    }
+
+    ThreadPool::BlockingScope::BlockingScope(ThreadPool &pool)
+        : pool_(pool),counted_(false)
+    {
+        counted_ = pool_.begin_blocking();
+    }
+
+    ThreadPool::BlockingScope::~BlockingScope()
+    {
+        if (counted_)
+            pool_.end_blocking();
+    }
+
     ThreadPool::InternalThread::InternalThread(ThreadPool &host,Task *task)
-        : host_(host),task_(task)
+        : host_(host),task_(task),id_(NULL)
     {
     }
 
     void ThreadPool::InternalThread::run()
     {
         Locker<thread::Mutex> lock(host_.mutex_);
+        id_ = thread::identifier();
 
         while (true)
         {
             // Check if we have a task to execute.
             while (task_ != NULL)
             {
-                ckVERIFY(lock.unlock());
-
-                try
+                // Tasks cancelled while waiting in the queue are dropped
+                // without being started.
+                if (!task_->cancellation_token().cancelled())
                 {
-                    task_->start();
-                }
-                catch (...)
-                {
-                }
+                    ckVERIFY(lock.unlock());
+
+                    try
+                    {
+                        task_->start();
+                    }
+                    catch (...)
+                    {
+                    }
 
-                ckVERIFY(lock.relock());
+                    ckVERIFY(lock.relock());
+                }
 
                 if (task_->auto_delete())
                     delete task_;
@@ -69,6 +94,7 @@ namespace ckcore
             if (host_.exiting_)
             {
                 host_.pol_threads_--;
+                id_ = NULL;
                 return;
             }
 
@@ -89,6 +115,7 @@ namespace ckcore
             {
                 host_.ret_threads_.push_back(this);
                 host_.pol_threads_--;
+                id_ = NULL;
                 return;
             }
 
@@ -101,29 +128,43 @@ namespace ckcore
         }
     }
 
-    ThreadPool::ThreadPool()
-        : exiting_(false),
-          max_threads_(thread::ideal_count()),pol_threads_(0),res_threads_(0),idl_threads_(0),
-          ret_timeout_(THREAD_RETIRE_TIMEOUT)
+    ThreadPool::ThreadPool(const tchar *name,tuint32 max_threads,
+                           tuint32 ret_timeout)
+        : name_(name),exiting_(false),
+          max_threads_(max_threads == 0 ? thread::ideal_count() : max_threads),
+          pol_threads_(0),res_threads_(0),idl_threads_(0),blk_threads_(0),
+          mutex_("ThreadPool"),ret_timeout_(ret_timeout),pin_threads_(false),timers_(*this)
     {
     }
 
     ThreadPool::~ThreadPool()
     {
-        // Wait for all tasks to complete.
+        // Stop starting scheduled tasks and wait for all tasks to complete.
+        timers_.stop();
         wait();
     }
 
     ThreadPool &ThreadPool::instance()
     {
-        static ThreadPool instance;
+        static ThreadPool instance(ckT("default"));
         return instance;
     }
 
+    const tstring &ThreadPool::name() const
+    {
+        return name_;
+    }
+
+    tuint32 ThreadPool::max_threads() const
+    {
+        return max_threads_;
+    }
+
     tuint32 ThreadPool::active_threads() const
     {
         return static_cast<tuint32>(all_threads_.size()) + res_threads_ -
-               static_cast<tuint32>(ret_threads_.size()) - idl_threads_;
+               static_cast<tuint32>(ret_threads_.size()) - idl_threads_ -
+               blk_threads_;
     }
 
     tuint32 ThreadPool::idle_threads() const
@@ -136,6 +177,11 @@ namespace ckcore
         return static_cast<tuint32>(ret_threads_.size());
     }
 
+    tuint32 ThreadPool::blocked_threads() const
+    {
+        return blk_threads_;
+    }
+
     tuint32 ThreadPool::queued() const
     {
         return static_cast<tuint32>(queue_.size());
@@ -149,14 +195,48 @@ namespace ckcore
         task_ready_.signal_one();
     }
 
+    void ThreadPool::wake(tuint32 count,tuint32 waiting)
+    {
+        if (count == 0)
+            return;
+
+        // If all waiting threads should wake up we can do so using a single
+        // broadcast.
+        if (count >= waiting)
+        {
+            task_ready_.signal_all();
+            return;
+        }
+
+        for (tuint32 i = 0; i < count; i++)
+            task_ready_.signal_one();
+    }
+
+    ThreadAttributes ThreadPool::thread_attributes(tuint32 index) const
+    {
+        ThreadAttributes attr = thr_attr_;
+        if (attr.name.empty())
+            attr.name = string::formatstr(ckT("%s/%u"),name_.c_str(),
+                                             static_cast<unsigned int>(index));
+
+        if (pin_threads_)
+        {
+            attr.cpu_affinity.clear();
+            attr.cpu_affinity.push_back(index % thread::ideal_count());
+        }
+
+        return attr;
+    }
+
     bool ThreadPool::spawn(Task *task)
     {
         InternalThread *thread = new InternalThread(*this,task);
+        thread->attr_ = thread_attributes(static_cast<tuint32>(all_threads_.size()));
 
         all_threads_.push_back(thread);
         pol_threads_++;
 
-        return thread->start();
+        return thread->start(thread->attr_);
     }
 
     bool ThreadPool::overworking() const
@@ -164,7 +244,7 @@ namespace ckcore
         return active_threads() > max_threads_;
     }
 
-    bool ThreadPool::try_start(Task *task)
+    bool ThreadPool::try_start(Task *task,tuint32 priority,tuint32 *wakeups)
     {
         // Check if we have any free thread so that the task can start
         // immediately.
@@ -172,11 +252,19 @@ namespace ckcore
             return false;
 
         // See if there is an idle thread waiting, in that case enqueue the
-        // task.
+        // task. If the caller collects wake-ups we leave the signaling to it.
         if (idl_threads_ > 0)
         {
             idl_threads_--;
-            enqueue(task);
+            if (wakeups != NULL)
+            {
+                queue_.push(std::make_pair(task,priority));
+                (*wakeups)++;
+            }
+            else
+            {
+                enqueue(task,priority);
+            }
             return true;
         }
 
@@ -191,7 +279,7 @@ namespace ckcore
             ckASSERT(!thread->running());
             ckASSERT(thread->task_ == NULL);
             thread->task_ = task;
-            thread->start();
+            thread->start(thread->attr_);
             return true;
         }
 
@@ -206,12 +294,47 @@ namespace ckcore
 
         // Try to task the task immediately, if not enqueue it.
         Locker<thread::Mutex> lock(mutex_);
-        if (!try_start(task))
+        if (!try_start(task,priority))
             enqueue(task,priority);
 
         return true;
     }
 
+    bool ThreadPool::start_batch(Task *const *tasks,size_t count,tuint32 priority)
+    {
+        if (tasks == NULL)
+            return false;
+
+        Locker<thread::Mutex> lock(mutex_);
+
+        // Remember how many threads that are waiting for work, if all of them
+        // are needed they will be woken up using a single broadcast.
+        tuint32 waiting = idl_threads_;
+        tuint32 wakeups = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (tasks[i] == NULL)
+                continue;
+
+            // Tasks that can't be started are only queued, there is no point
+            // in signaling when no thread is available to pick them up.
+            if (!try_start(tasks[i],priority,&wakeups))
+                queue_.push(std::make_pair(tasks[i],priority));
+        }
+
+        wake(wakeups,waiting);
+        return true;
+    }
+
+    bool ThreadPool::start_batch(const std::vector<Task *> &tasks,tuint32 priority)
+    {
+        if (tasks.empty())
+            return true;
+
+        return start_batch(&tasks[0],tasks.size(),priority);
+    }
+
     bool ThreadPool::start_now(Task *task)
     {
         if (task == NULL)
@@ -225,6 +348,27 @@ namespace ckcore
         return try_start(task);
     }
 
+    bool ThreadPool::start_after(Task *task,tuint32 delay,tuint32 priority)
+    {
+        if (delay == 0)
+            return start(task,priority);
+
+        return timers_.add(task,delay,0,priority);
+    }
+
+    bool ThreadPool::start_every(Task *task,tuint32 period,tuint32 priority)
+    {
+        if (period == 0)
+            return false;
+
+        return timers_.add(task,period,period,priority);
+    }
+
+    bool ThreadPool::cancel_timer(Task *task)
+    {
+        return timers_.cancel(task);
+    }
+
     void ThreadPool::wait()
     {
         Locker<thread::Mutex> lock(mutex_);
@@ -261,6 +405,7 @@ namespace ckcore
 
         pol_threads_ = 0;
         idl_threads_ = 0;
+        blk_threads_ = 0;
 
         exiting_ = false;
     }
@@ -284,9 +429,72 @@ namespace ckcore
         }
     }
 
+    bool ThreadPool::is_pool_thread() const
+    {
+        thandle id = thread::identifier();
+
+        std::vector<InternalThread *>::const_iterator it;
+        for (it = all_threads_.begin(); it != all_threads_.end(); it++)
+        {
+            if ((*it)->id_ == id)
+                return true;
+        }
+
+        return false;
+    }
+
+    bool ThreadPool::begin_blocking()
+    {
+        Locker<thread::Mutex> lock(mutex_);
+
+        // Blocking regions outside the pool threads must not be counted
+        // since they were never part of the active threads.
+        if (!is_pool_thread())
+        {
+            ckASSERT(false);
+            return false;
+        }
+
+        blk_threads_++;
+
+        // Let a queued task run while this thread is blocked. Any thread
+        // started here will retire once the blocked thread resumes since the
+        // pool will then be overworking.
+        if (!queue_.empty())
+        {
+            std::pair<Task *,tuint32> entry = queue_.top();
+            queue_.pop();
+
+            if (!try_start(entry.first,entry.second))
+                queue_.push(entry);
+        }
+
+        return true;
+    }
+
+    void ThreadPool::end_blocking()
+    {
+        Locker<thread::Mutex> lock(mutex_);
+
+        ckASSERT(blk_threads_ > 0);
+        blk_threads_--;
+    }
+
     void ThreadPool::set_retire_timeout(tuint32 timeout)
     {
         Locker<thread::Mutex> lock(mutex_);
         ret_timeout_ = timeout;
     }
+
+    void ThreadPool::set_thread_attributes(const ThreadAttributes &attr)
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        thr_attr_ = attr;
+    }
+
+    void ThreadPool::set_thread_pinning(bool enable)
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        pin_threads_ = enable;
+    }
 }
@@ -0,0 +1,386 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "ckcore/assert.hh"
+#include "ckcore/locker.hh"
+#include "ckcore/system.hh"
+#include "ckcore/threadpool.hh"
+#include "ckcore/timerwheel.hh"
+
+namespace ckcore
+{
+    TimerWheel::Timer::Timer(Task *task)
+        : prev_(NULL),next_(NULL),head_(NULL),task_(task),expires_(0),
+          period_(0),priority_(0),running_(false),cancelled_(false)
+    {
+    }
+
+    TimerWheel::Timer::~Timer()
+    {
+        if (task_ != NULL && task_->auto_delete())
+            delete task_;
+    }
+
+    TimerWheel::Runner::Runner(TimerWheel &host,Timer *timer)
+        : host_(host),timer_(timer)
+    {
+    }
+
+    void TimerWheel::Runner::start()
+    {
+        try
+        {
+            timer_->task_->start();
+        }
+        catch (...)
+        {
+        }
+
+        host_.finished(timer_);
+    }
+
+    TimerWheel::TimerThread::TimerThread(TimerWheel &host)
+        : host_(host)
+    {
+    }
+
+    void TimerWheel::TimerThread::run()
+    {
+        host_.run();
+    }
+
+    TimerWheel::TimerWheel(ThreadPool &pool)
+        : pool_(pool),thread_(*this),exiting_(false),cur_tick_(now()),
+          mutex_("TimerWheel")
+    {
+        memset(wheels_,0,sizeof(wheels_));
+    }
+
+    TimerWheel::~TimerWheel()
+    {
+        stop();
+    }
+
+    tuint64 TimerWheel::now()
+    {
+        return system::time() / TICK_INTERVAL;
+    }
+
+    void TimerWheel::insert(Timer *timer)
+    {
+        // Timers that have already expired are placed in the next slot to be
+        // processed.
+        tuint64 expires = timer->expires_;
+        if (expires <= cur_tick_)
+            expires = cur_tick_ + 1;
+
+        tuint64 delta = expires - cur_tick_;
+
+        int level = 0;
+        while (level < WHEEL_LEVELS - 1 &&
+               delta >= ((tuint64)1 << (WHEEL_BITS * (level + 1))))
+        {
+            level++;
+        }
+
+        // Timers beyond the range of the coarsest wheel are put in its last
+        // slot, they will be re-inserted when cascaded.
+        tuint64 range = (tuint64)1 << (WHEEL_BITS * WHEEL_LEVELS);
+        if (delta >= range)
+            expires = cur_tick_ + range - 1;
+
+        tuint32 index = (tuint32)(expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+        Timer *&head = wheels_[level][index];
+
+        timer->prev_ = NULL;
+        timer->next_ = head;
+        timer->head_ = &head;
+        if (head != NULL)
+            head->prev_ = timer;
+        head = timer;
+    }
+
+    void TimerWheel::unlink(Timer *timer)
+    {
+        if (timer->head_ == NULL)
+            return;
+
+        if (timer->prev_ != NULL)
+            timer->prev_->next_ = timer->next_;
+        else
+            *timer->head_ = timer->next_;
+
+        if (timer->next_ != NULL)
+            timer->next_->prev_ = timer->prev_;
+
+        timer->prev_ = timer->next_ = NULL;
+        timer->head_ = NULL;
+    }
+
+    void TimerWheel::cascade(int level,tuint32 index)
+    {
+        Timer *timer = wheels_[level][index];
+        wheels_[level][index] = NULL;
+
+        while (timer != NULL)
+        {
+            Timer *next = timer->next_;
+            insert(timer);
+            timer = next;
+        }
+    }
+
+    void TimerWheel::advance(std::vector<Timer *> &expired)
+    {
+        tuint64 target = now();
+        while (cur_tick_ < target)
+        {
+            cur_tick_++;
+
+            // Move timers down from the coarser wheels each time a finer wheel
+            // has completed a full turn.
+            tuint32 index = (tuint32)cur_tick_ & WHEEL_MASK;
+            if (index == 0)
+            {
+                for (int level = 1; level < WHEEL_LEVELS; level++)
+                {
+                    tuint32 upper = (tuint32)(cur_tick_ >> (WHEEL_BITS * level)) & WHEEL_MASK;
+                    cascade(level,upper);
+                    if (upper != 0)
+                        break;
+                }
+            }
+
+            Timer *timer = wheels_[0][index];
+            wheels_[0][index] = NULL;
+
+            while (timer != NULL)
+            {
+                Timer *next = timer->next_;
+                timer->prev_ = timer->next_ = NULL;
+                timer->head_ = NULL;
+
+                if (timer->expires_ > cur_tick_)
+                    insert(timer);
+                else
+                    expired.push_back(timer);
+
+                timer = next;
+            }
+        }
+    }
+
+    tuint32 TimerWheel::ticks_until_next() const
+    {
+        for (tuint32 i = 1; i < WHEEL_SIZE; i++)
+        {
+            tuint64 tick = cur_tick_ + i;
+
+            // Wake up at wheel turns to cascade timers.
+            tuint32 index = (tuint32)tick & WHEEL_MASK;
+            if (index == 0 || wheels_[0][index] != NULL)
+                return i;
+        }
+
+        return WHEEL_SIZE;
+    }
+
+    void TimerWheel::finished(Timer *timer)
+    {
+        Locker<thread::Mutex> lock(mutex_);
+
+        timer->running_ = false;
+        if (timer->cancelled_)
+            delete timer;
+    }
+
+    void TimerWheel::run()
+    {
+        Locker<thread::Mutex> lock(mutex_);
+
+        std::vector<Timer *> expired;
+        std::vector<std::pair<Task *,tuint32> > ready;
+
+        while (!exiting_)
+        {
+            advance(expired);
+
+            std::vector<Timer *>::const_iterator it;
+            for (it = expired.begin(); it != expired.end(); it++)
+            {
+                Timer *timer = *it;
+                if (timer->period_ == 0)
+                {
+                    timers_.erase(timer->task_);
+                    ready.push_back(std::make_pair(timer->task_,timer->priority_));
+
+                    // The task is now owned by the thread pool.
+                    timer->task_ = NULL;
+                    delete timer;
+                    continue;
+                }
+
+                // Periodic tasks are stopped when their token is cancelled.
+                if (timer->task_->cancellation_token().cancelled())
+                {
+                    timers_.erase(timer->task_);
+                    if (timer->running_)
+                        timer->cancelled_ = true;
+                    else
+                        delete timer;
+                    continue;
+                }
+
+                // Reschedule the timer, if we have fallen behind more than a
+                // period the missed runs are skipped.
+                timer->expires_ += timer->period_;
+                if (timer->expires_ <= cur_tick_)
+                    timer->expires_ = cur_tick_ + timer->period_;
+                insert(timer);
+
+                // Never run the same periodic task concurrently.
+                if (!timer->running_)
+                {
+                    timer->running_ = true;
+                    ready.push_back(std::make_pair(new Runner(*this,timer),
+                                                   timer->priority_));
+                }
+            }
+            expired.clear();
+
+            if (!ready.empty())
+            {
+                ckVERIFY(lock.unlock());
+
+                std::vector<std::pair<Task *,tuint32> >::const_iterator it_task;
+                for (it_task = ready.begin(); it_task != ready.end(); it_task++)
+                    pool_.start(it_task->first,it_task->second);
+                ready.clear();
+
+                ckVERIFY(lock.relock());
+                continue;
+            }
+
+            if (timers_.empty())
+                timer_added_.wait(mutex_);
+            else
+                timer_added_.wait(mutex_,ticks_until_next() * TICK_INTERVAL);
+        }
+    }
+
+    bool TimerWheel::add(Task *task,tuint32 delay,tuint32 period,
+                         tuint32 priority)
+    {
+        if (task == NULL)
+            return false;
+
+        Locker<thread::Mutex> lock(mutex_);
+
+        if (exiting_ || timers_.find(task) != timers_.end())
+            return false;
+
+        // If the wheel is empty it may not have been advanced for a long time,
+        // move it to the current time so it doesn't have to catch up.
+        if (timers_.empty())
+            cur_tick_ = now();
+
+        Timer *timer = new Timer(task);
+        // Round the exact expiration time up to the next tick. Adding whole
+        // ticks to now() could fire the timer up to one tick early since
+        // now() truncates the time elapsed in the current tick.
+        timer->expires_ = (system::time() + delay + TICK_INTERVAL - 1) / TICK_INTERVAL;
+        timer->priority_ = priority;
+        if (period > 0)
+        {
+            timer->period_ = (period + TICK_INTERVAL - 1) / TICK_INTERVAL;
+            if (timer->period_ == 0)
+                timer->period_ = 1;
+        }
+
+        insert(timer);
+        timers_[task] = timer;
+
+        if (!thread_.running())
+        {
+            ThreadAttributes attr;
+            attr.name = pool_.name() + ckT("/timer");
+            if (!thread_.start(attr))
+            {
+                unlink(timer);
+                timers_.erase(task);
+                timer->task_ = NULL;
+                delete timer;
+                return false;
+            }
+        }
+
+        timer_added_.signal_all();
+        return true;
+    }
+
+    bool TimerWheel::cancel(Task *task)
+    {
+        Locker<thread::Mutex> lock(mutex_);
+
+        std::map<Task *,Timer *>::iterator it = timers_.find(task);
+        if (it == timers_.end())
+            return false;
+
+        Timer *timer = it->second;
+        timers_.erase(it);
+        unlink(timer);
+
+        // Running periodic timers are deleted when the task finishes.
+        if (timer->running_)
+            timer->cancelled_ = true;
+        else
+            delete timer;
+
+        return true;
+    }
+
+    void TimerWheel::stop()
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        exiting_ = true;
+        timer_added_.signal_all();
+        ckVERIFY(lock.unlock());
+
+        thread_.wait();
+
+        ckVERIFY(lock.relock());
+        while (!timers_.empty())
+        {
+            Timer *timer = timers_.begin()->second;
+            timers_.erase(timers_.begin());
+            unlink(timer);
+
+            if (timer->running_)
+                timer->cancelled_ = true;
+            else
+                delete timer;
+        }
+    }
+
+    tuint32 TimerWheel::pending() const
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        return static_cast<tuint32>(timers_.size());
+    }
+}
@@ -16,37 +16,496 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sched.h>
+#endif
 #include <unistd.h>
+#ifdef _POSIX_SPAWN
+#include <spawn.h>
+#endif
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <algorithm>
 #include <map>
+#include "ckcore/bufferpool.hh"
 #include "ckcore/file.hh"
 #include "ckcore/string.hh"
+#include "ckcore/locker.hh"
 #include "ckcore/process.hh"
+#include "reactor.hh"
+
+extern char **environ;
 
 namespace ckcore
 {
     /**
-     * Singleton class for monitoring child processes.
+     * Creates a pipe with both ends closed on exec.
+     * @param [out] fd The pipe file descriptors.
+     * @return If successful true is returned, if unsuccessful false is
+     *         returned.
+     */
+    static bool create_pipe(int fd[2])
+    {
+#ifdef __linux__
+        if (pipe2(fd,O_CLOEXEC) == 0)
+            return true;
+#endif
+        if (pipe(fd) == -1)
+        {
+            fd[0] = fd[1] = -1;
+            return false;
+        }
+
+        fcntl(fd[0],F_SETFD,FD_CLOEXEC);
+        fcntl(fd[1],F_SETFD,FD_CLOEXEC);
+        return true;
+    }
+
+    /**
+     * @brief Options applied to a new process before executing it.
+     */
+    struct LaunchOptions
+    {
+        bool nice_set_;
+        int nice_;
+        int io_priority_;           ///< ioprio_set() value, -1 if not set.
+        bool affinity_set_;
+#ifdef __linux__
+        cpu_set_t affinity_;
+#endif
+        std::vector<std::pair<int,struct rlimit> > limits_;
+        std::vector<int> inherited_fds_;
+
+        LaunchOptions() : nice_set_(false),nice_(0),io_priority_(-1),
+            affinity_set_(false)
+        {
+        }
+
+        /**
+         * Checks if any options needs to be applied.
+         * @return If there are options to apply true is returned, otherwise
+         *         false is returned.
+         */
+        bool empty() const
+        {
+            return !nice_set_ && io_priority_ == -1 && !affinity_set_ && limits_.empty() &&
+                   inherited_fds_.empty();
+        }
+    };
+
+    /**
+     * Prepares the child process for executing the new program. Only async
+     * signal safe functions may be called since this is executed in a copy
+     * of, or even in the address space of the parent process.
+     * @param [in] fd The descriptors to use as standard input, output and
+     *                error.
+     * @param [in] options The options to apply.
+     * @return If successful zero is returned, otherwise the error number is
+     *         returned.
+     */
+    static int setup_child(const int fd[3],const LaunchOptions &options)
+    {
+        // Redirect STDIN, STDOUT and STDERR. The original descriptors are
+        // closed on exec.
+        if (dup2(fd[0],STDIN_FILENO) == -1 ||
+            dup2(fd[1],STDOUT_FILENO) == -1 ||
+            dup2(fd[2],STDERR_FILENO) == -1)
+        {
+            return errno;
+        }
+
+        // Inherited descriptors are passed as is. The descriptor flags are
+        // private to the child, the parent keeps closing them on exec.
+        for (size_t i = 0; i < options.inherited_fds_.size(); i++)
+        {
+            int flags = fcntl(options.inherited_fds_[i],F_GETFD);
+            if (flags == -1 ||
+                fcntl(options.inherited_fds_[i],F_SETFD,flags & ~FD_CLOEXEC) == -1)
+            {
+                return errno;
+            }
+        }
+
+        // The scheduling options are applied on a best effort basis.
+        if (options.nice_set_)
+            setpriority(PRIO_PROCESS,0,options.nice_);
+
+#ifdef __linux__
+#ifdef SYS_ioprio_set
+        if (options.io_priority_ != -1)
+            syscall(SYS_ioprio_set,1 /* IOPRIO_WHO_PROCESS */,0,options.io_priority_);
+#endif
+        if (options.affinity_set_)
+            sched_setaffinity(0,sizeof(options.affinity_),&options.affinity_);
+#endif
+
+        for (size_t i = 0; i < options.limits_.size(); i++)
+        {
+            if (setrlimit(options.limits_[i].first,&options.limits_[i].second) != 0)
+                return errno;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Starts a new process using fork() and execv().
+     * @param [in] path The path to the executable.
+     * @param [in] arg_list The NULL terminated argument list.
+     * @param [in] fd The descriptors to use as standard input, output and
+     *                error in the child process.
+     * @param [in] options The options to apply to the child process.
+     * @return If successful the process identifier is returned, otherwise
+     *         -1 is returned.
+     */
+    static pid_t launch_fork(const char *path,char *const arg_list[],const int fd[3],
+                             const LaunchOptions &options)
+    {
+        pid_t pid = fork();
+        if (pid != 0)
+            return pid;
+
+        if (setup_child(fd,options) == 0)
+            execv(path,arg_list);
+
+        // A successful execv replaces this exit call.
+        _exit(-1);
+    }
+
+#ifdef __linux__
+    /**
+     * @brief Parameters passed to a child created by launch_clone().
+     */
+    struct CloneParams
+    {
+        const char *path_;
+        char *const *arg_list_;
+        const int *fd_;
+        const LaunchOptions *options_;
+        sigset_t sigmask_;          ///< Signal mask to restore before exec.
+        volatile int error_;        ///< Set by the child if it failed.
+    };
+
+    /**
+     * Entry point of a child created by launch_clone(), runs in the address
+     * space of the parent until the new program has been executed.
+     * @param [in] param The clone parameters.
+     * @return Never returns.
+     */
+    static int clone_child(void *param)
+    {
+        CloneParams *params = static_cast<CloneParams *>(param);
+
+        // The signal handlers of the parent must not run in the shared
+        // address space, the dispositions are private to the child.
+        struct sigaction default_action;
+        memset(&default_action,0,sizeof(default_action));
+        default_action.sa_handler = SIG_DFL;
+
+        for (int i = 1; i < NSIG; i++)
+        {
+            struct sigaction action;
+            if (sigaction(i,NULL,&action) != 0)
+                continue;
+
+            if ((action.sa_flags & SA_SIGINFO) ||
+                (action.sa_handler != SIG_DFL && action.sa_handler != SIG_IGN))
+            {
+                sigaction(i,&default_action,NULL);
+            }
+        }
+
+        int err = setup_child(params->fd_,*params->options_);
+        if (err == 0)
+        {
+            sigprocmask(SIG_SETMASK,&params->sigmask_,NULL);
+            execv(params->path_,params->arg_list_);
+            err = errno;
+        }
+
+        params->error_ = err != 0 ? err : ECHILD;
+        _exit(127);
+    }
+
+    /**
+     * Starts a new process using clone() sharing the address space of the
+     * calling process until the new program has been executed. Like
+     * posix_spawn() this avoids copying page tables but also allows the
+     * options to be applied before executing the program.
+     * @param [in] path The path to the executable.
+     * @param [in] arg_list The NULL terminated argument list.
+     * @param [in] fd The descriptors to use as standard input, output and
+     *                error in the child process.
+     * @param [in] options The options to apply to the child process.
+     * @return If successful the process identifier is returned, otherwise
+     *         -1 is returned and errno is set.
+     */
+    static pid_t launch_clone(const char *path,char *const arg_list[],const int fd[3],
+                              const LaunchOptions &options)
+    {
+        const size_t stack_size = 64 * 1024;
+        void *stack = mmap(NULL,stack_size,PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,-1,0);
+        if (stack == MAP_FAILED)
+            return -1;
+
+        CloneParams params;
+        params.path_ = path;
+        params.arg_list_ = arg_list;
+        params.fd_ = fd;
+        params.options_ = &options;
+        params.error_ = 0;
+
+        // Block all signals until the child has reset its signal handlers.
+        sigset_t all_signals;
+        sigfillset(&all_signals);
+        pthread_sigmask(SIG_SETMASK,&all_signals,&params.sigmask_);
+
+        // The calling thread is suspended until the child has executed the
+        // program or exited.
+        pid_t pid = clone(clone_child,static_cast<char *>(stack) + stack_size,
+                          CLONE_VM | CLONE_VFORK | SIGCHLD,&params);
+        int err = errno;
+
+        pthread_sigmask(SIG_SETMASK,&params.sigmask_,NULL);
+        munmap(stack,stack_size);
+
+        if (pid == -1)
+        {
+            errno = err;
+            return -1;
+        }
+
+        if (params.error_ != 0)
+        {
+            int status = 0;
+            while (waitpid(pid,&status,0) < 0 && errno == EINTR)
+                ;
+
+            errno = params.error_;
+            return -1;
+        }
+
+        return pid;
+    }
+#endif
+
+    /**
+     * Starts a new process using posix_spawn(). Unlike fork() this does not
+     * copy the page tables of the calling process, which makes launching
+     * processes from a process with a large address space much faster.
+     * @param [in] path The path to the executable.
+     * @param [in] arg_list The NULL terminated argument list.
+     * @param [in] fd The descriptors to use as standard input, output and
+     *                error in the child process.
+     * @return If successful the process identifier is returned, otherwise
+     *         -1 is returned and errno is set. If posix_spawn() is not
+     *         supported errno is set to ENOSYS.
+     */
+    static pid_t launch_spawn(const char *path,char *const arg_list[],const int fd[3])
+    {
+#ifdef _POSIX_SPAWN
+        posix_spawn_file_actions_t actions;
+        int err = posix_spawn_file_actions_init(&actions);
+        if (err != 0)
+        {
+            errno = err;
+            return -1;
+        }
+
+        // The original descriptors are closed on exec.
+        pid_t pid = -1;
+        if ((err = posix_spawn_file_actions_adddup2(&actions,fd[0],STDIN_FILENO)) == 0 &&
+            (err = posix_spawn_file_actions_adddup2(&actions,fd[1],STDOUT_FILENO)) == 0 &&
+            (err = posix_spawn_file_actions_adddup2(&actions,fd[2],STDERR_FILENO)) == 0)
+        {
+            err = posix_spawn(&pid,path,&actions,NULL,arg_list,environ);
+        }
+
+        posix_spawn_file_actions_destroy(&actions);
+
+        if (err != 0)
+        {
+            errno = err;
+            return -1;
+        }
+
+        return pid;
+#else
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    /**
+     * Writes a complete buffer to a file descriptor.
+     * @param [in] fd The file descriptor.
+     * @param [in] buffer The data to write.
+     * @param [in] count The number of bytes to write.
+     * @return If successful true is returned, if unsuccessful false is
+     *         returned.
+     */
+    static bool write_all(int fd,const char *buffer,size_t count)
+    {
+        while (count > 0)
+        {
+            ssize_t res = ::write(fd,buffer,count);
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+
+                return false;
+            }
+
+            buffer += res;
+            count -= res;
+        }
+
+        return true;
+    }
+
+    /**
+     * Tries to increase the size of a pipe.
+     * @param [in] fd The pipe file descriptor.
+     * @param [in] size The requested pipe size in bytes.
+     * @return The resulting pipe size in bytes, zero if unknown.
+     */
+    static size_t grow_pipe(int fd,size_t size)
+    {
+#if defined(F_SETPIPE_SZ) && defined(F_GETPIPE_SZ)
+        // The size may be limited by /proc/sys/fs/pipe-max-size.
+        fcntl(fd,F_SETPIPE_SZ,static_cast<int>(size));
+
+        int res = fcntl(fd,F_GETPIPE_SZ);
+        if (res > 0)
+            return static_cast<size_t>(res);
+#endif
+        return 0;
+    }
+
+    /**
+     * Opens a file descriptor referring to a child process. The descriptor
+     * becomes readable when the process exits.
+     * @param [in] pid The process identifier.
+     * @return If successful the file descriptor is returned, if process file
+     *         descriptors are not supported -1 is returned.
+     */
+    static int open_pid_fd(pid_t pid)
+    {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+        static volatile bool supported = true;
+        if (supported)
+        {
+            // The descriptor is always closed on exec.
+            int fd = static_cast<int>(syscall(SYS_pidfd_open,pid,0));
+            if (fd != -1)
+                return fd;
+
+            if (errno == ENOSYS)
+                supported = false;
+        }
+#endif
+        return -1;
+    }
+
+    /**
+     * Reaps a child process without blocking.
+     * @param [in] pid The process identifier.
+     * @param [out] status The status of the process, -1 if the process was
+     *                     reaped by someone else.
+     * @param [out] usage The resource usage of the process.
+     * @return If the process has exited true is returned, if it's still
+     *         running false is returned.
+     */
+    static bool reap_process(pid_t pid,int &status,Process::Usage &usage)
+    {
+        struct rusage ru;
+        memset(&ru,0,sizeof(ru));
+
+        pid_t res;
+        do
+        {
+            res = wait4(pid,&status,WNOHANG,&ru);
+        } while (res < 0 && errno == EINTR);
+
+        if (res == 0)
+            return false;
+
+        if (res < 0)
+            status = -1;
+
+        usage.user_time_ = static_cast<tuint64>(ru.ru_utime.tv_sec) * 1000000 +
+                           ru.ru_utime.tv_usec;
+        usage.system_time_ = static_cast<tuint64>(ru.ru_stime.tv_sec) * 1000000 +
+                             ru.ru_stime.tv_usec;
+#ifdef __APPLE__
+        usage.max_rss_ = static_cast<tuint64>(ru.ru_maxrss);
+#else
+        usage.max_rss_ = static_cast<tuint64>(ru.ru_maxrss) * 1024;
+#endif
+        usage.block_input_ = static_cast<tuint64>(ru.ru_inblock);
+        usage.block_output_ = static_cast<tuint64>(ru.ru_oublock);
+        usage.voluntary_switches_ = static_cast<tuint64>(ru.ru_nvcsw);
+        usage.involuntary_switches_ = static_cast<tuint64>(ru.ru_nivcsw);
+        return true;
+    }
+
+    /**
+     * Singleton class for monitoring child processes on systems without
+     * process file descriptors.
+     *
+     * The SIGCHLD handler only writes to a pipe monitored by the reactor.
+     * The reaping is done by the reactor thread which calls wait4() for
+     * each registered process, other children of the process are left alone.
      */
     class ProcessMonitor
     {
     private:
-        void (*old_sigchld_handler_)(int);
+        static int notify_fd_[2];
+        static void (*old_sigchld_handler_)(int);
+
+        /**
+         * @brief Reaped process waiting to be notified.
+         */
+        struct Exited
+        {
+            Process *process_;
+            int status_;
+            Process::Usage usage_;
+        };
+
+        thread::Mutex mutex_;
         std::map<pid_t,Process *> pid_map_;
 
-        ProcessMonitor() : old_sigchld_handler_(NULL)
+        ProcessMonitor()
         {
+            if (pipe(notify_fd_) == 0)
+            {
+                for (int i = 0; i < 2; i++)
+                {
+                    fcntl(notify_fd_[i],F_SETFD,FD_CLOEXEC);
+                    fcntl(notify_fd_[i],F_SETFL,fcntl(notify_fd_[i],F_GETFL) | O_NONBLOCK);
+                }
+
+                Reactor::instance().add(notify_fd_[0],notified,this);
+            }
+
             // Assign a action handler for the SIGCHLD signal.
             struct sigaction new_action,old_action;
             memset(&new_action,0,sizeof(new_action));
 
             new_action.sa_handler = sigchld_handler;
-            new_action.sa_flags = SA_NOCLDSTOP;
+            new_action.sa_flags = SA_NOCLDSTOP | SA_RESTART;
 
             if (sigaction(SIGCHLD,&new_action,&old_action) == 0)
             {
@@ -62,7 +521,8 @@ namespace ckcore
             struct sigaction new_action,old_action;
             memset(&new_action,0,sizeof(new_action));
 
-            new_action.sa_handler = old_sigchld_handler_;
+            new_action.sa_handler = old_sigchld_handler_ != NULL ?
+                old_sigchld_handler_ : SIG_DFL;
             new_action.sa_flags = SA_NOCLDSTOP;
 
             if (sigaction(SIGCHLD,&new_action,&old_action) == 0)
@@ -79,24 +539,61 @@ namespace ckcore
 
         static void sigchld_handler(int signum)
         {
-            // Obtain process identifier.
-            int status;
-            pid_t pid = wait(&status);
+            // Only async-signal-safe functions may be called here.
+            int saved_errno = errno;
+            char c = 0;
+            if (notify_fd_[1] != -1)
+                ::write(notify_fd_[1],&c,1);
+            errno = saved_errno;
 
-            // Change process status to stopped.
-            if (ProcessMonitor::instance().pid_map_.count(pid) > 0)
+            // Call the old SIGCHLD signal handler.
+            void (*old_sigchld_handler)(int) = old_sigchld_handler_;
+            if (old_sigchld_handler != NULL && old_sigchld_handler != SIG_IGN &&
+                old_sigchld_handler != SIG_DFL)
             {
-                Process *process = ProcessMonitor::instance().pid_map_[pid];
-                process->state_ = Process::STATE_STOPPED;
+                old_sigchld_handler(signum);
+            }
+        }
 
-                if (WIFEXITED(status))
-                    process->exit_code_ = WEXITSTATUS(status);
+        /**
+         * Reactor callback, reaps all registered processes that have exited.
+         */
+        static void notified(void *param,int fd)
+        {
+            char buffer[64];
+            while (::read(fd,buffer,sizeof(buffer)) > 0)
+                ;
+
+            static_cast<ProcessMonitor *>(param)->reap();
+        }
+
+        void reap()
+        {
+            std::vector<Exited> reaped;
+
+            Locker<thread::Mutex> lock(mutex_);
+
+            std::map<pid_t,Process *>::iterator it = pid_map_.begin();
+            while (it != pid_map_.end())
+            {
+                Exited entry;
+                if (!reap_process(it->first,entry.status_,entry.usage_))
+                {
+                    ++it;
+                    continue;
+                }
+
+                // Processes detached from their objects are only reaped.
+                entry.process_ = it->second;
+                if (entry.process_ != NULL)
+                    reaped.push_back(entry);
+                pid_map_.erase(it++);
             }
 
-            // Call the old SIGCHLD signal handler.
-            void (*old_sigchld_handler)(int) = ProcessMonitor::instance().old_sigchld_handler_;
-            if (old_sigchld_handler != NULL && old_sigchld_handler != SIG_IGN)
-                old_sigchld_handler(signum);
+            lock.unlock();
+
+            for (size_t i = 0; i < reaped.size(); i++)
+                reaped[i].process_->exited(reaped[i].status_,reaped[i].usage_);
         }
 
     public:
@@ -113,52 +610,157 @@ namespace ckcore
         /**
          * Registers a new process in the process monitor.
          * @param [in] pid The process identifier of the process to monitor.
+         * @param [in] process The process object to notify, NULL to reap the
+         *                     process without notifying anyone.
          */
         void register_process(pid_t pid,Process *process)
         {
+            Locker<thread::Mutex> lock(mutex_);
             pid_map_[pid] = process;
+            lock.unlock();
+
+            // The process may already have exited.
+            char c = 0;
+            ::write(notify_fd_[1],&c,1);
         }
     };
 
+    int ProcessMonitor::notify_fd_[2] = { -1,-1 };
+    void (*ProcessMonitor::old_sigchld_handler_)(int) = NULL;
+
+    Process::OutputStream::OutputStream() : fd_(-1),peek_(0),peeked_(false),
+        end_(true)
+    {
+    }
+
+    Process::OutputStream::~OutputStream()
+    {
+        reset(-1);
+    }
+
+    void Process::OutputStream::reset(int fd)
+    {
+        if (fd_ != -1)
+            ::close(fd_);
+
+        fd_ = fd;
+        peeked_ = false;
+        end_ = fd == -1;
+    }
+
+    tint64 Process::OutputStream::read(void *buffer,tuint32 count)
+    {
+        if (count == 0 || end_)
+            return 0;
+
+        unsigned char *out = static_cast<unsigned char *>(buffer);
+        tint64 read = 0;
+        if (peeked_)
+        {
+            *out++ = peek_;
+            peeked_ = false;
+            if (--count == 0)
+                return 1;
+
+            read = 1;
+        }
+
+        ssize_t res;
+        do
+        {
+            res = ::read(fd_,out,count);
+        } while (res < 0 && errno == EINTR);
+
+        if (res < 0)
+            return read > 0 ? read : -1;
+
+        if (res == 0)
+            end_ = true;
+
+        return read + res;
+    }
+
+    tint64 Process::OutputStream::size()
+    {
+        return -1;
+    }
+
+    bool Process::OutputStream::end()
+    {
+        if (peeked_)
+            return false;
+
+        if (end_)
+            return true;
+
+        // Read ahead a character to find out if the pipe has been closed.
+        ssize_t res;
+        do
+        {
+            res = ::read(fd_,&peek_,1);
+        } while (res < 0 && errno == EINTR);
+
+        if (res == 1)
+            peeked_ = true;
+        else
+            end_ = true;
+
+        return end_;
+    }
+
+    bool Process::OutputStream::seek(tuint32 distance,StreamWhence whence)
+    {
+        if (whence != ckSTREAM_CURRENT)
+            return false;
+
+        char buffer[4096];
+        while (distance > 0)
+        {
+            tint64 res = read(buffer,distance < sizeof(buffer) ?
+                              distance : static_cast<tuint32>(sizeof(buffer)));
+            if (res <= 0)
+                return false;
+
+            distance -= static_cast<tuint32>(res);
+        }
+
+        return true;
+    }
+
     Process::Process() : invalid_inheritor_(false),
-        pid_(-1),state_(STATE_STOPPED),exit_code_(0),
-        started_event_(false)
+        pid_(-1),state_(STATE_STOPPED),exit_code_(0),exited_(false),
+        pid_fd_(-1),launcher_(LAUNCHER_SPAWN),raw_output_(false),
+        nice_set_(false),nice_(0),io_class_(IO_CLASS_NONE),io_level_(0),
+        mutex_("Process")
     {
+        memset(&usage_,0,sizeof(usage_));
+
         pipe_stdin_[0] = pipe_stdin_[1] = -1;
         pipe_stdout_[0] = pipe_stdout_[1] = -1;
         pipe_stderr_[0] = pipe_stderr_[1] = -1;
 
-        pthread_mutex_init(&mutex_,NULL);
-        pthread_mutex_init(&mutex_exec_,NULL);
-
-        pthread_mutex_init(&started_mutex_,NULL);
-        pthread_cond_init(&started_cond_,NULL);
-
         // Insert default delimiters.
-        block_delims_.insert('\n');
-        block_delims_.insert('\r');
+        memset(delim_table_,0,sizeof(delim_table_));
+        delim_count_ = 0;
+        single_delim_ = 0;
+
+        add_block_delim('\n');
+        add_block_delim('\r');
     }
 
     Process::~Process()
     {
-        // Make sure that the execution is completed before destroying this object.
-        bool locked = pthread_mutex_lock(&mutex_exec_) == 0;
-        if (locked)
-            pthread_mutex_unlock(&mutex_exec_);
+        // Make sure that the execution is completed before destroying this
+        // object. That's not possible from an event function, the process is
+        // detached instead.
+        if (!wait())
+            detach();
 
         close();
-
-        pthread_mutex_destroy(&mutex_exec_);
-        pthread_mutex_destroy(&mutex_);
-
-        pthread_mutex_destroy(&started_mutex_);
-        pthread_cond_destroy(&started_cond_);
     }
 
-    void Process::close()
+    void Process::close_pipes()
     {
-        bool locked = pthread_mutex_lock(&mutex_) == 0;
-
         // Close handles.
         for (int i = 0; i < 2; i++)
         {
@@ -184,180 +786,256 @@ namespace ckcore
             }
         }
 
-        // Reset stop event.
-        pthread_mutex_lock(&started_mutex_);
-        started_event_ = false;
-        pthread_mutex_unlock(&started_mutex_);
+    }
+
+    void Process::close()
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        close_pipes();
+        output_stream_.reset(-1);
 
         // Reset state.
         pid_ = -1;
         state_ = STATE_STOPPED;
+    }
+
+    const char *Process::find_delim(const char *begin,const char *end) const
+    {
+        if (delim_count_ == 1)
+        {
+            const void *delim = memchr(begin,single_delim_,end - begin);
+            return delim != NULL ? static_cast<const char *>(delim) : end;
+        }
 
-        if (locked)
-            pthread_mutex_unlock(&mutex_);
+        while (begin < end && !delim_table_[static_cast<unsigned char>(*begin)])
+            ++begin;
+
+        return begin;
     }
 
-    bool Process::read_stdout(int fd)
+    bool Process::read_blocks(int fd,std::string &block_buffer)
     {
-        char buffer[READ_BUFFER_SIZE];
-        ssize_t read_bytes = ::read(fd,buffer,sizeof(buffer) - 1);
+        // The buffer is only needed while reading, taking it from the pool
+        // avoids keeping one per process.
+        PooledBuffer read_buffer(READ_BUFFER_SIZE);
+        if (read_buffer.data() == NULL)
+            return false;
+
+        ssize_t read_bytes = ::read(fd,read_buffer.data(),READ_BUFFER_SIZE);
 
         // Check for read errors.
         if (read_bytes <= 0)
             return false;
 
-        buffer[read_bytes] = '\0';
+        const char *cur = reinterpret_cast<const char *>(read_buffer.data());
+        const char *end = cur + read_bytes;
 
-        // Split the buffer into blocks.
-        for (ssize_t i = 0; i < read_bytes; i++)
-        {
-            // Check if we have found a block delimiter.
-            bool is_delim = false;
+        // Only the first block can continue a partial block, it's moved here
+        // so that it stays valid until the blocks have been delivered.
+        std::string first_block;
 
-            std::set<char>::const_iterator it;
-            for (it = block_delims_.begin(); it != block_delims_.end(); it++)
+        blocks_.clear();
+        while (cur < end)
+        {
+            const char *delim = find_delim(cur,end);
+            if (delim == end)
             {
-                if (buffer[i] == *it)
-                {
-                    is_delim = true;
-                    break;
-                }
+                block_buffer.append(cur,end);
+                break;
             }
 
-            if (is_delim)
+            Block block = { cur,static_cast<size_t>(delim - cur) };
+            if (!block_buffer.empty())
             {
-                // Avoid flushing an empty buffer.
-                if (block_buffer_out_.size() > 0)
-                {
-                    if (!invalid_inheritor_)
-                        event_output(block_buffer_out_);
+                block_buffer.append(cur,delim);
+                first_block.swap(block_buffer);
 
-                    block_buffer_out_.resize(0);
-                }
-            }
-            else
-            {
-                block_buffer_out_.push_back(buffer[i]);
+                block.data_ = first_block.data();
+                block.size_ = first_block.size();
             }
+
+            // Avoid flushing an empty buffer.
+            if (block.size_ > 0)
+                blocks_.push_back(block);
+
+            cur = delim + 1;
         }
 
+        if (!blocks_.empty() && !invalid_inheritor_)
+            event_output_batch(blocks_);
+
         return true;
     }
 
-    bool Process::read_stderr(int fd)
+    void Process::event_output_batch(const std::vector<Block> &blocks)
     {
-        char buffer[READ_BUFFER_SIZE];
-        ssize_t read_bytes = ::read(fd,buffer,sizeof(buffer) - 1);
-
-        // Check for read errors.
-        if (read_bytes <= 0)
-            return false;
+        std::string block;
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            block.assign(blocks[i].data_,blocks[i].size_);
+            event_output(block);
+        }
+    }
 
-        buffer[read_bytes] = '\0';
+    void Process::output_ready(void *param,int fd)
+    {
+        Process *process = static_cast<Process *>(param);
+        process->read_output(fd,false);
+        process->try_finish();
+    }
 
-        // Split the buffer into blocks.
-        for (ssize_t i = 0; i < read_bytes; i++)
+    void Process::read_output(int fd,bool drain)
+    {
+        do
         {
-            // Check if we have found a block delimiter.
-            bool is_delim = false;
-
-            std::set<char>::const_iterator it;
-            for (it = block_delims_.begin(); it != block_delims_.end(); it++)
+            errno = 0;
+            bool res = read_blocks(fd,fd == pipe_stdout_[FD_READ] ?
+                                   block_buffer_out_ : block_buffer_err_);
+            if (!res)
             {
-                if (buffer[i] == *it)
-                {
-                    is_delim = true;
-                    break;
-                }
-            }
+                if (errno == EINTR)
+                    continue;
 
-            if (is_delim)
-            {
-                // Avoid flushing an empty buffer.
-                if (block_buffer_err_.size() > 0)
-                {
-                    if (!invalid_inheritor_)
-                        event_output(block_buffer_err_);
+                // Nothing more to read right now.
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return;
 
-                    block_buffer_err_.resize(0);
-                }
-            }
-            else
-            {
-                block_buffer_err_.push_back(buffer[i]);
+                // The pipe has been closed or failed.
+                if (fd == pipe_stdout_[FD_READ])
+                    close_output(pipe_stdout_[FD_READ]);
+                else
+                    close_output(pipe_stderr_[FD_READ]);
+
+                return;
             }
-        }
+        } while (drain);
+    }
 
-        return true;
+    void Process::close_output(int &fd)
+    {
+        Reactor::instance().remove(fd);
+
+        Locker<thread::Mutex> lock(mutex_);
+        ::close(fd);
+        fd = -1;
+    }
+
+    /**
+     * Reactor callback reaping a detached process when its process file
+     * descriptor becomes readable.
+     * @param [in] param The process identifier.
+     * @param [in] fd The process file descriptor.
+     */
+    static void detached_pid_ready(void *param,int fd)
+    {
+        pid_t pid = static_cast<pid_t>(reinterpret_cast<size_t>(param));
+
+        int status = 0;
+        Process::Usage usage;
+        if (!reap_process(pid,status,usage))
+            return;
+
+        Reactor::instance().remove(fd);
+        ::close(fd);
     }
 
-    void *Process::listen(void *param)
+    void Process::pid_ready(void *param,int fd)
     {
         Process *process = static_cast<Process *>(param);
 
-        // Prevent the object from being destroyed while running the separate thread.
-        pthread_mutex_lock(&process->mutex_exec_);
+        int status = 0;
+        Usage usage;
+        if (!reap_process(process->pid_,status,usage))
+            return;
 
-        process->block_buffer_out_.resize(0);
-        process->block_buffer_err_.resize(0);
+        Reactor::instance().remove(fd);
+        ::close(fd);
+        process->pid_fd_ = -1;
 
-        // We can now signal that the process has started.
-        pthread_mutex_lock(&process->started_mutex_);
-        process->started_event_ = true;
-        pthread_cond_signal(&process->started_cond_);
-        pthread_mutex_unlock(&process->started_mutex_);
+        process->exited(status,usage);
+    }
 
-        // Loop while the program is running.
-        while (process->state_ == STATE_RUNNING)
-        {
-            fd_set read_set;
-            FD_ZERO(&read_set);
+    void Process::exited(int status,const Usage &usage)
+    {
+        if (status != -1 && WIFEXITED(status))
+            exit_code_ = WEXITSTATUS(status);
 
-            if (process->pipe_stdout_[FD_READ] != -1)
-                FD_SET(process->pipe_stdout_[FD_READ],&read_set);
-            if (process->pipe_stderr_[FD_READ] != -1)
-                FD_SET(process->pipe_stderr_[FD_READ],&read_set);
+        usage_ = usage;
 
-            int timeout = 100;  // 100 miliseconds.
-            struct timeval tv;
-            tv.tv_sec = timeout / 1000;
-            tv.tv_usec = (timeout % 1000) * 1000;
+        exited_ = true;
 
-            int res;
-            do
-            {
-                res = select(FD_SETSIZE,&read_set,NULL,NULL,&tv);
-            } while (res < 0 && errno == EINTR);
+        // All output written by the process is in the pipes by now. Collect
+        // it and stop waiting for the pipes to close since they may have been
+        // inherited by processes that are still running.
+        if (pipe_stdout_[FD_READ] != -1)
+            read_output(pipe_stdout_[FD_READ],true);
+        if (pipe_stdout_[FD_READ] != -1)
+            close_output(pipe_stdout_[FD_READ]);
 
-            // Read from standard output.
-            if (FD_ISSET(process->pipe_stdout_[FD_READ],&read_set))
-            {
-                if (!process->read_stdout(process->pipe_stdout_[FD_READ]))
-                {
-                    process->close();
-                    break;
-                }
-            }
+        if (pipe_stderr_[FD_READ] != -1)
+            read_output(pipe_stderr_[FD_READ],true);
+        if (pipe_stderr_[FD_READ] != -1)
+            close_output(pipe_stderr_[FD_READ]);
+
+        try_finish();
+    }
 
-            // Read from standard error.
-            if (FD_ISSET(process->pipe_stderr_[FD_READ],&read_set))
+    void Process::detach()
+    {
+        if (pipe_stdout_[FD_READ] != -1)
+            close_output(pipe_stdout_[FD_READ]);
+        if (pipe_stderr_[FD_READ] != -1)
+            close_output(pipe_stderr_[FD_READ]);
+
+        if (exited_)
+            return;
+
+        if (pid_fd_ != -1)
+        {
+            // Keep waiting on the process file descriptor, but without
+            // referring to this object.
+            int pid_fd = pid_fd_;
+            pid_fd_ = -1;
+
+            Reactor &reactor = Reactor::instance();
+            reactor.remove(pid_fd);
+            if (reactor.add(pid_fd,detached_pid_ready,
+                            reinterpret_cast<void *>(static_cast<size_t>(pid_))))
             {
-                if (!process->read_stderr(process->pipe_stderr_[FD_READ]))
-                {
-                    process->close();
-                    break;
-                }
+                return;
             }
+
+            ::close(pid_fd);
         }
 
+        // Let the process monitor reap the child once it exits.
+        ProcessMonitor::instance().register_process(pid_,NULL);
+    }
+
+    void Process::try_finish()
+    {
+        if (!exited_ || pipe_stdout_[FD_READ] != -1 || pipe_stderr_[FD_READ] != -1)
+            return;
+
         // Notify that the process has finished.
-        if (!process->invalid_inheritor_)
-            process->event_finished();
+        if (!invalid_inheritor_)
+            event_finished();
+
+        // The object may be destroyed as soon as the state has changed, it
+        // must not be touched after releasing the lock.
+        Locker<thread::Mutex> lock(mutex_);
+        close_pipes();
 
-        process->close();
+        std::vector<std::pair<tcallback,void *> > callbacks;
+        callbacks.swap(finish_callbacks_);
 
-        pthread_mutex_unlock(&process->mutex_exec_);
-    return NULL;
+        pid_ = -1;
+        state_ = STATE_STOPPED;
+        finished_cond_.signal_all();
+        lock.unlock();
+
+        for (size_t i = 0; i < callbacks.size(); i++)
+            callbacks[i].first(callbacks[i].second);
     }
 
     std::vector<tstring> Process::parse_cmd_line(const tchar *cmd_line) const
@@ -398,6 +1076,11 @@ namespace ckcore
     }
 
     bool Process::create(const tchar *cmd_line)
+    {
+        return create(cmd_line,-1,-1);
+    }
+
+    bool Process::create(const tchar *cmd_line,int stdin_fd,int stdout_fd)
     {
         // Check if a process is already running.
         if (running())
@@ -425,98 +1108,163 @@ namespace ckcore
         if (!File::exist(path))
             return false;
 
-        // Create pipes.
-        if (pipe(pipe_stdin_) == -1 || pipe(pipe_stdout_) == -1 || pipe(pipe_stderr_) == -1)
+        // Create pipes, none of them should be inherited by other children.
+        if ((stdin_fd == -1 && !create_pipe(pipe_stdin_)) ||
+            (stdout_fd == -1 && !create_pipe(pipe_stdout_)) ||
+            !create_pipe(pipe_stderr_))
+        {
+            close();
             return false;
+        }
 
-        fcntl(pipe_stdout_[FD_READ],F_SETFL,fcntl(pipe_stdout_[FD_READ],F_GETFL) | O_NONBLOCK);
-        fcntl(pipe_stdout_[FD_WRITE],F_SETFL,fcntl(pipe_stdout_[FD_WRITE],F_GETFL) | O_NONBLOCK);
+        if (stdout_fd == -1 && !raw_output_)
+            fcntl(pipe_stdout_[FD_READ],F_SETFL,fcntl(pipe_stdout_[FD_READ],F_GETFL) | O_NONBLOCK);
         fcntl(pipe_stderr_[FD_READ],F_SETFL,fcntl(pipe_stderr_[FD_READ],F_GETFL) | O_NONBLOCK);
-        fcntl(pipe_stderr_[FD_WRITE],F_SETFL,fcntl(pipe_stderr_[FD_WRITE],F_GETFL) | O_NONBLOCK);
 
         // Change state to running (this will change on failure).
+        exit_code_ = 0;
+        exited_ = false;
+        memset(&usage_,0,sizeof(usage_));
         state_ = STATE_RUNNING;
 
-        // Fork process.
-        pid_ = fork();
-        if (pid_ == -1)
-            return false;
+        // Discard any unterminated output from a previous run.
+        block_buffer_out_.resize(0);
+        block_buffer_err_.resize(0);
 
-        // Check if child process.
-        if (pid_ == 0)
+        // Start the process.
+        int child_fd[3] =
         {
-            // Redirect STDIN, STDOUT and STDERR.
-            if (dup2(pipe_stdin_[FD_READ],STDIN_FILENO) == -1 ||
-                dup2(pipe_stdout_[FD_WRITE],STDOUT_FILENO) == -1 ||
-                dup2(pipe_stderr_[FD_WRITE],STDERR_FILENO) == -1)
+            stdin_fd != -1 ? stdin_fd : pipe_stdin_[FD_READ],
+            stdout_fd != -1 ? stdout_fd : pipe_stdout_[FD_WRITE],
+            pipe_stderr_[FD_WRITE]
+        };
+
+        LaunchOptions options;
+        options.nice_set_ = nice_set_;
+        options.nice_ = nice_;
+        if (io_class_ != IO_CLASS_NONE)
+            options.io_priority_ = (io_class_ << 13) | io_level_;
+
+#ifdef __linux__
+        if (!affinity_.empty())
+        {
+            options.affinity_set_ = true;
+            CPU_ZERO(&options.affinity_);
+            for (size_t i = 0; i < affinity_.size(); i++)
             {
-                close();
-                exit(-1);
+                if (affinity_[i] < CPU_SETSIZE)
+                    CPU_SET(affinity_[i],&options.affinity_);
             }
+        }
+#endif
 
-            // Close handles that we no longer need.
-            for (int i = 0; i < 2; i++)
-            {
-                ::close(pipe_stdin_[i]);
-                ::close(pipe_stdout_[i]);
-                ::close(pipe_stderr_[i]);
-            }
+        std::map<int,std::pair<tuint64,tuint64> >::const_iterator it_limit;
+        for (it_limit = limits_.begin(); it_limit != limits_.end(); ++it_limit)
+        {
+            struct rlimit limit;
+            limit.rlim_cur = it_limit->second.first == static_cast<tuint64>(LIMIT_INFINITY) ?
+                RLIM_INFINITY : static_cast<rlim_t>(it_limit->second.first);
+            limit.rlim_max = it_limit->second.second == static_cast<tuint64>(LIMIT_INFINITY) ?
+                RLIM_INFINITY : static_cast<rlim_t>(it_limit->second.second);
+            options.limits_.push_back(std::make_pair(it_limit->first,limit));
+        }
 
-            execv(path,arg_list);
+        options.inherited_fds_ = inherited_fds_;
+
+        // posix_spawn() can't apply the options, use clone() on Linux instead
+        // which is equally fast.
+        pid_t pid = -1;
+        errno = ENOSYS;
+        if (launcher_ == LAUNCHER_SPAWN && options.empty())
+            pid = launch_spawn(path,arg_list,child_fd);
+#ifdef __linux__
+        else if (launcher_ == LAUNCHER_SPAWN)
+            pid = launch_clone(path,arg_list,child_fd,options);
+#endif
 
-            // A successful execv replaces this exit call.
+        if (launcher_ == LAUNCHER_FORK || (pid == -1 && errno == ENOSYS))
+            pid = launch_fork(path,arg_list,child_fd,options);
+
+        if (pid == -1)
+        {
             close();
-            exit(-1);
+            return false;
         }
 
-        // Register child.
-        ProcessMonitor::instance().register_process(pid_,this);
+        pid_ = pid;
+
+        // Close the child ends of the pipes, otherwise we will never see the
+        // pipes being closed by the child.
+        Locker<thread::Mutex> lock(mutex_);
+        if (pipe_stdin_[FD_READ] != -1)
+            ::close(pipe_stdin_[FD_READ]);
+        if (pipe_stdout_[FD_WRITE] != -1)
+            ::close(pipe_stdout_[FD_WRITE]);
+        ::close(pipe_stderr_[FD_WRITE]);
+        pipe_stdin_[FD_READ] = pipe_stdout_[FD_WRITE] = pipe_stderr_[FD_WRITE] = -1;
 
-        // Create listen thread.
-        pthread_t thread;
-        if (pthread_create(&thread,NULL,listen,this) != 0)
+        // Raw output is read by the consumer of the output stream.
+        if (raw_output_ && pipe_stdout_[FD_READ] != -1)
         {
-            // If we failed, kill the process.
-            ::kill(pid_,SIGKILL);
-            return false;
+            output_stream_.reset(pipe_stdout_[FD_READ]);
+            pipe_stdout_[FD_READ] = -1;
         }
 
-        // Wait until the process has started.
-        pthread_mutex_lock(&started_mutex_);
-        while (!started_event_)
-            pthread_cond_wait(&started_cond_,&started_mutex_);
-        pthread_mutex_unlock(&started_mutex_);
+        lock.unlock();
+
+        // Start listening for output, then for the process to exit.
+        Reactor &reactor = Reactor::instance();
+        if (pipe_stdout_[FD_READ] != -1)
+            reactor.add(pipe_stdout_[FD_READ],output_ready,this);
+        reactor.add(pipe_stderr_[FD_READ],output_ready,this);
+
+        // Prefer a process file descriptor to avoid any signal handling. A
+        // process exiting before the monitor is installed is picked up when
+        // registering. Once registered the process may finish at any time so
+        // only local copies of the state can be used.
+        int pid_fd = open_pid_fd(pid);
+        if (pid_fd != -1)
+        {
+            pid_fd_ = pid_fd;
+            if (!reactor.add(pid_fd,pid_ready,this))
+            {
+                ::close(pid_fd);
+                pid_fd = pid_fd_ = -1;
+            }
+        }
+
+        if (pid_fd == -1)
+            ProcessMonitor::instance().register_process(pid,this);
 
-        exit_code_ = 0;
         return true;
     }
 
     bool Process::running() const
     {
-        bool locked = pthread_mutex_lock(const_cast<pthread_mutex_t *>(&mutex_)) == 0;
-        bool running = state_ == STATE_RUNNING;
-        if (locked)
-            pthread_mutex_unlock(const_cast<pthread_mutex_t *>(&mutex_));
-
-        return running;
+        Locker<thread::Mutex> lock(mutex_);
+        return state_ == STATE_RUNNING;
     }
 
     bool Process::wait() const
     {
-        // Make sure that the execution is completed before destroying this object.
-        bool locked = pthread_mutex_lock(const_cast<pthread_mutex_t *>(&mutex_exec_)) == 0;
-        if (locked)
-            pthread_mutex_unlock(const_cast<pthread_mutex_t *>(&mutex_exec_));
+        Locker<thread::Mutex> lock(mutex_);
+
+        // The process can only finish on the reactor thread, waiting for it
+        // from an event function would never return.
+        if (state_ == STATE_RUNNING && Reactor::instance().in_reactor_thread())
+            return false;
+
+        while (state_ == STATE_RUNNING)
+            finished_cond_.wait(mutex_);
 
         return true;
     }
 
     bool Process::kill() const
     {
-        bool locked = pthread_mutex_lock(const_cast<pthread_mutex_t *>(&mutex_)) == 0;
+        Locker<thread::Mutex> lock(mutex_);
         pid_t pid = pid_;
-        if (locked)
-            pthread_mutex_unlock(const_cast<pthread_mutex_t *>(&mutex_));
+        lock.unlock();
 
         if (pid == -1 || !running())
             return false;
@@ -524,16 +1272,86 @@ namespace ckcore
         return ::kill(pid,SIGTERM) == 0;
     }
 
+    void Process::set_launcher(Launcher launcher)
+    {
+        launcher_ = launcher;
+    }
+
+    void Process::set_nice(int nice)
+    {
+        nice_set_ = true;
+        nice_ = nice;
+    }
+
+    void Process::set_io_priority(IoClass io_class,int level)
+    {
+        io_class_ = io_class;
+        io_level_ = level;
+    }
+
+    void Process::set_affinity(const std::vector<unsigned int> &cpus)
+    {
+        affinity_ = cpus;
+    }
+
+    void Process::set_limit(int resource,tuint64 soft,tuint64 hard)
+    {
+        limits_[resource] = std::make_pair(soft,hard);
+    }
+
+    void Process::clear_options()
+    {
+        nice_set_ = false;
+        nice_ = 0;
+        io_class_ = IO_CLASS_NONE;
+        io_level_ = 0;
+        affinity_.clear();
+        limits_.clear();
+        inherited_fds_.clear();
+    }
+
+    void Process::add_inherited_fd(int fd)
+    {
+        if (std::find(inherited_fds_.begin(),inherited_fds_.end(),fd) == inherited_fds_.end())
+            inherited_fds_.push_back(fd);
+    }
+
+    void Process::set_raw_output(bool raw)
+    {
+        raw_output_ = raw;
+    }
+
+    InStream &Process::output_stream()
+    {
+        return output_stream_;
+    }
+
     void Process::add_block_delim(char delim)
     {
-        block_delims_.insert(delim);
+        unsigned char c = static_cast<unsigned char>(delim);
+        if (delim_table_[c])
+            return;
+
+        delim_table_[c] = true;
+        if (++delim_count_ == 1)
+            single_delim_ = delim;
     }
 
     void Process::remove_block_delim(char delim)
     {
-        std::set<char>::iterator it = block_delims_.find(delim);
-        if (it != block_delims_.end())
-            block_delims_.erase(it);
+        unsigned char c = static_cast<unsigned char>(delim);
+        if (!delim_table_[c])
+            return;
+
+        delim_table_[c] = false;
+        if (--delim_count_ == 1)
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                if (delim_table_[i])
+                    single_delim_ = static_cast<char>(i);
+            }
+        }
     }
 
     tint64 Process::write(const void *buffer,tuint32 count)
@@ -544,6 +1362,180 @@ namespace ckcore
         return ::write(pipe_stdin_[FD_WRITE],buffer,count);
     }
 
+    tint64 Process::feed(InStream &in)
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        int fd = pipe_stdin_[FD_WRITE];
+        lock.unlock();
+
+        if (fd == -1 || !running())
+            return -1;
+
+        size_t pipe_size = grow_pipe(fd,FEED_PIPE_SIZE);
+        size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+        // The pages passed to vmsplice() are referenced by the pipe until the
+        // process has read them. The buffer is therefore used as a ring twice
+        // the size of the pipe, a part of the ring is not reused until more
+        // than a pipe full of data has been written after it.
+        size_t chunk_size = FEED_BUFFER_SIZE;
+        size_t buffer_size = chunk_size;
+#ifdef __linux__
+        bool use_vmsplice = pipe_size >= 4 * page_size;
+        if (use_vmsplice)
+        {
+            chunk_size = pipe_size / 4;
+            buffer_size = pipe_size * 2;
+        }
+#endif
+        // Mapped memory is used since the pages may outlive the buffer, the
+        // pipe keeps its own references when the buffer is unmapped.
+        void *buffer = mmap(NULL,buffer_size,PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+        if (buffer == MAP_FAILED)
+            return -1;
+
+        char *ring = static_cast<char *>(buffer);
+        size_t offset = 0;
+        tint64 total = 0;
+        bool failed = false;
+
+        while (!failed && !in.end())
+        {
+            // Fill a whole chunk so that each page is passed to the pipe once.
+            char *chunk = ring + offset;
+            size_t filled = 0;
+            while (filled < chunk_size && !in.end())
+            {
+                tint64 res = in.read(chunk + filled,static_cast<tuint32>(chunk_size - filled));
+                if (res <= 0)
+                {
+                    failed = res < 0;
+                    break;
+                }
+
+                filled += static_cast<size_t>(res);
+            }
+
+            if (filled == 0)
+                break;
+
+#ifdef __linux__
+            struct iovec iov;
+            iov.iov_base = chunk;
+            iov.iov_len = filled;
+
+            while (use_vmsplice && iov.iov_len > 0)
+            {
+                ssize_t res = vmsplice(fd,&iov,1,0);
+                if (res < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+
+                    // Fall back to writing if vmsplice() is not supported.
+                    if (errno == EINVAL || errno == ENOSYS)
+                    {
+                        use_vmsplice = false;
+                        break;
+                    }
+
+                    failed = true;
+                    break;
+                }
+
+                iov.iov_base = static_cast<char *>(iov.iov_base) + res;
+                iov.iov_len -= res;
+            }
+
+            if (!use_vmsplice && !failed && !write_all(fd,static_cast<char *>(iov.iov_base),iov.iov_len))
+                failed = true;
+#else
+            if (!write_all(fd,chunk,filled))
+                failed = true;
+#endif
+            if (!failed)
+                total += filled;
+
+            offset += chunk_size;
+            if (offset + chunk_size > buffer_size)
+                offset = 0;
+        }
+
+        munmap(buffer,buffer_size);
+        return failed ? -1 : total;
+    }
+
+    tint64 Process::feed(File &file)
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        int fd = pipe_stdin_[FD_WRITE];
+        lock.unlock();
+
+        if (fd == -1 || !running() || file.file_handle_ == -1)
+            return -1;
+
+        size_t pipe_size = grow_pipe(fd,FEED_PIPE_SIZE);
+        tint64 total = 0;
+
+#ifdef __linux__
+        // Move the data from the file to the pipe without copying it.
+        while (true)
+        {
+            ssize_t res = splice(file.file_handle_,NULL,fd,NULL,
+                                 pipe_size > 0 ? pipe_size : FEED_BUFFER_SIZE,
+                                 SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (res > 0)
+            {
+                total += res;
+                continue;
+            }
+
+            if (res == 0)
+                return total;
+
+            if (errno == EINTR)
+                continue;
+
+            // Fall back to copying if the file doesn't support splicing.
+            if (errno == EINVAL || errno == ENOSYS)
+                break;
+
+            return -1;
+        }
+#endif
+        PooledBuffer buffer(FEED_BUFFER_SIZE);
+        if (buffer.data() == NULL)
+            return -1;
+
+        while (true)
+        {
+            tint64 res = file.read(buffer.data(),FEED_BUFFER_SIZE);
+            if (res < 0)
+                return -1;
+
+            if (res == 0)
+                return total;
+
+            if (!write_all(fd,reinterpret_cast<const char *>(buffer.data()),
+                           static_cast<size_t>(res)))
+                return -1;
+
+            total += res;
+        }
+    }
+
+    bool Process::close_input()
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        if (pipe_stdin_[FD_WRITE] == -1)
+            return false;
+
+        ::close(pipe_stdin_[FD_WRITE]);
+        pipe_stdin_[FD_WRITE] = -1;
+        return true;
+    }
+
     bool Process::exit_code(ckcore::tuint32 &exit_code) const
     {
         if (running())
@@ -552,4 +1544,26 @@ namespace ckcore
         exit_code = exit_code_;
         return true;
     }
+
+    bool Process::usage(Usage &usage) const
+    {
+        if (running())
+            return false;
+
+        usage = usage_;
+        return true;
+    }
+
+    bool Process::notify_finished(tcallback callback,void *param)
+    {
+        if (callback == NULL)
+            return false;
+
+        Locker<thread::Mutex> lock(mutex_);
+        if (state_ != STATE_RUNNING)
+            return false;
+
+        finish_callbacks_.push_back(std::make_pair(callback,param));
+        return true;
+    }
 }
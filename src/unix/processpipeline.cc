@@ -0,0 +1,236 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include "ckcore/locker.hh"
+#include "ckcore/processpipeline.hh"
+
+namespace ckcore
+{
+    ProcessPipeline::Stage::Stage(ProcessPipeline &host) : host_(host)
+    {
+    }
+
+    ProcessPipeline::Stage::~Stage()
+    {
+        invalid_inheritor_ = true;
+    }
+
+    void ProcessPipeline::Stage::event_finished()
+    {
+        host_.stage_finished();
+    }
+
+    void ProcessPipeline::Stage::event_output(const std::string &block)
+    {
+        if (!host_.invalid_inheritor_)
+            host_.event_output(block);
+    }
+
+    bool ProcessPipeline::Stage::start(const tchar *cmd_line,int stdin_fd,int stdout_fd)
+    {
+        return create(cmd_line,stdin_fd,stdout_fd);
+    }
+
+    ProcessPipeline::ProcessPipeline() : running_stages_(0),notify_(false),
+        mutex_("ProcessPipeline"),invalid_inheritor_(false)
+    {
+    }
+
+    ProcessPipeline::~ProcessPipeline()
+    {
+        clear();
+    }
+
+    void ProcessPipeline::stage_finished()
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        if (--running_stages_ > 0 || !notify_)
+            return;
+
+        notify_ = false;
+        lock.unlock();
+
+        if (!invalid_inheritor_)
+            event_finished();
+    }
+
+    void ProcessPipeline::clear()
+    {
+        wait();
+
+        for (size_t i = 0; i < stages_.size(); i++)
+            delete stages_[i];
+
+        stages_.clear();
+    }
+
+    bool ProcessPipeline::create(const std::vector<tstring> &cmd_lines)
+    {
+        if (running() || cmd_lines.empty())
+            return false;
+
+        clear();
+
+        for (size_t i = 0; i < cmd_lines.size(); i++)
+            stages_.push_back(new Stage(*this));
+
+        Locker<thread::Mutex> lock(mutex_);
+        running_stages_ = static_cast<tuint32>(stages_.size());
+        notify_ = true;
+        lock.unlock();
+
+        // Connect the processes, the descriptors are closed on exec so each
+        // pipe end is only inherited by the process using it.
+        int prev_fd = -1;
+        size_t created = 0;
+        for (; created < stages_.size(); created++)
+        {
+            int fd[2] = { -1,-1 };
+            bool last = created == stages_.size() - 1;
+            if (!last)
+            {
+#ifdef __linux__
+                if (pipe2(fd,O_CLOEXEC) != 0)
+                    break;
+#else
+                if (pipe(fd) != 0)
+                    break;
+
+                fcntl(fd[0],F_SETFD,FD_CLOEXEC);
+                fcntl(fd[1],F_SETFD,FD_CLOEXEC);
+#endif
+            }
+
+            bool res = stages_[created]->start(cmd_lines[created].c_str(),prev_fd,fd[1]);
+
+            // The child processes now hold their own copies.
+            if (prev_fd != -1)
+                ::close(prev_fd);
+            if (fd[1] != -1)
+                ::close(fd[1]);
+
+            prev_fd = fd[0];
+            if (!res)
+                break;
+        }
+
+        if (created == stages_.size())
+            return true;
+
+        if (prev_fd != -1)
+            ::close(prev_fd);
+
+        // Stop the processes already created without notifying the inheritor.
+        lock.relock();
+        notify_ = false;
+        running_stages_ -= static_cast<tuint32>(stages_.size() - created);
+        lock.unlock();
+
+        for (size_t i = 0; i < created; i++)
+            stages_[i]->kill();
+
+        clear();
+        return false;
+    }
+
+    bool ProcessPipeline::running() const
+    {
+        for (size_t i = 0; i < stages_.size(); i++)
+        {
+            if (stages_[i]->running())
+                return true;
+        }
+
+        return false;
+    }
+
+    bool ProcessPipeline::wait() const
+    {
+        for (size_t i = 0; i < stages_.size(); i++)
+            stages_[i]->wait();
+
+        return true;
+    }
+
+    bool ProcessPipeline::kill() const
+    {
+        bool res = false;
+        for (size_t i = 0; i < stages_.size(); i++)
+        {
+            if (stages_[i]->kill())
+                res = true;
+        }
+
+        return res;
+    }
+
+    size_t ProcessPipeline::size() const
+    {
+        return stages_.size();
+    }
+
+    bool ProcessPipeline::exit_code(tuint32 &exit_code) const
+    {
+        if (stages_.empty())
+            return false;
+
+        return stages_.back()->exit_code(exit_code);
+    }
+
+    bool ProcessPipeline::exit_code(size_t index,tuint32 &exit_code) const
+    {
+        if (index >= stages_.size())
+            return false;
+
+        return stages_[index]->exit_code(exit_code);
+    }
+
+    tint64 ProcessPipeline::write(const void *buffer,tuint32 count)
+    {
+        if (stages_.empty())
+            return -1;
+
+        return stages_.front()->write(buffer,count);
+    }
+
+    tint64 ProcessPipeline::feed(InStream &in)
+    {
+        if (stages_.empty())
+            return -1;
+
+        return stages_.front()->feed(in);
+    }
+
+    tint64 ProcessPipeline::feed(File &file)
+    {
+        if (stages_.empty())
+            return -1;
+
+        return stages_.front()->feed(file);
+    }
+
+    bool ProcessPipeline::close_input()
+    {
+        if (stages_.empty())
+            return false;
+
+        return stages_.front()->close_input();
+    }
+}
@@ -0,0 +1,375 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include "ckcore/locker.hh"
+#include "ckcore/processpool.hh"
+
+namespace ckcore
+{
+    /**
+     * Writes a buffer to the standard input of a process. SIGPIPE is blocked
+     * while writing so that a helper which has exited fails the write
+     * instead of terminating this process.
+     * @param [in] process The process to write to.
+     * @param [in] data The data to write.
+     * @param [in] size The number of bytes to write.
+     * @return If all data was written true is returned, otherwise false is
+     *         returned.
+     */
+    static bool write_all(Process &process,const char *data,size_t size)
+    {
+        sigset_t pipe_set,old_set,pending;
+        sigemptyset(&pipe_set);
+        sigaddset(&pipe_set,SIGPIPE);
+
+        sigpending(&pending);
+        bool was_pending = sigismember(&pending,SIGPIPE) == 1;
+        pthread_sigmask(SIG_BLOCK,&pipe_set,&old_set);
+
+        bool result = true;
+        while (size > 0)
+        {
+            tuint32 count = size < 0x10000000 ? static_cast<tuint32>(size) : 0x10000000;
+
+            errno = 0;
+            tint64 res = process.write(data,count);
+            if (res < 0 && errno == EINTR)
+                continue;
+
+            if (res <= 0)
+            {
+                result = false;
+                break;
+            }
+
+            data += res;
+            size -= static_cast<size_t>(res);
+        }
+
+        // Discard the signal raised by the failed write.
+        if (!result && !was_pending)
+        {
+            sigpending(&pending);
+            if (sigismember(&pending,SIGPIPE) == 1)
+            {
+                int sig = 0;
+                sigwait(&pipe_set,&sig);
+            }
+        }
+
+        pthread_sigmask(SIG_SETMASK,&old_set,NULL);
+        return result;
+    }
+
+    /**
+     * Reads an exact number of bytes from a stream.
+     * @param [in] in The stream to read from.
+     * @param [out] data The buffer to read into.
+     * @param [in] size The number of bytes to read.
+     * @return If all data was read true is returned, otherwise false is
+     *         returned.
+     */
+    static bool read_all(InStream &in,char *data,size_t size)
+    {
+        while (size > 0)
+        {
+            tuint32 count = size < 0x10000000 ? static_cast<tuint32>(size) : 0x10000000;
+
+            tint64 res = in.read(data,count);
+            if (res <= 0)
+                return false;
+
+            data += res;
+            size -= static_cast<size_t>(res);
+        }
+
+        return true;
+    }
+
+    ProcessPool::Worker::Worker() : jobs_(0)
+    {
+        set_raw_output(true);
+    }
+
+    ProcessPool::Worker::~Worker()
+    {
+        invalid_inheritor_ = true;
+    }
+
+    void ProcessPool::Worker::event_finished()
+    {
+    }
+
+    void ProcessPool::Worker::event_output(const std::string &block)
+    {
+    }
+
+    ProcessPool::Runner::Runner(ProcessPool &host,Worker *worker,Job *job) :
+        host_(host),worker_(worker),job_(job)
+    {
+    }
+
+    void ProcessPool::Runner::start()
+    {
+        host_.run(worker_,job_);
+    }
+
+    ProcessPool::ProcessPool(const tchar *cmd_line,tuint32 size,tuint32 max_jobs,
+                             ThreadPool &pool) :
+        cmd_line_(cmd_line),max_jobs_(max_jobs),pool_(pool),
+        ring_(JOB_RING_SIZE),ring_overflow_(0),sequence_(0),busy_workers_(0),
+        mutex_("ProcessPool")
+    {
+        for (tuint32 i = 0; i < size; i++)
+        {
+            workers_.push_back(new Worker());
+            idle_workers_.push_back(workers_.back());
+        }
+    }
+
+    ProcessPool::~ProcessPool()
+    {
+        wait();
+
+        // The helpers should exit when their input is closed.
+        for (size_t i = 0; i < workers_.size(); i++)
+            workers_[i]->close_input();
+
+        for (size_t i = 0; i < workers_.size(); i++)
+            delete workers_[i];
+    }
+
+    bool ProcessPool::launch(Worker &worker)
+    {
+        if (worker.running())
+            return true;
+
+        worker.jobs_ = 0;
+        return worker.create(cmd_line_.c_str());
+    }
+
+    bool ProcessPool::transact(Worker &worker,const std::string &request,
+                               std::string &response)
+    {
+        std::string frame;
+        frame.reserve(FRAME_HEADER_SIZE + request.size());
+
+        tuint32 size = static_cast<tuint32>(request.size());
+        frame += static_cast<char>((size >> 24) & 0xff);
+        frame += static_cast<char>((size >> 16) & 0xff);
+        frame += static_cast<char>((size >> 8) & 0xff);
+        frame += static_cast<char>(size & 0xff);
+        frame += request;
+
+        unsigned char header[FRAME_HEADER_SIZE];
+        bool success = write_all(worker,frame.data(),frame.size()) &&
+                       read_all(worker.output_stream(),reinterpret_cast<char *>(header),
+                                sizeof(header));
+
+        if (success)
+        {
+            size = (static_cast<tuint32>(header[0]) << 24) |
+                   (static_cast<tuint32>(header[1]) << 16) |
+                   (static_cast<tuint32>(header[2]) << 8) |
+                    static_cast<tuint32>(header[3]);
+
+            success = size <= MAX_FRAME_SIZE;
+            if (success)
+            {
+                response.resize(size);
+                success = size == 0 || read_all(worker.output_stream(),&response[0],size);
+            }
+        }
+
+        // The helper can't be trusted to be in sync with the protocol after
+        // a failure.
+        if (!success)
+        {
+            response.clear();
+            worker.kill();
+            worker.wait();
+        }
+
+        return success;
+    }
+
+    void ProcessPool::queue_job(Job *job,tuint32 priority)
+    {
+        // Default priority jobs must not pass those that overflowed the ring.
+        if (priority == 0 && ring_overflow_ == 0 && ring_.push(job))
+            return;
+
+        if (priority == 0)
+            ring_overflow_++;
+
+        QueuedJob queued;
+        queued.job_ = job;
+        queued.priority_ = priority;
+        queued.sequence_ = sequence_++;
+        queue_.push(queued);
+    }
+
+    bool ProcessPool::next_job(QueuedJob &next)
+    {
+        // The ring holds the oldest default priority jobs.
+        if ((queue_.empty() || queue_.top().priority_ == 0) && ring_.pop(next.job_))
+        {
+            next.priority_ = 0;
+            return true;
+        }
+
+        if (queue_.empty())
+            return false;
+
+        next = queue_.top();
+        queue_.pop();
+        if (next.priority_ == 0)
+            ring_overflow_--;
+
+        return true;
+    }
+
+    void ProcessPool::run(Worker *worker,Job *job)
+    {
+        std::string request,response;
+        job->request(request);
+
+        bool success = false;
+        {
+            // The thread is mostly waiting for the helper.
+            ThreadPool::BlockingScope scope(pool_);
+            success = launch(*worker) && transact(*worker,request,response);
+
+            // Replace worn out helpers before accepting the next job.
+            if (success && max_jobs_ != 0 && ++worker->jobs_ >= max_jobs_)
+            {
+                worker->close_input();
+                worker->wait();
+                launch(*worker);
+            }
+        }
+
+        job->event_finished(success,response);
+        if (job->auto_delete())
+            delete job;
+
+        Locker<thread::Mutex> lock(mutex_);
+        QueuedJob next;
+        if (!next_job(next))
+        {
+            idle_workers_.push_back(worker);
+            if (--busy_workers_ == 0)
+                idle_cond_.signal_all();
+
+            return;
+        }
+
+        lock.unlock();
+
+        if (!pool_.start(new Runner(*this,worker,next.job_),next.priority_))
+            run(worker,next.job_);
+    }
+
+    bool ProcessPool::create()
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        std::vector<Worker *> idle_workers = idle_workers_;
+        idle_workers_.clear();
+        busy_workers_ += static_cast<tuint32>(idle_workers.size());
+        lock.unlock();
+
+        bool result = true;
+        for (size_t i = 0; i < idle_workers.size(); i++)
+        {
+            if (!launch(*idle_workers[i]))
+                result = false;
+        }
+
+        // Jobs may have been queued while the workers were busy starting.
+        for (size_t i = 0; i < idle_workers.size(); i++)
+        {
+            lock.relock();
+            QueuedJob next;
+            if (!next_job(next))
+            {
+                idle_workers_.push_back(idle_workers[i]);
+                if (--busy_workers_ == 0)
+                    idle_cond_.signal_all();
+
+                lock.unlock();
+                continue;
+            }
+
+            lock.unlock();
+
+            if (!pool_.start(new Runner(*this,idle_workers[i],next.job_),next.priority_))
+                run(idle_workers[i],next.job_);
+        }
+
+        return result;
+    }
+
+    bool ProcessPool::start(Job *job,tuint32 priority)
+    {
+        if (job == NULL || workers_.empty())
+            return false;
+
+        Locker<thread::Mutex> lock(mutex_);
+        if (idle_workers_.empty())
+        {
+            queue_job(job,priority);
+            return true;
+        }
+
+        Worker *worker = idle_workers_.back();
+        idle_workers_.pop_back();
+        busy_workers_++;
+        lock.unlock();
+
+        if (pool_.start(new Runner(*this,worker,job),priority))
+            return true;
+
+        lock.relock();
+        idle_workers_.push_back(worker);
+        if (--busy_workers_ == 0)
+            idle_cond_.signal_all();
+
+        return false;
+    }
+
+    void ProcessPool::wait() const
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        while (busy_workers_ > 0 || !queue_.empty() || !ring_.empty())
+            idle_cond_.wait(mutex_);
+    }
+
+    tuint32 ProcessPool::size() const
+    {
+        return static_cast<tuint32>(workers_.size());
+    }
+
+    tuint32 ProcessPool::queued() const
+    {
+        Locker<thread::Mutex> lock(mutex_);
+        return static_cast<tuint32>(queue_.size()) + ring_.size();
+    }
+}
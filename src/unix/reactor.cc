@@ -0,0 +1,256 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+#include "ckcore/locker.hh"
+#include "reactor.hh"
+
+namespace ckcore
+{
+    Reactor::ReactorThread::ReactorThread(Reactor &host) : host_(host)
+    {
+    }
+
+    void Reactor::ReactorThread::run()
+    {
+        host_.run();
+    }
+
+    Reactor::Reactor() : poll_fd_(-1),exiting_(false),thread_id_(NULL),
+        mutex_("Reactor"),thread_(*this)
+    {
+        wake_fd_[0] = wake_fd_[1] = -1;
+
+#ifdef __linux__
+        poll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+
+        wake_fd_[0] = wake_fd_[1] = eventfd(0,EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wake_fd_[0] != -1 && poll_fd_ != -1)
+        {
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = wake_fd_[0];
+            epoll_ctl(poll_fd_,EPOLL_CTL_ADD,wake_fd_[0],&event);
+        }
+#endif
+
+        if (wake_fd_[0] == -1 && pipe(wake_fd_) == 0)
+        {
+            for (int i = 0; i < 2; i++)
+            {
+                fcntl(wake_fd_[i],F_SETFD,FD_CLOEXEC);
+                fcntl(wake_fd_[i],F_SETFL,fcntl(wake_fd_[i],F_GETFL) | O_NONBLOCK);
+            }
+        }
+    }
+
+    Reactor::~Reactor()
+    {
+        exiting_ = true;
+        wake();
+        thread_.wait();
+
+        if (poll_fd_ != -1)
+            close(poll_fd_);
+
+        if (wake_fd_[0] != -1)
+            close(wake_fd_[0]);
+        if (wake_fd_[1] != -1 && wake_fd_[1] != wake_fd_[0])
+            close(wake_fd_[1]);
+    }
+
+    void Reactor::wake()
+    {
+        // The eventfd requires writing eight bytes, a pipe accepts any size.
+        tuint64 value = 1;
+        ssize_t res;
+        do
+        {
+            res = write(wake_fd_[1],&value,sizeof(value));
+        } while (res < 0 && errno == EINTR);
+    }
+
+    void Reactor::dispatch(int fd)
+    {
+        if (fd == wake_fd_[0])
+        {
+            char buffer[64];
+            while (read(fd,buffer,sizeof(buffer)) > 0)
+                ;
+
+            return;
+        }
+
+        // The descriptor may have been removed by an earlier callback.
+        std::map<int,Entry>::const_iterator it = entries_.find(fd);
+        if (it == entries_.end())
+            return;
+
+        Entry entry = it->second;
+        entry.callback_(entry.param_,fd);
+    }
+
+    void Reactor::run()
+    {
+        thread_id_ = thread::identifier();
+
+        std::vector<struct pollfd> fds;
+        while (!exiting_)
+        {
+#ifdef __linux__
+            if (poll_fd_ != -1)
+            {
+                struct epoll_event events[MAX_EVENTS];
+                int count = epoll_wait(poll_fd_,events,MAX_EVENTS,-1);
+                if (count < 0)
+                    continue;
+
+                Locker<thread::Mutex> lock(mutex_);
+                for (int i = 0; i < count; i++)
+                    dispatch(events[i].data.fd);
+
+                continue;
+            }
+#endif
+            // Rebuild the poll set on each iteration, descriptors that are
+            // added or removed wake the thread.
+            {
+                Locker<thread::Mutex> lock(mutex_);
+
+                fds.resize(entries_.size() + 1);
+                fds[0].fd = wake_fd_[0];
+                fds[0].events = POLLIN;
+
+                size_t i = 1;
+                std::map<int,Entry>::const_iterator it;
+                for (it = entries_.begin(); it != entries_.end(); ++it,++i)
+                {
+                    fds[i].fd = it->first;
+                    fds[i].events = POLLIN;
+                }
+            }
+
+            int count = poll(&fds[0],fds.size(),-1);
+            if (count < 0)
+                continue;
+
+            Locker<thread::Mutex> lock(mutex_);
+            for (size_t i = 0; i < fds.size() && count > 0; i++)
+            {
+                if (fds[i].revents != 0)
+                {
+                    dispatch(fds[i].fd);
+                    count--;
+                }
+            }
+        }
+    }
+
+    Reactor &Reactor::instance()
+    {
+        static Reactor instance;
+        return instance;
+    }
+
+    bool Reactor::in_reactor_thread() const
+    {
+        return thread_id_ == thread::identifier();
+    }
+
+    bool Reactor::add(int fd,tcallback callback,void *param)
+    {
+        if (fd == -1 || callback == NULL)
+            return false;
+
+        // Callbacks run with the mutex locked.
+        bool reactor_thread = in_reactor_thread();
+        if (!reactor_thread)
+            mutex_.lock();
+
+        if (!thread_.running())
+        {
+            ThreadAttributes attr;
+            attr.name = ckT("reactor");
+            if (!thread_.start(attr))
+            {
+                if (!reactor_thread)
+                    mutex_.unlock();
+
+                return false;
+            }
+        }
+
+        bool res = entries_.count(fd) == 0;
+        if (res)
+        {
+#ifdef __linux__
+            if (poll_fd_ != -1)
+            {
+                struct epoll_event event;
+                event.events = EPOLLIN;
+                event.data.fd = fd;
+                res = epoll_ctl(poll_fd_,EPOLL_CTL_ADD,fd,&event) == 0;
+            }
+#endif
+            if (res)
+            {
+                entries_[fd].callback_ = callback;
+                entries_[fd].param_ = param;
+            }
+        }
+
+        if (!reactor_thread)
+            mutex_.unlock();
+
+        if (res && poll_fd_ == -1)
+            wake();
+
+        return res;
+    }
+
+    bool Reactor::remove(int fd)
+    {
+        bool reactor_thread = in_reactor_thread();
+        if (!reactor_thread)
+        {
+            // Interrupt the poll fallback so that it releases the mutex.
+            if (poll_fd_ == -1)
+                wake();
+
+            mutex_.lock();
+        }
+
+        bool res = entries_.erase(fd) > 0;
+#ifdef __linux__
+        if (res && poll_fd_ != -1)
+            epoll_ctl(poll_fd_,EPOLL_CTL_DEL,fd,NULL);
+#endif
+
+        if (!reactor_thread)
+            mutex_.unlock();
+
+        return res;
+    }
+}
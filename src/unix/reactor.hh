@@ -0,0 +1,154 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file src/unix/reactor.hh
+ * @brief Event loop for multiplexing file descriptors.
+ */
+
+#pragma once
+#include <map>
+#include <vector>
+#include "ckcore/types.hh"
+#include "ckcore/thread.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Event loop serving file descriptors from a single thread.
+     *
+     * The reactor waits for any number of file descriptors to become readable
+     * or to be hung up and calls the callback registered for each ready
+     * descriptor. On Linux epoll is used, on other systems poll. The thread is
+     * started when the first descriptor is added.
+     *
+     * Callbacks are executed on the reactor thread and must not block. They
+     * may add and remove descriptors. Once remove() has returned on another
+     * thread the callback of the descriptor will not be called again.
+     */
+    class Reactor
+    {
+    public:
+        /**
+         * Defines the callback type.
+         * @param [in] param The parameter passed to add().
+         * @param [in] fd The ready file descriptor.
+         */
+        typedef void (*tcallback)(void *param,int fd);
+
+    private:
+        enum
+        {
+            MAX_EVENTS = 64
+        };
+
+        /**
+         * @brief Registered file descriptor.
+         */
+        struct Entry
+        {
+            tcallback callback_;
+            void *param_;
+        };
+
+        /**
+         * @brief Reactor thread class.
+         */
+        class ReactorThread : public Thread
+        {
+        private:
+            Reactor &host_;
+
+            /**
+             * Executes the thread.
+             */
+            void run();
+
+        public:
+            /**
+             * Constructs a reactor thread object.
+             * @param [in] host The hosting reactor.
+             */
+            ReactorThread(Reactor &host);
+        };
+
+        int poll_fd_;           ///< epoll descriptor, -1 when using poll.
+        int wake_fd_[2];        ///< Descriptors for waking the reactor thread.
+        volatile bool exiting_;
+        volatile thandle thread_id_;
+
+        thread::Mutex mutex_;   ///< Held while dispatching callbacks.
+        std::map<int,Entry> entries_;
+        ReactorThread thread_;
+
+        Reactor();
+        ~Reactor();
+
+        Reactor(const Reactor &rhs);
+        Reactor &operator=(const Reactor &rhs);
+
+        /**
+         * Wakes the reactor thread.
+         */
+        void wake();
+
+        /**
+         * Calls the callback of a ready file descriptor. Must be called with
+         * the mutex locked.
+         * @param [in] fd The ready file descriptor.
+         */
+        void dispatch(int fd);
+
+        /**
+         * The reactor thread main loop.
+         */
+        void run();
+
+    public:
+        /**
+         * Returns the reactor instance.
+         * @return The reactor instance.
+         */
+        static Reactor &instance();
+
+        /**
+         * Checks if the calling thread is the reactor thread.
+         * @return If called from a reactor callback true is returned,
+         *         otherwise false is returned.
+         */
+        bool in_reactor_thread() const;
+
+        /**
+         * Starts monitoring a file descriptor.
+         * @param [in] fd The file descriptor.
+         * @param [in] callback The function to call when the descriptor is
+         *                      readable or has been hung up.
+         * @param [in] param Parameter to pass to the callback.
+         * @return If successful true is returned, otherwise false is returned.
+         */
+        bool add(int fd,tcallback callback,void *param);
+
+        /**
+         * Stops monitoring a file descriptor.
+         * @param [in] fd The file descriptor.
+         * @return If the descriptor was monitored true is returned, otherwise
+         *         false is returned.
+         */
+        bool remove(int fd);
+    };
+}
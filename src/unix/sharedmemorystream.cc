@@ -0,0 +1,729 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+#include "ckcore/atomic.hh"
+#include "ckcore/sharedmemorystream.hh"
+
+namespace ckcore
+{
+    /**
+     * @brief Ring state at the beginning of the shared memory, followed by
+     *        the ring data on the next page.
+     */
+    struct SharedMemoryRing::Control
+    {
+        enum
+        {
+            MAGIC = 0x636b7372     ///< "cksr"
+        };
+
+        tuint32 magic_;
+        tuint32 capacity_;
+        char pad0_[CACHE_LINE_SIZE - 2 * sizeof(tuint32)];
+
+        volatile tint32 head_;          ///< Read position.
+        volatile tint32 reader_waiting_;
+        volatile tint32 space_seq_;     ///< Changed when the writer should wake up.
+        char pad1_[CACHE_LINE_SIZE - 3 * sizeof(tint32)];
+
+        volatile tint32 tail_;          ///< Write position.
+        volatile tint32 writer_waiting_;
+        volatile tint32 data_seq_;      ///< Changed when the reader should wake up.
+        char pad2_[CACHE_LINE_SIZE - 3 * sizeof(tint32)];
+
+        volatile tint32 writer_closed_;
+        volatile tint32 reader_closed_;
+    };
+
+    /**
+     * Waits until the value of a word in shared memory differs from the
+     * expected value, at most PEER_CHECK_INTERVAL milliseconds. The function
+     * may return early.
+     * @param [in] word The word to wait on.
+     * @param [in] value The expected value.
+     * @return If the wait timed out true is returned, otherwise false is
+     *         returned.
+     */
+    static bool wait_word(volatile tint32 &word,tint32 value)
+    {
+#if defined(__linux__) && defined(SYS_futex)
+        // The futex can't be private since it's shared between processes.
+        struct timespec timeout = { 0,SharedMemoryRing::PEER_CHECK_INTERVAL * 1000000L };
+        return syscall(SYS_futex,&word,FUTEX_WAIT,value,&timeout,NULL,0) == -1 &&
+               errno == ETIMEDOUT;
+#else
+        if (atomic::load(word) == value)
+        {
+            struct timespec delay = { 0,100000 };
+            nanosleep(&delay,NULL);
+        }
+
+        return true;
+#endif
+    }
+
+    /**
+     * Changes a word in shared memory and wakes up a process waiting on it.
+     * @param [in] word The word to change.
+     */
+    static void wake_word(volatile tint32 &word)
+    {
+        atomic::add(word,1);
+#if defined(__linux__) && defined(SYS_futex)
+        syscall(SYS_futex,&word,FUTEX_WAKE,1,NULL,NULL,0);
+#endif
+    }
+
+    /**
+     * Creates an anonymous memory file.
+     * @return If successful the file descriptor is returned, otherwise -1 is
+     *         returned.
+     */
+    static int create_memory_file()
+    {
+#if defined(__linux__) && defined(SYS_memfd_create)
+        int fd = static_cast<int>(syscall(SYS_memfd_create,"ckcore-ring",1 /* MFD_CLOEXEC */));
+        if (fd != -1 || errno != ENOSYS)
+            return fd;
+#endif
+        // Shared memory objects are closed on exec by default.
+        for (int i = 0; i < 16; i++)
+        {
+            char name[64];
+            snprintf(name,sizeof(name),"/ckcore-ring-%ld-%ld-%d",
+                     static_cast<long>(getpid()),static_cast<long>(time(NULL)),i);
+
+            int fd = shm_open(name,O_RDWR | O_CREAT | O_EXCL,0600);
+            if (fd != -1)
+            {
+                shm_unlink(name);
+                return fd;
+            }
+
+            if (errno != EEXIST)
+                break;
+        }
+
+        return -1;
+    }
+
+    /**
+     * Creates a socket pair closed on exec.
+     * @param [out] fds Receives the socket descriptors.
+     * @return If successful true is returned, otherwise false is returned.
+     */
+    static bool create_socket_pair(int fds[2])
+    {
+        if (socketpair(AF_UNIX,SOCK_STREAM,0,fds) != 0)
+            return false;
+
+        fcntl(fds[0],F_SETFD,FD_CLOEXEC);
+        fcntl(fds[1],F_SETFD,FD_CLOEXEC);
+        return true;
+    }
+
+    /**
+     * Sends a file descriptor over a socket.
+     * @param [in] sock The socket.
+     * @param [in] fd The descriptor to send.
+     * @return If successful true is returned, otherwise false is returned.
+     */
+    static bool send_fd(int sock,int fd)
+    {
+        char data = 0;
+        struct iovec iov;
+        iov.iov_base = &data;
+        iov.iov_len = sizeof(data);
+
+        char control[CMSG_SPACE(sizeof(int))];
+        memset(control,0,sizeof(control));
+
+        struct msghdr msg;
+        memset(&msg,0,sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg),&fd,sizeof(int));
+
+        ssize_t res;
+        do
+        {
+            res = sendmsg(sock,&msg,0);
+        } while (res < 0 && errno == EINTR);
+
+        return res == sizeof(data);
+    }
+
+    /**
+     * Receives a file descriptor sent with send_fd(). The descriptor must
+     * already have been sent, the function does not wait.
+     * @param [in] sock The socket.
+     * @return If successful the received descriptor is returned, otherwise
+     *         -1 is returned.
+     */
+    static int receive_fd(int sock)
+    {
+        char data = 0;
+        struct iovec iov;
+        iov.iov_base = &data;
+        iov.iov_len = sizeof(data);
+
+        char control[CMSG_SPACE(sizeof(int))];
+        memset(control,0,sizeof(control));
+
+        struct msghdr msg;
+        memset(&msg,0,sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        int flags = MSG_DONTWAIT;
+#ifdef MSG_CMSG_CLOEXEC
+        flags |= MSG_CMSG_CLOEXEC;
+#endif
+        ssize_t res;
+        do
+        {
+            res = recvmsg(sock,&msg,flags);
+        } while (res < 0 && errno == EINTR);
+
+        if (res != sizeof(data))
+            return -1;
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET ||
+            cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int)))
+        {
+            return -1;
+        }
+
+        int fd = -1;
+        memcpy(&fd,CMSG_DATA(cmsg),sizeof(int));
+        fcntl(fd,F_SETFD,FD_CLOEXEC);
+        return fd;
+    }
+
+    /**
+     * Returns the offset of the ring data in the shared memory. The control
+     * block is given a page of its own.
+     * @return The offset in bytes.
+     */
+    static size_t data_offset()
+    {
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    SharedMemoryRing::SharedMemoryRing() : fd_(-1),sock_(-1),peer_sock_(-1),
+        peer_lost_(false),map_(MAP_FAILED),map_size_(0),control_(NULL),
+        buffer_(NULL),mask_(0)
+    {
+    }
+
+    SharedMemoryRing::~SharedMemoryRing()
+    {
+        close();
+    }
+
+    bool SharedMemoryRing::map(int fd,tuint32 capacity)
+    {
+        close();
+        fd_ = fd;
+
+        const size_t offset = data_offset();
+        if (capacity == 0)
+        {
+            struct stat st;
+            if (fstat(fd,&st) != 0 || static_cast<size_t>(st.st_size) <= offset)
+            {
+                close();
+                return false;
+            }
+
+            map_size_ = static_cast<size_t>(st.st_size);
+        }
+        else
+        {
+            map_size_ = offset + capacity;
+            if (ftruncate(fd,static_cast<off_t>(map_size_)) != 0)
+            {
+                close();
+                return false;
+            }
+        }
+
+        map_ = mmap(NULL,map_size_,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+        if (map_ == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+
+        // A new memory file is zero filled.
+        control_ = static_cast<Control *>(map_);
+        if (capacity != 0)
+        {
+            control_->magic_ = Control::MAGIC;
+            control_->capacity_ = capacity;
+        }
+        else if (control_->magic_ != Control::MAGIC ||
+                 map_size_ - offset != control_->capacity_ ||
+                 (control_->capacity_ & (control_->capacity_ - 1)) != 0)
+        {
+            close();
+            return false;
+        }
+
+        buffer_ = static_cast<unsigned char *>(map_) + offset;
+        mask_ = control_->capacity_ - 1;
+        return true;
+    }
+
+    bool SharedMemoryRing::peer_alive() const
+    {
+        if (sock_ == -1)
+            return true;
+
+        // The other end never writes anything, the socket only becomes
+        // readable once the other end has been closed.
+        struct pollfd pfd;
+        pfd.fd = sock_;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd,1,0) <= 0)
+            return true;
+
+        if (pfd.revents & (POLLHUP | POLLERR))
+            return false;
+
+        char c = 0;
+        return recv(sock_,&c,1,MSG_PEEK | MSG_DONTWAIT) != 0;
+    }
+
+    bool SharedMemoryRing::create(tuint32 capacity)
+    {
+        tuint32 size = 1;
+        while (size < capacity)
+            size <<= 1;
+
+        int fd = create_memory_file();
+        if (fd == -1)
+            return false;
+
+        if (!map(fd,size))
+            return false;
+
+        // The memory file is queued on the socket until the other process
+        // opens the ring.
+        int fds[2] = { -1,-1 };
+        if (!create_socket_pair(fds))
+        {
+            close();
+            return false;
+        }
+
+        sock_ = fds[0];
+        peer_sock_ = fds[1];
+        if (!send_fd(sock_,fd_))
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool SharedMemoryRing::open(int fd)
+    {
+        close();
+        if (fd == -1)
+            return false;
+
+        int mem_fd = receive_fd(fd);
+        if (mem_fd == -1 || !map(mem_fd,0))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        sock_ = fd;
+        return true;
+    }
+
+    void SharedMemoryRing::close()
+    {
+        if (map_ != MAP_FAILED)
+            munmap(map_,map_size_);
+
+        if (fd_ != -1)
+            ::close(fd_);
+
+        if (sock_ != -1)
+            ::close(sock_);
+
+        close_handle();
+
+        fd_ = -1;
+        sock_ = -1;
+        peer_lost_ = false;
+        map_ = MAP_FAILED;
+        map_size_ = 0;
+        control_ = NULL;
+        buffer_ = NULL;
+        mask_ = 0;
+    }
+
+    tuint32 SharedMemoryRing::wait_data(tuint32 &pos)
+    {
+        pos = 0;
+        if (control_ == NULL)
+            return 0;
+
+        const tuint32 head = static_cast<tuint32>(control_->head_);
+        pos = head & mask_;
+        for (;;)
+        {
+            tuint32 avail = static_cast<tuint32>(atomic::load(control_->tail_)) - head;
+            if (avail > 0)
+                return avail;
+
+            // The writer commits all data before closing the ring.
+            if (atomic::load(control_->writer_closed_) != 0)
+                return static_cast<tuint32>(atomic::load(control_->tail_)) - head;
+
+            if (peer_lost_)
+                return 0;
+
+            // Announce that we're about to wait and check again, the writer
+            // changes the sequence word if it adds data after seeing the flag.
+            bool expired = false;
+            tint32 seq = atomic::load(control_->data_seq_);
+            atomic::exchange(control_->reader_waiting_,1);
+            if (static_cast<tuint32>(atomic::load(control_->tail_)) == head &&
+                atomic::load(control_->writer_closed_) == 0)
+            {
+                expired = wait_word(control_->data_seq_,seq);
+            }
+
+            atomic::store(control_->reader_waiting_,0);
+
+            // A writer that exits without closing the ring never wakes us up.
+            if (expired && !peer_alive())
+                peer_lost_ = true;
+        }
+    }
+
+    tuint32 SharedMemoryRing::wait_space(tuint32 &pos)
+    {
+        pos = 0;
+        if (control_ == NULL)
+            return 0;
+
+        const tuint32 tail = static_cast<tuint32>(control_->tail_);
+        pos = tail & mask_;
+        for (;;)
+        {
+            if (atomic::load(control_->reader_closed_) != 0 || peer_lost_)
+                return 0;
+
+            tuint32 free = mask_ + 1 - (tail - static_cast<tuint32>(atomic::load(control_->head_)));
+            if (free > 0)
+                return free;
+
+            bool expired = false;
+            tint32 seq = atomic::load(control_->space_seq_);
+            atomic::exchange(control_->writer_waiting_,1);
+            if (tail - static_cast<tuint32>(atomic::load(control_->head_)) == mask_ + 1 &&
+                atomic::load(control_->reader_closed_) == 0)
+            {
+                expired = wait_word(control_->space_seq_,seq);
+            }
+
+            atomic::store(control_->writer_waiting_,0);
+
+            // A reader that exits without closing the ring never frees any
+            // space.
+            if (expired && !peer_alive())
+                peer_lost_ = true;
+        }
+    }
+
+    void SharedMemoryRing::consume(tuint32 count)
+    {
+        // A full barrier is needed between publishing the new position and
+        // checking whether the writer is waiting.
+        atomic::exchange(control_->head_,static_cast<tint32>(
+            static_cast<tuint32>(control_->head_) + count));
+
+        if (atomic::load(control_->writer_waiting_) != 0)
+            wake_word(control_->space_seq_);
+    }
+
+    void SharedMemoryRing::commit(tuint32 count)
+    {
+        atomic::exchange(control_->tail_,static_cast<tint32>(
+            static_cast<tuint32>(control_->tail_) + count));
+
+        if (atomic::load(control_->reader_waiting_) != 0)
+            wake_word(control_->data_seq_);
+    }
+
+    void SharedMemoryRing::close_reader()
+    {
+        if (control_ == NULL)
+            return;
+
+        atomic::exchange(control_->reader_closed_,1);
+        wake_word(control_->space_seq_);
+    }
+
+    void SharedMemoryRing::close_writer()
+    {
+        if (control_ == NULL)
+            return;
+
+        atomic::exchange(control_->writer_closed_,1);
+        wake_word(control_->data_seq_);
+    }
+
+    unsigned char *SharedMemoryRing::buffer() const
+    {
+        return buffer_;
+    }
+
+    void SharedMemoryRing::close_handle()
+    {
+        if (peer_sock_ != -1)
+            ::close(peer_sock_);
+
+        peer_sock_ = -1;
+    }
+
+    int SharedMemoryRing::handle() const
+    {
+        return peer_sock_;
+    }
+
+    bool SharedMemoryRing::peer_lost() const
+    {
+        return peer_lost_;
+    }
+
+    tuint32 SharedMemoryRing::capacity() const
+    {
+        return control_ != NULL ? mask_ + 1 : 0;
+    }
+
+    SharedMemoryOutStream::SharedMemoryOutStream(tuint32 capacity) :
+        capacity_(capacity)
+    {
+    }
+
+    SharedMemoryOutStream::~SharedMemoryOutStream()
+    {
+        close();
+    }
+
+    bool SharedMemoryOutStream::create()
+    {
+        return ring_.create(capacity_);
+    }
+
+    void SharedMemoryOutStream::close()
+    {
+        ring_.close_writer();
+        ring_.close();
+    }
+
+    int SharedMemoryOutStream::handle() const
+    {
+        return ring_.handle();
+    }
+
+    void SharedMemoryOutStream::close_handle()
+    {
+        ring_.close_handle();
+    }
+
+    tuint32 SharedMemoryOutStream::capacity() const
+    {
+        return ring_.capacity();
+    }
+
+    unsigned char *SharedMemoryOutStream::reserve(tuint32 &count)
+    {
+        tuint32 pos = 0;
+        tuint32 free = ring_.wait_space(pos);
+        if (free == 0)
+        {
+            count = 0;
+            return NULL;
+        }
+
+        const tuint32 contiguous = ring_.capacity() - pos;
+        if (count > free)
+            count = free;
+        if (count > contiguous)
+            count = contiguous;
+
+        return ring_.buffer() + pos;
+    }
+
+    void SharedMemoryOutStream::commit(tuint32 count)
+    {
+        ring_.commit(count);
+    }
+
+    tint64 SharedMemoryOutStream::write(const void *buffer,tuint32 count)
+    {
+        const unsigned char *data = static_cast<const unsigned char *>(buffer);
+
+        tuint32 written = 0;
+        while (written < count)
+        {
+            tuint32 reserved = count - written;
+            unsigned char *space = reserve(reserved);
+            if (space == NULL)
+                return written > 0 ? static_cast<tint64>(written) : -1;
+
+            memcpy(space,data + written,reserved);
+            commit(reserved);
+            written += reserved;
+        }
+
+        return written;
+    }
+
+    SharedMemoryInStream::SharedMemoryInStream()
+    {
+    }
+
+    SharedMemoryInStream::~SharedMemoryInStream()
+    {
+        close();
+    }
+
+    bool SharedMemoryInStream::open(int fd)
+    {
+        return ring_.open(fd);
+    }
+
+    void SharedMemoryInStream::close()
+    {
+        ring_.close_reader();
+        ring_.close();
+    }
+
+    const unsigned char *SharedMemoryInStream::peek(tuint32 &count)
+    {
+        tuint32 pos = 0;
+        tuint32 avail = ring_.wait_data(pos);
+        if (avail == 0)
+        {
+            count = 0;
+            return NULL;
+        }
+
+        const tuint32 contiguous = ring_.capacity() - pos;
+        count = avail < contiguous ? avail : contiguous;
+        return ring_.buffer() + pos;
+    }
+
+    void SharedMemoryInStream::consume(tuint32 count)
+    {
+        ring_.consume(count);
+    }
+
+    tint64 SharedMemoryInStream::read(void *buffer,tuint32 count)
+    {
+        if (count == 0)
+            return 0;
+
+        tuint32 pos = 0;
+        tuint32 avail = ring_.wait_data(pos);
+        if (avail == 0)
+            return ring_.peer_lost() ? -1 : 0;
+
+        if (avail > count)
+            avail = count;
+
+        // Copy in up to two pieces if the data wraps around the ring.
+        const tuint32 contiguous = ring_.capacity() - pos;
+        const tuint32 first = avail < contiguous ? avail : contiguous;
+
+        memcpy(buffer,ring_.buffer() + pos,first);
+        memcpy(static_cast<unsigned char *>(buffer) + first,ring_.buffer(),avail - first);
+
+        consume(avail);
+        return avail;
+    }
+
+    tint64 SharedMemoryInStream::size()
+    {
+        return -1;
+    }
+
+    bool SharedMemoryInStream::end()
+    {
+        // A lost writer is not a proper end of the stream, let the following
+        // read() report the failure.
+        tuint32 pos = 0;
+        return ring_.wait_data(pos) == 0 && !ring_.peer_lost();
+    }
+
+    bool SharedMemoryInStream::seek(tuint32 distance,StreamWhence whence)
+    {
+        if (whence != ckSTREAM_CURRENT)
+            return false;
+
+        while (distance > 0)
+        {
+            tuint32 count = 0;
+            if (peek(count) == NULL)
+                return false;
+
+            if (count > distance)
+                count = distance;
+
+            consume(count);
+            distance -= count;
+        }
+
+        return true;
+    }
+}
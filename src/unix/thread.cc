@@ -17,15 +17,200 @@
  */
 
 #include <algorithm>
+#include <limits.h>
 #include <limits>
 #include <memory>
+#include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <cxxabi.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <linux/mempolicy.h>
+#endif
+#include "ckcore/atomic.hh"
+#include "ckcore/lockprofiler.hh"
+#include "ckcore/system.hh"
 #include "ckcore/thread.hh"
 
 namespace ckcore
 {
+    namespace thread
+    {
+        /**
+         * Obtains the processors belonging to a NUMA node.
+         * @param [in] node The NUMA node.
+         * @param [out] cpus The processors of the node.
+         * @return If successful true is returned, if not false is returned.
+         */
+        static bool numa_node_cpus(tint32 node,std::vector<tuint32> &cpus)
+        {
+#ifdef __linux__
+            char path[64];
+            snprintf(path,sizeof(path),"/sys/devices/system/node/node%d/cpulist",
+                     static_cast<int>(node));
+
+            FILE *file = fopen(path,"r");
+            if (file == NULL)
+                return false;
+
+            // The list is formatted as comma separated ranges, "0-3,8-11".
+            unsigned int first = 0,last = 0;
+            int res;
+            while ((res = fscanf(file,"%u-%u",&first,&last)) >= 1)
+            {
+                if (res == 1)
+                    last = first;
+
+                for (unsigned int cpu = first; cpu <= last; cpu++)
+                    cpus.push_back(cpu);
+
+                if (fgetc(file) != ',')
+                    break;
+            }
+
+            fclose(file);
+            return !cpus.empty();
+#else
+            ckUNUSED(node);
+            ckUNUSED(cpus);
+            return false;
+#endif
+        }
+
+        /**
+         * Translates thread attributes into native thread attributes.
+         * @param [in] attr The thread attributes.
+         * @param [out] native_attr The native attributes to initialize.
+         * @return If successful true is returned, if not false is returned.
+         */
+        static bool native_attributes(const ThreadAttributes &attr,
+                                      pthread_attr_t &native_attr)
+        {
+            if (pthread_attr_init(&native_attr) != 0)
+                return false;
+
+            if (attr.stack_size > 0)
+            {
+                size_t stack_size = std::max(static_cast<size_t>(attr.stack_size),
+                                             static_cast<size_t>(PTHREAD_STACK_MIN));
+                if (pthread_attr_setstacksize(&native_attr,stack_size) != 0)
+                {
+                    pthread_attr_destroy(&native_attr);
+                    return false;
+                }
+            }
+
+#ifdef __linux__
+            // Restrict the thread to the requested processors, or the
+            // processors of the requested NUMA node.
+            std::vector<tuint32> cpus = attr.cpu_affinity;
+            if (cpus.empty() && attr.numa_node >= 0)
+                numa_node_cpus(attr.numa_node,cpus);
+
+            if (!cpus.empty())
+            {
+                cpu_set_t cpu_set;
+                CPU_ZERO(&cpu_set);
+
+                std::vector<tuint32>::const_iterator it;
+                for (it = cpus.begin(); it != cpus.end(); it++)
+                {
+                    if (*it < CPU_SETSIZE)
+                        CPU_SET(*it,&cpu_set);
+                }
+
+                if (pthread_attr_setaffinity_np(&native_attr,sizeof(cpu_set),&cpu_set) != 0)
+                {
+                    pthread_attr_destroy(&native_attr);
+                    return false;
+                }
+            }
+#endif
+
+            if (attr.sched_policy != ThreadAttributes::ckSCHED_DEFAULT)
+            {
+                int policy = SCHED_OTHER;
+                switch (attr.sched_policy)
+                {
+#ifdef __linux__
+                    case ThreadAttributes::ckSCHED_BATCH:
+                        policy = SCHED_BATCH;
+                        break;
+                    case ThreadAttributes::ckSCHED_IDLE:
+                        policy = SCHED_IDLE;
+                        break;
+#endif
+                    case ThreadAttributes::ckSCHED_FIFO:
+                        policy = SCHED_FIFO;
+                        break;
+                    case ThreadAttributes::ckSCHED_RR:
+                        policy = SCHED_RR;
+                        break;
+                    default:
+                        break;
+                }
+
+                struct sched_param param;
+                memset(&param,0,sizeof(param));
+                if (policy == SCHED_FIFO || policy == SCHED_RR)
+                    param.sched_priority = attr.sched_priority;
+
+                if (pthread_attr_setinheritsched(&native_attr,PTHREAD_EXPLICIT_SCHED) != 0 ||
+                    pthread_attr_setschedpolicy(&native_attr,policy) != 0 ||
+                    pthread_attr_setschedparam(&native_attr,&param) != 0)
+                {
+                    pthread_attr_destroy(&native_attr);
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /**
+         * Applies the thread attributes which can only be applied from within
+         * the thread itself.
+         * @param [in] name The thread name.
+         * @param [in] numa_node The NUMA node to allocate memory from.
+         */
+        static void apply_attributes(const tstring &name,tint32 numa_node)
+        {
+            if (!name.empty())
+            {
+#if defined(__linux__)
+                // Linux limits the name to 16 characters including the terminator.
+                pthread_setname_np(pthread_self(),name.substr(0,15).c_str());
+#elif defined(__APPLE__)
+                pthread_setname_np(name.c_str());
+#endif
+            }
+
+#ifdef __linux__
+            // Prefer memory allocations from the local node. Since the thread
+            // is also bound to the node processors this keeps buffers
+            // allocated by the thread node local.
+            if (numa_node >= 0)
+            {
+                const size_t bits = sizeof(unsigned long) * 8;
+                std::vector<unsigned long> mask(numa_node / bits + 1,0);
+                mask[numa_node / bits] |= 1UL << (numa_node % bits);
+
+                syscall(SYS_set_mempolicy,MPOL_PREFERRED,&mask[0],
+                        mask.size() * bits + 1);
+            }
+#else
+            ckUNUSED(numa_node);
+#endif
+        }
+    }
+
     Thread::Thread()
-        : thread_(0),running_(false)
+        : thread_(0),running_(false),numa_node_(-1),mutex_("Thread")
     {
     }
 
@@ -39,11 +224,20 @@ namespace ckcore
         pthread_cleanup_push(cleanup,param);
 
         Thread *thread = static_cast<Thread *>(param);
+        thread::apply_attributes(thread->name_,thread->numa_node_);
 
         try
         {
             thread->run();
         }
+#ifdef __linux__
+        catch (abi::__forced_unwind &)
+        {
+            // Cancellation unwinds the stack using an exception which must
+            // not be swallowed.
+            throw;
+        }
+#endif
         catch (...)
         {
         }
@@ -62,14 +256,28 @@ namespace ckcore
     }
 
     bool Thread::start()
+    {
+        return start(ThreadAttributes());
+    }
+
+    bool Thread::start(const ThreadAttributes &attr)
     {
         Locker<thread::Mutex> lock(mutex_);
 
         if (running_)
             return false;
 
+        pthread_attr_t native_attr;
+        if (!thread::native_attributes(attr,native_attr))
+            return false;
+
+        name_ = attr.name;
+        numa_node_ = attr.numa_node;
+
         // Create the thread.
-        if (pthread_create(&thread_,NULL,native_thread,this) != 0)
+        int res = pthread_create(&thread_,&native_attr,native_thread,this);
+        pthread_attr_destroy(&native_attr);
+        if (res != 0)
             return false;
 
         running_ = true;
@@ -180,7 +388,494 @@ namespace ckcore
             return reinterpret_cast<thandle>(pthread_self());
         }
 
+#ifdef __linux__
+        /**
+         * Number of times to spin before sleeping in the kernel when waiting
+         * for a synchronization object.
+         */
+        static const tuint32 SPIN_COUNT = 100;
+
+        /**
+         * Returns the number of times to spin before sleeping. Spinning is
+         * pointless on single processor systems since the thread we are
+         * waiting for can't run while we're spinning.
+         * @return The number of times to spin.
+         */
+        static tuint32 spin_count()
+        {
+            static const tuint32 count = ideal_count() > 1 ? SPIN_COUNT : 0;
+            return count;
+        }
+
+        /**
+         * Sleeps as long as the futex word contains the expected value.
+         * @param [in] addr The futex word.
+         * @param [in] expected The expected value.
+         * @param [in] timeout Relative time out or NULL to wait forever.
+         * @return If woken up 0 is returned, otherwise the error code is
+         *         returned.
+         */
+        static int futex_wait(volatile tint32 *addr,tint32 expected,
+                              const struct timespec *timeout)
+        {
+            if (syscall(SYS_futex,addr,FUTEX_WAIT_PRIVATE,expected,timeout,
+                        NULL,0) == 0)
+            {
+                return 0;
+            }
+
+            return errno;
+        }
+
+        /**
+         * Sleeps as long as the futex word contains the expected value. The
+         * wait is a cancellation point, like the waits it implements in the
+         * pthread library.
+         * @param [in] addr The futex word.
+         * @param [in] expected The expected value.
+         * @param [in] timeout Relative time out or NULL to wait forever.
+         * @return If woken up 0 is returned, otherwise the error code is
+         *         returned.
+         */
+        static int futex_wait_cancel(volatile tint32 *addr,tint32 expected,
+                                     const struct timespec *timeout)
+        {
+            // Switching to asynchronous cancellation acts on any pending
+            // request, and a request arriving while sleeping interrupts the
+            // system call.
+            int old_type = PTHREAD_CANCEL_DEFERRED;
+            pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS,&old_type);
+            int res = futex_wait(addr,expected,timeout);
+            pthread_setcanceltype(old_type,NULL);
+
+            return res;
+        }
+
+        /**
+         * Cleanup handler removing a thread cancelled while waiting from a
+         * waiter count.
+         * @param [in] param Pointer to the waiter count.
+         */
+        static void waiter_cancelled(void *param)
+        {
+            atomic::add(*static_cast<volatile tint32 *>(param),-1);
+        }
+
+        /**
+         * Wakes threads sleeping on a futex word.
+         * @param [in] addr The futex word.
+         * @param [in] count The maximum number of threads to wake.
+         */
+        static void futex_wake(volatile tint32 *addr,tint32 count)
+        {
+            syscall(SYS_futex,addr,FUTEX_WAKE_PRIVATE,count,NULL,NULL,0);
+        }
+
+        /**
+         * @brief Helper class for measuring time outs using the monotonic
+         *        clock.
+         */
+        class Deadline
+        {
+        private:
+            bool infinite_;
+            tuint64 end_;
+            struct timespec remaining_;
+
+        public:
+            Deadline(tuint32 timeout)
+                : infinite_(timeout == std::numeric_limits<tuint32>::max()),
+                  end_(infinite_ ? 0 : system::time() + timeout)
+            {
+            }
+
+            /**
+             * Calculates the remaining time.
+             * @param [out] remaining Pointer to the remaining time, NULL if
+             *                        waiting forever.
+             * @return If the deadline has passed false is returned, otherwise
+             *         true is returned.
+             */
+            bool remaining(const struct timespec *&remaining)
+            {
+                remaining = NULL;
+                if (infinite_)
+                    return true;
+
+                tuint64 now = system::time();
+                if (now >= end_)
+                    return false;
+
+                tuint64 left = end_ - now;
+                remaining_.tv_sec = static_cast<time_t>(left / 1000);
+                remaining_.tv_nsec = static_cast<long>((left % 1000) * 1000000);
+                remaining = &remaining_;
+                return true;
+            }
+        };
+
         Mutex::Mutex()
+            : state_(0),profile_(NULL),acquired_(0)
+        {
+        }
+
+        Mutex::Mutex(const char *name)
+            : state_(0),profile_(LockProfiler::profile(name)),acquired_(0)
+        {
+        }
+
+        Mutex::~Mutex()
+        {
+        }
+
+        bool Mutex::lock()
+        {
+            if (atomic::compare_exchange(state_,0,1) == 0)
+            {
+                if (profile_ != NULL)
+                    profile_->acquired(acquired_,false);
+
+                return true;
+            }
+
+            tuint64 wait_start = profile_ != NULL ? profile_->start_wait() : 0;
+
+            // Spin for a while hoping that the mutex will be released soon.
+            bool locked = false;
+            for (tuint32 i = spin_count(); i > 0 && !locked; i--)
+            {
+                atomic::pause();
+
+                locked = atomic::load(state_) == 0 &&
+                         atomic::compare_exchange(state_,0,1) == 0;
+            }
+
+            // Mark the mutex as having waiters and sleep until released.
+            if (!locked)
+            {
+                while (atomic::exchange(state_,2) != 0)
+                    futex_wait(&state_,2,NULL);
+            }
+
+            if (profile_ != NULL)
+                profile_->acquired(acquired_,true,wait_start);
+
+            return true;
+        }
+
+        bool Mutex::unlock()
+        {
+            if (profile_ != NULL)
+                profile_->released(acquired_);
+
+            // Only wake a waiter if there might be one.
+            if (atomic::add(state_,-1) != 0)
+            {
+                atomic::store(state_,0);
+                futex_wake(&state_,1);
+            }
+
+            return true;
+        }
+
+        bool Mutex::try_lock()
+        {
+            if (atomic::compare_exchange(state_,0,1) != 0)
+                return false;
+
+            if (profile_ != NULL)
+                profile_->acquired(acquired_,false);
+
+            return true;
+        }
+
+        /*
+         * The wait condition state packs the number of waiters and the number
+         * of pending wakeups into one integer so that both can be updated
+         * atomically. The number of wakeups never exceeds the number of
+         * waiters, which guarantees that signal_one() wakes at most one
+         * thread.
+         */
+        static const tint32 WC_WAITER = 1 << 16;
+        static const tint32 WC_WAKEUP_MASK = WC_WAITER - 1;
+
+        WaitCondition::WaitCondition()
+            : state_(0),seq_(0)
+        {
+        }
+
+        WaitCondition::~WaitCondition()
+        {
+        }
+
+        bool WaitCondition::try_wake()
+        {
+            while (true)
+            {
+                tint32 state = atomic::load(state_);
+                if ((state & WC_WAKEUP_MASK) == 0)
+                    return false;
+
+                if (atomic::compare_exchange(state_,state,state - WC_WAITER - 1) == state)
+                    return true;
+            }
+        }
+
+        bool WaitCondition::wait(tuint32 timeout)
+        {
+            for (tuint32 i = spin_count(); i > 0; i--)
+            {
+                if (try_wake())
+                    return true;
+
+                atomic::pause();
+            }
+
+            Deadline deadline(timeout);
+            while (true)
+            {
+                // The sequence number must be read before checking for
+                // wakeups so that we don't sleep through a signal.
+                tint32 seq = atomic::load(seq_);
+                if (try_wake())
+                    return true;
+
+                // Leave, unless we were signaled while timing out.
+                const struct timespec *remaining = NULL;
+                if (!deadline.remaining(remaining) ||
+                    futex_wait_cancel(&seq_,seq,remaining) == ETIMEDOUT)
+                {
+                    return leave();
+                }
+            }
+        }
+
+        bool WaitCondition::leave()
+        {
+            while (true)
+            {
+                tint32 state = atomic::load(state_);
+                if ((state & WC_WAKEUP_MASK) != 0)
+                {
+                    if (atomic::compare_exchange(state_,state,state - WC_WAITER - 1) == state)
+                        return true;
+                }
+                else if (atomic::compare_exchange(state_,state,state - WC_WAITER) == state)
+                {
+                    return false;
+                }
+            }
+        }
+
+        /**
+         * @brief Parameters to the cleanup handler of a cancelled wait.
+         */
+        struct WaitCancelParam
+        {
+            WaitCondition *cond;
+            Mutex *mutex;
+        };
+
+        void WaitCondition::cancelled(void *param)
+        {
+            WaitCancelParam *cancel_param = static_cast<WaitCancelParam *>(param);
+
+            // Like pthread_cond_wait() a cancelled thread must not swallow a
+            // signal meant for another waiter, and it must own the mutex when
+            // the cancellation continues.
+            if (cancel_param->cond->leave())
+                cancel_param->cond->signal_one();
+
+            cancel_param->mutex->lock();
+        }
+
+        bool WaitCondition::wait(Mutex &mutex,tuint32 timeout)
+        {
+            atomic::add(state_,WC_WAITER);
+            mutex.unlock();
+
+            WaitCancelParam cancel_param = { this,&mutex };
+            bool res = false;
+
+            pthread_cleanup_push(cancelled,&cancel_param);
+            res = wait(timeout);
+            pthread_cleanup_pop(0);
+
+            mutex.lock();
+            return res;
+        }
+
+        void WaitCondition::signal_one()
+        {
+            while (true)
+            {
+                tint32 state = atomic::load(state_);
+                if ((state & WC_WAKEUP_MASK) >= (state >> 16))
+                    return;
+
+                if (atomic::compare_exchange(state_,state,state + 1) == state)
+                    break;
+            }
+
+            atomic::add(seq_,1);
+            futex_wake(&seq_,1);
+        }
+
+        void WaitCondition::signal_all()
+        {
+            while (true)
+            {
+                tint32 state = atomic::load(state_);
+                tint32 waiters = state >> 16;
+                if ((state & WC_WAKEUP_MASK) >= waiters)
+                    return;
+
+                if (atomic::compare_exchange(state_,state,(state & ~WC_WAKEUP_MASK) | waiters) == state)
+                    break;
+            }
+
+            atomic::add(seq_,1);
+            futex_wake(&seq_,INT_MAX);
+        }
+
+        Event::Event(bool manual_reset)
+            : manual_reset_(manual_reset),state_(0),waiters_(0)
+        {
+        }
+
+        Event::~Event()
+        {
+        }
+
+        bool Event::try_pass()
+        {
+            if (manual_reset_)
+                return atomic::load(state_) != 0;
+
+            return atomic::compare_exchange(state_,1,0) == 1;
+        }
+
+        void Event::set()
+        {
+            // The exchange is a full barrier, a release store could be
+            // reordered after the load of the waiter count and miss a thread
+            // that just started waiting.
+            atomic::exchange(state_,1);
+            if (atomic::load(waiters_) > 0)
+                futex_wake(&state_,manual_reset_ ? INT_MAX : 1);
+        }
+
+        void Event::reset()
+        {
+            atomic::store(state_,0);
+        }
+
+        bool Event::wait(tuint32 timeout)
+        {
+            for (tuint32 i = spin_count(); i > 0; i--)
+            {
+                if (try_pass())
+                    return true;
+
+                atomic::pause();
+            }
+
+            Deadline deadline(timeout);
+            while (!try_pass())
+            {
+                const struct timespec *remaining = NULL;
+                if (!deadline.remaining(remaining))
+                    return false;
+
+                atomic::add(waiters_,1);
+                pthread_cleanup_push(waiter_cancelled,const_cast<tint32 *>(&waiters_));
+                futex_wait_cancel(&state_,0,remaining);
+                pthread_cleanup_pop(0);
+                atomic::add(waiters_,-1);
+            }
+
+            return true;
+        }
+
+        Semaphore::Semaphore(tuint32 count)
+            : count_(static_cast<tint32>(count)),waiters_(0)
+        {
+        }
+
+        Semaphore::~Semaphore()
+        {
+        }
+
+        bool Semaphore::try_acquire()
+        {
+            while (true)
+            {
+                tint32 count = atomic::load(count_);
+                if (count <= 0)
+                    return false;
+
+                if (atomic::compare_exchange(count_,count,count - 1) == count)
+                    return true;
+            }
+        }
+
+        bool Semaphore::wait(tuint32 timeout)
+        {
+            for (tuint32 i = spin_count(); i > 0; i--)
+            {
+                if (try_acquire())
+                    return true;
+
+                atomic::pause();
+            }
+
+            Deadline deadline(timeout);
+            while (!try_acquire())
+            {
+                const struct timespec *remaining = NULL;
+                if (!deadline.remaining(remaining))
+                    return false;
+
+                atomic::add(waiters_,1);
+                pthread_cleanup_push(waiter_cancelled,const_cast<tint32 *>(&waiters_));
+                futex_wait_cancel(&count_,0,remaining);
+                pthread_cleanup_pop(0);
+                atomic::add(waiters_,-1);
+            }
+
+            return true;
+        }
+
+        void Semaphore::release(tuint32 count)
+        {
+            atomic::add(count_,static_cast<tint32>(count));
+            if (atomic::load(waiters_) > 0)
+                futex_wake(&count_,static_cast<tint32>(count));
+        }
+#else
+        /**
+         * Calculates the absolute time a time out expires.
+         * @param [in] timeout Time out in milliseconds.
+         * @param [out] abs_time The absolute time.
+         */
+        static void abs_time(tuint32 timeout,timespec &abs_time)
+        {
+            struct timeval tv;
+            gettimeofday(&tv,0);
+
+            abs_time.tv_nsec = (tv.tv_usec + (timeout % 1000) * 1000) * 1000;
+            abs_time.tv_sec = tv.tv_sec + (timeout / 1000) + (abs_time.tv_nsec / 1000000000);
+            abs_time.tv_nsec %= 1000000000;
+        }
+
+        Mutex::Mutex()
+            : profile_(NULL),acquired_(0)
+        {
+            pthread_mutex_init(&mutex_,NULL);
+        }
+
+        Mutex::Mutex(const char *name)
+            : profile_(LockProfiler::profile(name)),acquired_(0)
         {
             pthread_mutex_init(&mutex_,NULL);
         }
@@ -192,17 +887,40 @@ namespace ckcore
 
         bool Mutex::lock()
         {
-            return pthread_mutex_lock(&mutex_) == 0;
+            if (profile_ == NULL)
+                return pthread_mutex_lock(&mutex_) == 0;
+
+            if (pthread_mutex_trylock(&mutex_) == 0)
+            {
+                profile_->acquired(acquired_,false);
+                return true;
+            }
+
+            tuint64 wait_start = profile_->start_wait();
+            if (pthread_mutex_lock(&mutex_) != 0)
+                return false;
+
+            profile_->acquired(acquired_,true,wait_start);
+            return true;
         }
 
         bool Mutex::unlock()
         {
+            if (profile_ != NULL)
+                profile_->released(acquired_);
+
             return pthread_mutex_unlock(&mutex_) == 0;
         }
 
         bool Mutex::try_lock()
         {
-            return pthread_mutex_trylock(&mutex_) == 0;
+            if (pthread_mutex_trylock(&mutex_) != 0)
+                return false;
+
+            if (profile_ != NULL)
+                profile_->acquired(acquired_,false);
+
+            return true;
         }
 
         WaitCondition::WaitCondition()
@@ -232,13 +950,8 @@ namespace ckcore
                 }
                 else
                 {
-                    struct timeval tv;
-                    gettimeofday(&tv,0);
-
                     timespec ti;
-                    ti.tv_nsec = (tv.tv_usec + (timeout % 1000) * 1000) * 1000;
-                    ti.tv_sec = tv.tv_sec + (timeout / 1000) + (ti.tv_nsec / 1000000000);
-                    ti.tv_nsec %= 1000000000;
+                    abs_time(timeout,ti);
 
                     res = pthread_cond_timedwait(&cond_,&mutex_,&ti);
                 }
@@ -286,6 +999,112 @@ namespace ckcore
             pthread_cond_broadcast(&cond_);
             pthread_mutex_unlock(&mutex_);
         }
+
+        Event::Event(bool manual_reset)
+            : manual_reset_(manual_reset),state_(false)
+        {
+            pthread_mutex_init(&mutex_,NULL);
+            pthread_cond_init(&cond_,NULL);
+        }
+
+        Event::~Event()
+        {
+            pthread_cond_destroy(&cond_);
+            pthread_mutex_destroy(&mutex_);
+        }
+
+        void Event::set()
+        {
+            pthread_mutex_lock(&mutex_);
+            state_ = true;
+            if (manual_reset_)
+                pthread_cond_broadcast(&cond_);
+            else
+                pthread_cond_signal(&cond_);
+            pthread_mutex_unlock(&mutex_);
+        }
+
+        void Event::reset()
+        {
+            pthread_mutex_lock(&mutex_);
+            state_ = false;
+            pthread_mutex_unlock(&mutex_);
+        }
+
+        bool Event::wait(tuint32 timeout)
+        {
+            timespec ti;
+            if (timeout != std::numeric_limits<tuint32>::max())
+                abs_time(timeout,ti);
+
+            pthread_mutex_lock(&mutex_);
+
+            int res = 0;
+            while (!state_ && res == 0)
+            {
+                if (timeout == std::numeric_limits<tuint32>::max())
+                    res = pthread_cond_wait(&cond_,&mutex_);
+                else
+                    res = pthread_cond_timedwait(&cond_,&mutex_,&ti);
+            }
+
+            bool signaled = state_;
+            if (signaled && !manual_reset_)
+                state_ = false;
+
+            pthread_mutex_unlock(&mutex_);
+            return signaled;
+        }
+
+        Semaphore::Semaphore(tuint32 count)
+            : count_(count)
+        {
+            pthread_mutex_init(&mutex_,NULL);
+            pthread_cond_init(&cond_,NULL);
+        }
+
+        Semaphore::~Semaphore()
+        {
+            pthread_cond_destroy(&cond_);
+            pthread_mutex_destroy(&mutex_);
+        }
+
+        bool Semaphore::wait(tuint32 timeout)
+        {
+            timespec ti;
+            if (timeout != std::numeric_limits<tuint32>::max())
+                abs_time(timeout,ti);
+
+            pthread_mutex_lock(&mutex_);
+
+            int res = 0;
+            while (count_ == 0 && res == 0)
+            {
+                if (timeout == std::numeric_limits<tuint32>::max())
+                    res = pthread_cond_wait(&cond_,&mutex_);
+                else
+                    res = pthread_cond_timedwait(&cond_,&mutex_,&ti);
+            }
+
+            bool acquired = count_ > 0;
+            if (acquired)
+                count_--;
+
+            pthread_mutex_unlock(&mutex_);
+            return acquired;
+        }
+
+        void Semaphore::release(tuint32 count)
+        {
+            pthread_mutex_lock(&mutex_);
+            count_ += count;
+            if (count > 1)
+                pthread_cond_broadcast(&cond_);
+            else
+                pthread_cond_signal(&cond_);
+            pthread_mutex_unlock(&mutex_);
+        }
+#endif
     }
 }
 
@@ -18,6 +18,7 @@
 
 #include "stdafx.hh"
 #include "ckcore/assert.hh"
+#include "ckcore/bufferpool.hh"
 #include "ckcore/stream.hh"
 #include "ckcore/process.hh"
 
@@ -40,9 +41,15 @@ namespace ckcore
         // Create the stop event that will be used to kill the listening thread.
         stop_event_ = CreateEvent(NULL,true,false,NULL);
 
+        memset(&usage_,0,sizeof(usage_));
+
         // Insert default delimiters.
-        block_delims_.insert('\n');
-        block_delims_.insert('\r');
+        memset(delim_table_,0,sizeof(delim_table_));
+        delim_count_ = 0;
+        single_delim_ = 0;
+
+        add_block_delim('\n');
+        add_block_delim('\r');
     }
 
     Process::~Process()
@@ -155,6 +162,17 @@ namespace ckcore
 
             ckASSERT(exit_code_ != STILL_ACTIVE);
 
+            // Collect the resource usage, the times are in 100 nanosecond units.
+            FILETIME creation_time,exit_time,kernel_time,user_time;
+            if (GetProcessTimes(process_handle_,&creation_time,&exit_time,
+                                &kernel_time,&user_time) != FALSE)
+            {
+                usage_.user_time_ = ((static_cast<tuint64>(user_time.dwHighDateTime) << 32) |
+                                     user_time.dwLowDateTime) / 10;
+                usage_.system_time_ = ((static_cast<tuint64>(kernel_time.dwHighDateTime) << 32) |
+                                       kernel_time.dwLowDateTime) / 10;
+            }
+
             ckVERIFY(0 != CloseHandle(process_handle_));
             process_handle_ = NULL;
         }
@@ -170,9 +188,27 @@ namespace ckcore
             ckVERIFY(0 != ReleaseMutex(mutex_));
     }
 
+    const char *Process::find_delim(const char *begin,const char *end) const
+    {
+        if (delim_count_ == 1)
+        {
+            const void *delim = memchr(begin,single_delim_,end - begin);
+            return delim != NULL ? static_cast<const char *>(delim) : end;
+        }
+
+        while (begin < end && !delim_table_[static_cast<unsigned char>(*begin)])
+            ++begin;
+
+        return begin;
+    }
+
     bool Process::read_output(HANDLE handle)
     {
-        char buffer[READ_BUFFER_SIZE];
+        // The buffer is only needed while reading, taking it from the pool
+        // avoids keeping one per process.
+        PooledBuffer read_buffer(READ_BUFFER_SIZE);
+        if (read_buffer.data() == NULL)
+            return false;
 
         while (true)
         {
@@ -184,43 +220,46 @@ namespace ckcore
                 return true;
 
             unsigned long read = 0;
-            if (!ReadFile(handle,buffer,min(bytes_avail,READ_BUFFER_SIZE - 1),&read,NULL) || read == 0)
+            if (!ReadFile(handle,read_buffer.data(),min(bytes_avail,READ_BUFFER_SIZE),&read,NULL) || read == 0)
                 break;
 
-            buffer[read] = '\0';
+            const char *cur = reinterpret_cast<const char *>(read_buffer.data());
+            const char *end = cur + read;
+
+            // Only the first block can continue a partial block, it's moved
+            // here so that it stays valid until the blocks have been delivered.
+            std::string first_block;
 
             // Split the buffer into blocks.
-            for (unsigned long i = 0; i < read; i++)
+            blocks_.clear();
+            while (cur < end)
             {
-                // Check if we have found a block delimiter.
-                bool is_delim = false;
-
-                std::set<char>::const_iterator it;
-                for (it = block_delims_.begin(); it != block_delims_.end(); it++)
+                const char *delim = find_delim(cur,end);
+                if (delim == end)
                 {
-                    if (buffer[i] == *it)
-                    {
-                        is_delim = true;
-                        break;
-                    }
+                    block_buffer_.append(cur,end);
+                    break;
                 }
 
-                if (is_delim)
-                {
-                    // Avoid flushing an empty buffer.
-                    if (block_buffer_.size() >  0)
-                    {
-                        if (!invalid_inheritor_)
-                            event_output(block_buffer_);
-
-                        block_buffer_.resize(0);
-                    }
-                }
-                else
+                Block block = { cur,static_cast<size_t>(delim - cur) };
+                if (!block_buffer_.empty())
                 {
-                    block_buffer_.push_back(buffer[i]);
+                    block_buffer_.append(cur,delim);
+                    first_block.swap(block_buffer_);
+
+                    block.data_ = first_block.data();
+                    block.size_ = first_block.size();
                 }
+
+                // Avoid flushing an empty buffer.
+                if (block.size_ > 0)
+                    blocks_.push_back(block);
+
+                cur = delim + 1;
             }
+
+            if (!blocks_.empty() && !invalid_inheritor_)
+                event_output_batch(blocks_);
         }
 
         /*unsigned long last_err = GetLastError();
@@ -230,6 +269,16 @@ namespace ckcore
         return false;
     }
 
+    void Process::event_output_batch(const std::vector<Block> &blocks)
+    {
+        std::string block;
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            block.assign(blocks[i].data_,blocks[i].size_);
+            event_output(block);
+        }
+    }
+
     unsigned long WINAPI Process::listen(void *param)
     {
         Process *process = static_cast<Process *>(param);
@@ -267,11 +316,21 @@ namespace ckcore
 
         process->close();
 
+        bool locked = WaitForSingleObject(process->mutex_,INFINITE) == WAIT_OBJECT_0;
+        std::vector<std::pair<tcallback,void *> > callbacks;
+        callbacks.swap(process->finish_callbacks_);
+        if (locked)
+            ReleaseMutex(process->mutex_);
+
         ReleaseMutex(process->mutex_exec_);
 
         // Notify that the process has finished.
         if (!process->invalid_inheritor_)
             process->event_finished();
+
+        for (size_t i = 0; i < callbacks.size(); i++)
+            callbacks[i].first(callbacks[i].second);
+
         return 0;
     }
 
@@ -450,14 +509,30 @@ namespace ckcore
 
     void Process::add_block_delim(char delim)
     {
-        block_delims_.insert(delim);
+        unsigned char c = static_cast<unsigned char>(delim);
+        if (delim_table_[c])
+            return;
+
+        delim_table_[c] = true;
+        if (++delim_count_ == 1)
+            single_delim_ = delim;
     }
 
     void Process::remove_block_delim(char delim)
     {
-        std::set<char>::iterator it = block_delims_.find(delim);
-        if (it != block_delims_.end())
-            block_delims_.erase(it);
+        unsigned char c = static_cast<unsigned char>(delim);
+        if (!delim_table_[c])
+            return;
+
+        delim_table_[c] = false;
+        if (--delim_count_ == 1)
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                if (delim_table_[i])
+                    single_delim_ = static_cast<char>(i);
+            }
+        }
     }
 
     tint64 Process::write(const void *buffer,tuint32 count)
@@ -472,6 +547,78 @@ namespace ckcore
         return written;
     }
 
+    tint64 Process::feed(InStream &in)
+    {
+        PooledBuffer buffer(FEED_BUFFER_SIZE);
+        if (buffer.data() == NULL)
+            return -1;
+
+        tint64 total = 0;
+        while (!in.end())
+        {
+            tint64 res = in.read(buffer.data(),FEED_BUFFER_SIZE);
+            if (res < 0)
+                return -1;
+
+            if (res == 0)
+                break;
+
+            for (tint64 written = 0; written < res;)
+            {
+                tint64 cur = write(buffer.data() + written,
+                                   static_cast<tuint32>(res - written));
+                if (cur <= 0)
+                    return -1;
+
+                written += cur;
+            }
+
+            total += res;
+        }
+
+        return total;
+    }
+
+    tint64 Process::feed(File &file)
+    {
+        PooledBuffer buffer(FEED_BUFFER_SIZE);
+        if (buffer.data() == NULL)
+            return -1;
+
+        tint64 total = 0;
+        while (true)
+        {
+            tint64 res = file.read(buffer.data(),FEED_BUFFER_SIZE);
+            if (res < 0)
+                return -1;
+
+            if (res == 0)
+                return total;
+
+            for (tint64 written = 0; written < res;)
+            {
+                tint64 cur = write(buffer.data() + written,
+                                   static_cast<tuint32>(res - written));
+                if (cur <= 0)
+                    return -1;
+
+                written += cur;
+            }
+
+            total += res;
+        }
+    }
+
+    bool Process::close_input()
+    {
+        if (pipe_stdin_ == NULL)
+            return false;
+
+        ckVERIFY(0 != CloseHandle(pipe_stdin_));
+        pipe_stdin_ = NULL;
+        return true;
+    }
+
     bool Process::exit_code(ckcore::tuint32 &exit_code) const
     {
         if (running())
@@ -480,4 +627,28 @@ namespace ckcore
         exit_code = exit_code_;
         return true;
     }
+
+    bool Process::usage(Usage &usage) const
+    {
+        if (running())
+            return false;
+
+        usage = usage_;
+        return true;
+    }
+
+    bool Process::notify_finished(tcallback callback,void *param)
+    {
+        if (callback == NULL)
+            return false;
+
+        bool locked = WaitForSingleObject(mutex_,INFINITE) == WAIT_OBJECT_0;
+        bool running = state_ == STATE_RUNNING;
+        if (running)
+            finish_callbacks_.push_back(std::make_pair(callback,param));
+        if (locked)
+            ReleaseMutex(mutex_);
+
+        return running;
+    }
 };
@@ -20,12 +20,13 @@
 #include <memory>
 #include "ckcore/assert.hh"
 #include "ckcore/locker.hh"
+#include "ckcore/lockprofiler.hh"
 #include "ckcore/thread.hh"
 
 namespace ckcore
 {
     Thread::Thread()
-        : thread_(NULL),start_event_(NULL),running_(false)
+        : thread_(NULL),start_event_(NULL),running_(false),mutex_("Thread")
     {
         start_event_ = CreateEvent(NULL,false,false,NULL);
     }
@@ -66,18 +67,65 @@ namespace ckcore
     }
 
     bool Thread::start()
+    {
+        return start(ThreadAttributes());
+    }
+
+    bool Thread::start(const ThreadAttributes &attr)
     {
         Locker<thread::Mutex> lock(mutex_);
 
         if (running_)
             return false;
 
-        // Create the thread.
+        // Create the thread suspended so that the attributes are applied
+        // before it starts executing.
         unsigned long thread_id = 0;
-        thread_ = CreateThread(NULL,0,native_thread,this,0,&thread_id);
+        thread_ = CreateThread(NULL,attr.stack_size,native_thread,this,
+                               CREATE_SUSPENDED | (attr.stack_size > 0 ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0),
+                               &thread_id);
         if (thread_ == NULL)
             return false;
 
+        DWORD_PTR affinity_mask = 0;
+        std::vector<tuint32>::const_iterator it;
+        for (it = attr.cpu_affinity.begin(); it != attr.cpu_affinity.end(); it++)
+        {
+            if (*it < sizeof(DWORD_PTR) * 8)
+                affinity_mask |= static_cast<DWORD_PTR>(1) << *it;
+        }
+
+        if (affinity_mask == 0 && attr.numa_node >= 0)
+        {
+            ULONGLONG node_mask = 0;
+            if (GetNumaNodeProcessorMask(static_cast<UCHAR>(attr.numa_node),&node_mask))
+                affinity_mask = static_cast<DWORD_PTR>(node_mask);
+        }
+
+        if (affinity_mask != 0)
+            SetThreadAffinityMask(thread_,affinity_mask);
+
+        switch (attr.sched_policy)
+        {
+            case ThreadAttributes::ckSCHED_BATCH:
+                SetThreadPriority(thread_,THREAD_PRIORITY_BELOW_NORMAL);
+                break;
+            case ThreadAttributes::ckSCHED_IDLE:
+                SetThreadPriority(thread_,THREAD_PRIORITY_IDLE);
+                break;
+            case ThreadAttributes::ckSCHED_FIFO:
+                SetThreadPriority(thread_,THREAD_PRIORITY_TIME_CRITICAL);
+                break;
+            case ThreadAttributes::ckSCHED_RR:
+                SetThreadPriority(thread_,THREAD_PRIORITY_HIGHEST);
+                break;
+            default:
+                break;
+        }
+
+        // Thread names are not supported on this platform.
+        ResumeThread(thread_);
+
         // Wait for the thread to start before returning.
         if (WaitForSingleObject(start_event_,INFINITE) == WAIT_FAILED)
             Sleep(200);
@@ -191,7 +239,13 @@ namespace ckcore
             return (thandle)static_cast<tuint64>(GetCurrentThreadId());
         }
 
-        Mutex::Mutex() : handle_(CreateMutex(NULL,FALSE,NULL))
+        Mutex::Mutex() : handle_(CreateMutex(NULL,FALSE,NULL)),
+            profile_(NULL),acquired_(0)
+        {
+        }
+
+        Mutex::Mutex(const char *name) : handle_(CreateMutex(NULL,FALSE,NULL)),
+            profile_(LockProfiler::profile(name)),acquired_(0)
         {
         }
 
@@ -209,8 +263,20 @@ namespace ckcore
             if (handle_ == NULL)
                 return false;
 
+            if (profile_ != NULL && WaitForSingleObject(handle_,0) == WAIT_OBJECT_0)
+            {
+                profile_->acquired(acquired_,false);
+                return true;
+            }
+
+            tuint64 wait_start = profile_ != NULL ? profile_->start_wait() : 0;
+
             bool res = WaitForSingleObject(handle_,INFINITE) == WAIT_OBJECT_0;
             ckTRACE_IF(!res,"waiting for thread mutex failed, last error %d\n",GetLastError());
+
+            if (res && profile_ != NULL)
+                profile_->acquired(acquired_,true,wait_start);
+
             return res;
         }
 
@@ -219,6 +285,9 @@ namespace ckcore
             if (handle_ == NULL)
                 return false;
 
+            if (profile_ != NULL)
+                profile_->released(acquired_);
+
             bool res = ReleaseMutex(handle_) != 0;
             ckTRACE_IF(!res,"releasing thread mutex failed, last error %d\n",GetLastError());
             return res;
@@ -226,7 +295,13 @@ namespace ckcore
 
         bool Mutex::try_lock()
         {
-            return WaitForSingleObject(handle_,0) == WAIT_OBJECT_0;
+            if (WaitForSingleObject(handle_,0) != WAIT_OBJECT_0)
+                return false;
+
+            if (profile_ != NULL)
+                profile_->acquired(acquired_,false);
+
+            return true;
         }
 
         WaitCondition::WaitCondition()
@@ -262,6 +337,9 @@ namespace ckcore
             waiters_++;
             LeaveCriticalSection(&critical_);
 
+            if (mutex.profile_ != NULL)
+                mutex.profile_->released(mutex.acquired_);
+
             // Release the mutex and wait on the semaphore which will be set
             // through signal_one or signal_all.
             if (SignalObjectAndWait(mutex.handle_,sema_,
@@ -285,7 +363,11 @@ namespace ckcore
             // If we're the last waiter thread during this particular broadcast
             // then let all the other threads proceed.
             if (last_waiter)
+            {
                 SignalObjectAndWait(waiters_done_,mutex.handle_,INFINITE,FALSE);
+                if (mutex.profile_ != NULL)
+                    mutex.profile_->acquired(mutex.acquired_,false);
+            }
             else
                 mutex.lock();   // The mutex must always be re-locked. 
 
@@ -331,5 +413,60 @@ namespace ckcore
                 LeaveCriticalSection(&critical_);
             }
         }
+
+        Event::Event(bool manual_reset)
+            : handle_(CreateEvent(NULL,manual_reset ? TRUE : FALSE,FALSE,NULL))
+        {
+        }
+
+        Event::~Event()
+        {
+            if (handle_ != NULL)
+            {
+                ckVERIFY(0 != CloseHandle(handle_));
+                handle_ = NULL;
+            }
+        }
+
+        void Event::set()
+        {
+            SetEvent(handle_);
+        }
+
+        void Event::reset()
+        {
+            ResetEvent(handle_);
+        }
+
+        bool Event::wait(tuint32 timeout)
+        {
+            return WaitForSingleObject(handle_,
+                timeout == std::numeric_limits<tuint32>::max() ? INFINITE : timeout) == WAIT_OBJECT_0;
+        }
+
+        Semaphore::Semaphore(tuint32 count)
+            : handle_(CreateSemaphore(NULL,count,0x7fffffff,NULL))
+        {
+        }
+
+        Semaphore::~Semaphore()
+        {
+            if (handle_ != NULL)
+            {
+                ckVERIFY(0 != CloseHandle(handle_));
+                handle_ = NULL;
+            }
+        }
+
+        bool Semaphore::wait(tuint32 timeout)
+        {
+            return WaitForSingleObject(handle_,
+                timeout == std::numeric_limits<tuint32>::max() ? INFINITE : timeout) == WAIT_OBJECT_0;
+        }
+
+        void Semaphore::release(tuint32 count)
+        {
+            ReleaseSemaphore(handle_,count,NULL);
+        }
     };
 };
@@ -0,0 +1,191 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cxxtest/TestSuite.h>
+#include <string.h>
+#include "ckcore/types.hh"
+#include "ckcore/async.hh"
+#include "ckcore/cancellation.hh"
+#include "ckcore/file.hh"
+#include "ckcore/locker.hh"
+#include "ckcore/memorystream.hh"
+#include "ckcore/process.hh"
+#include "ckcore/system.hh"
+
+#ifdef _WINDOWS
+#define SMALLCLIENT     ckT("bin/smallclient.exe")
+#else
+#define SMALLCLIENT     ckT("./bin/smallclient")
+#endif
+
+class TestCompletion : public ckcore::Completion
+{
+public:
+    ckcore::thread::Mutex mutex_;
+    ckcore::thread::WaitCondition cond_;
+    ckcore::tint64 result_;
+    bool done_;
+
+    TestCompletion() : result_(-2),done_(false)
+    {
+        set_auto_delete(false);
+    }
+
+    void completed(ckcore::tint64 result)
+    {
+        ckcore::Locker<ckcore::thread::Mutex> lock(mutex_);
+        result_ = result;
+        done_ = true;
+        cond_.signal_all();
+    }
+
+    bool wait(ckcore::tuint32 timeout = 5000)
+    {
+        ckcore::Locker<ckcore::thread::Mutex> lock(mutex_);
+        if (!done_)
+            cond_.wait(mutex_,timeout);
+
+        bool done = done_;
+        done_ = false;
+        return done;
+    }
+};
+
+class AsyncTestProcess : public ckcore::Process
+{
+public:
+    ~AsyncTestProcess()
+    {
+        invalid_inheritor_ = true;
+    }
+
+    void event_finished()
+    {
+    }
+
+    void event_output(const std::string &block)
+    {
+    }
+};
+
+class AsyncTestSuite : public CxxTest::TestSuite
+{
+public:
+    void testFile()
+    {
+        ckcore::File file = ckcore::File::temp(ckT("ckcore-test-async"));
+        TS_ASSERT(file.open(ckcore::File::ckOPEN_WRITE));
+
+        TestCompletion completion;
+        ckcore::ThreadPool tp(ckT("async"));
+
+        const char *data = "asynchronous";
+        TS_ASSERT(ckcore::async::write(file,data,12,&completion,tp));
+        TS_ASSERT(completion.wait());
+        TS_ASSERT_EQUALS(completion.result_,12);
+
+        file.close();
+        TS_ASSERT(file.open(ckcore::File::ckOPEN_READ));
+
+        char buffer[32];
+        memset(buffer,0,sizeof(buffer));
+        TS_ASSERT(ckcore::async::read(file,buffer,sizeof(buffer),&completion,tp));
+        TS_ASSERT(completion.wait());
+        TS_ASSERT_EQUALS(completion.result_,12);
+        TS_ASSERT_SAME_DATA(buffer,data,12);
+
+        // Cancelled operations should not execute.
+        ckcore::CancellationSource source;
+        completion.set_cancellation_token(source.token());
+        source.cancel();
+
+        TS_ASSERT_EQUALS(file.seek(0,ckcore::File::ckFILE_BEGIN),0);
+        memset(buffer,0,sizeof(buffer));
+        TS_ASSERT(ckcore::async::read(file,buffer,sizeof(buffer),&completion,tp));
+        TS_ASSERT(!completion.wait(200));
+        TS_ASSERT_EQUALS(buffer[0],0);
+
+        tp.wait();
+        file.close();
+        TS_ASSERT(file.remove());
+    }
+
+    void testStream()
+    {
+        TestCompletion completion;
+        ckcore::ThreadPool tp(ckT("async"));
+
+        const char *data = "asynchronous";
+        ckcore::MemoryOutStream out;
+        TS_ASSERT(ckcore::async::write(out,data,12,&completion,tp));
+        TS_ASSERT(completion.wait());
+        TS_ASSERT_EQUALS(completion.result_,12);
+        TS_ASSERT_SAME_DATA(out.data(),data,12);
+
+        ckcore::MemoryInStream in(out.data(),12);
+
+        char buffer[32];
+        memset(buffer,0,sizeof(buffer));
+        TS_ASSERT(ckcore::async::read(in,buffer,sizeof(buffer),&completion,tp));
+        TS_ASSERT(completion.wait());
+        TS_ASSERT_EQUALS(completion.result_,12);
+        TS_ASSERT_SAME_DATA(buffer,data,12);
+    }
+
+    void testProcess()
+    {
+        TestCompletion completion;
+        ckcore::ThreadPool tp(ckT("async"));
+
+        // The client waits for input before exiting, the completion must not
+        // execute until it has exited.
+        ckcore::tstring cmd_line = SMALLCLIENT;
+        cmd_line += ckT(" -m4");
+
+        AsyncTestProcess process;
+        TS_ASSERT(process.create(cmd_line.c_str()));
+        TS_ASSERT(ckcore::async::wait(process,&completion,tp));
+        TS_ASSERT(!completion.wait(200));
+
+        process.write((void *)"TEST 1\n",7);
+        TS_ASSERT(completion.wait());
+        TS_ASSERT_EQUALS(completion.result_,0);
+
+        // Waiting for a process that has already exited completes at once.
+        cmd_line = SMALLCLIENT;
+        cmd_line += ckT(" -m5");    // Cause the client to exit with code 42.
+
+        TS_ASSERT(process.create(cmd_line.c_str()));
+        process.wait();
+        TS_ASSERT(ckcore::async::wait(process,&completion,tp));
+        TS_ASSERT(completion.wait());
+        TS_ASSERT_EQUALS(completion.result_,42);
+    }
+
+    void testSleep()
+    {
+        TestCompletion completion;
+        ckcore::ThreadPool tp(ckT("async"));
+
+        ckcore::tuint64 start = ckcore::system::time();
+        TS_ASSERT(ckcore::async::sleep(100,&completion,tp));
+        TS_ASSERT(completion.wait());
+        TS_ASSERT_EQUALS(completion.result_,0);
+        TS_ASSERT(ckcore::system::time() - start >= 100);
+    }
+};
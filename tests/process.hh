@@ -16,10 +16,25 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#include <algorithm>
 #include <queue>
+#include <sstream>
+#include <vector>
 #include <cxxtest/TestSuite.h>
 #include "ckcore/types.hh"
+#include "ckcore/file.hh"
+#include "ckcore/memorystream.hh"
 #include "ckcore/process.hh"
+#ifdef _UNIX
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "ckcore/processpipeline.hh"
+#include "ckcore/processpool.hh"
+#include "ckcore/sharedmemorystream.hh"
+#endif
+#include "ckcore/threadpool.hh"
 
 #ifdef _WINDOWS
 #define SMALLCLIENT     ckT("bin/smallclient.exe")
@@ -69,6 +84,134 @@ public:
     }
 };
 
+class WaitingProcessWrapper : public ProcessWrapper
+{
+public:
+    ckcore::Process *other_;
+    bool waited_;
+    bool deleted_;
+
+    WaitingProcessWrapper(ckcore::Process *other) : other_(other),
+        waited_(true),deleted_(false)
+    {
+    }
+
+    void event_finished()
+    {
+        // Both are called on the reactor thread and must not block.
+        waited_ = other_->wait();
+        if (waited_)
+            return;
+
+        delete other_;
+        deleted_ = true;
+
+        ProcessWrapper::event_finished();
+    }
+};
+
+class BatchProcessWrapper : public ProcessWrapper
+{
+public:
+    std::vector<std::string> blocks_;
+    unsigned int batches_;
+
+    BatchProcessWrapper() : batches_(0)
+    {
+    }
+
+    void event_output_batch(const std::vector<Block> &blocks)
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+            blocks_.push_back(std::string(blocks[i].data_,blocks[i].size_));
+
+        batches_++;
+    }
+};
+
+#ifdef _UNIX
+class PipelineWrapper : public ckcore::ProcessPipeline
+{
+public:
+    std::vector<std::string> blocks_;
+    bool finished_;
+
+    PipelineWrapper() : finished_(false)
+    {
+    }
+
+    ~PipelineWrapper()
+    {
+        invalid_inheritor_ = true;
+    }
+
+    void event_finished()
+    {
+        finished_ = true;
+    }
+
+    void event_output(const std::string &block)
+    {
+        blocks_.push_back(block);
+    }
+};
+
+class EchoJob : public ckcore::ProcessPool::Job
+{
+public:
+    std::string request_;
+    std::string response_;
+    bool success_;
+    bool finished_;
+
+    EchoJob(const std::string &request) : request_(request),success_(false),
+        finished_(false)
+    {
+        set_auto_delete(false);
+    }
+
+    void request(std::string &request)
+    {
+        request = request_;
+    }
+
+    void event_finished(bool success,const std::string &response)
+    {
+        success_ = success;
+        response_ = response;
+        finished_ = true;
+    }
+};
+
+class OrderedJob : public EchoJob
+{
+public:
+    std::vector<std::string> &order_;
+    ckcore::thread::Event *gate_;
+
+    OrderedJob(const std::string &request,std::vector<std::string> &order,
+               ckcore::thread::Event *gate = NULL) : EchoJob(request),
+        order_(order),gate_(gate)
+    {
+    }
+
+    void request(std::string &request)
+    {
+        // Keep the helper busy until the other jobs have been queued.
+        if (gate_ != NULL)
+            gate_->wait();
+
+        EchoJob::request(request);
+    }
+
+    void event_finished(bool success,const std::string &response)
+    {
+        order_.push_back(request_);
+        EchoJob::event_finished(success,response);
+    }
+};
+#endif
+
 class ProcessTestSuite : public CxxTest::TestSuite
 {
 public:
@@ -155,6 +298,53 @@ public:
         TS_ASSERT(!process.finished());
     }
 
+    void testReuse()
+    {
+        ProcessWrapper process;
+
+        ckcore::tstring cmd_line = SMALLCLIENT;
+        cmd_line += ckT(" -m10");   // Cause the client to exit without a final line break.
+
+        TS_ASSERT(process.create(cmd_line.c_str()));
+        process.wait();
+        TS_ASSERT(process.finished());
+        TS_ASSERT_SAME_DATA(process.next().c_str(),"SmallClient",12);
+
+        // The unterminated output must not leak into the next run.
+        TS_ASSERT(process.create(SMALLCLIENT));
+        process.wait();
+        TS_ASSERT_SAME_DATA(process.next().c_str(),"SmallClient",12);
+        TS_ASSERT_SAME_DATA(process.next().c_str(),"MESSAGE 1",9);
+        TS_ASSERT_EQUALS(process.next(),std::string());
+    }
+
+    void testEventWait()
+    {
+        // The client waits for input and keeps running until its standard
+        // input is closed.
+        ckcore::tstring other_cmd_line = SMALLCLIENT;
+        other_cmd_line += ckT(" -m4");
+
+        ProcessWrapper *other = new ProcessWrapper();
+        TS_ASSERT(other->create(other_cmd_line.c_str()));
+
+        // Waiting for and destroying the running process from an event
+        // function must not deadlock the reactor thread.
+        WaitingProcessWrapper process(other);
+        TS_ASSERT(process.create(SMALLCLIENT));
+        process.wait();
+        TS_ASSERT(process.finished());
+        TS_ASSERT(!process.waited_);
+        TS_ASSERT(process.deleted_);
+
+        // The reactor must still deliver events.
+        ProcessWrapper next;
+        TS_ASSERT(next.create(SMALLCLIENT));
+        next.wait();
+        TS_ASSERT(next.finished());
+        TS_ASSERT_SAME_DATA(next.next().c_str(),"SmallClient",12);
+    }
+
     void testWrite()
     {
         ProcessWrapper process;
@@ -192,6 +382,399 @@ public:
         TS_ASSERT_SAME_DATA(process.next().c_str(),"E 1",3);
     }
 
+    void testOutputBatch()
+    {
+        BatchProcessWrapper process;
+
+        // With a single delimiter the output is scanned using memchr.
+        process.remove_block_delim('\r');
+
+        ckcore::tstring cmd_line = SMALLCLIENT;
+        TS_ASSERT(process.create(cmd_line.c_str()));
+        process.wait();
+        TS_ASSERT(process.finished());
+
+        // The second block is split over two reads.
+        TS_ASSERT(process.batches_ >= 2);
+        TS_ASSERT_EQUALS(process.blocks_.size(),size_t(2));
+        if (process.blocks_.size() == 2)
+        {
+            TS_ASSERT_EQUALS(process.blocks_[0],std::string("SmallClient"));
+            TS_ASSERT_EQUALS(process.blocks_[1],std::string("MESSAGE 1"));
+        }
+
+        // Nothing should have been delivered through event_output.
+        TS_ASSERT_EQUALS(process.next(),std::string(""));
+    }
+
+    void testRawOutput()
+    {
+#ifdef _UNIX
+        ProcessWrapper process;
+        process.set_raw_output(true);
+
+        ckcore::tstring cmd_line = SMALLCLIENT;
+        TS_ASSERT(process.create(cmd_line.c_str()));
+
+        ckcore::MemoryOutStream out;
+        TS_ASSERT(ckcore::stream::copy(process.output_stream(),out));
+        TS_ASSERT(process.output_stream().end());
+
+        process.wait();
+        TS_ASSERT(process.finished());
+
+        // The output is delivered unmodified and not through the events.
+        const char *expected = "SmallClient\nMESSAGE 1\n";
+        TS_ASSERT_EQUALS(out.count(),ckcore::tuint32(strlen(expected)));
+        TS_ASSERT_SAME_DATA(out.data(),expected,strlen(expected));
+        TS_ASSERT_EQUALS(process.next(),std::string(""));
+#endif
+    }
+
+    void testFeed()
+    {
+#ifdef _UNIX
+        const ckcore::tuint32 size = 3 * 1024 * 1024 + 123;
+
+        std::vector<unsigned char> data(size);
+        unsigned long sum = 0;
+        for (ckcore::tuint32 i = 0; i < size; i++)
+        {
+            data[i] = static_cast<unsigned char>((i * 7) ^ (i >> 11));
+            sum += data[i];
+        }
+
+        std::ostringstream expected;
+        expected << "READ " << size << " " << sum;
+
+        // Feed from a stream.
+        ProcessWrapper process;
+
+        ckcore::tstring cmd_line = SMALLCLIENT;
+        cmd_line += ckT(" -m6");    // Cause the client to count the input.
+
+        TS_ASSERT(process.create(cmd_line.c_str()));
+
+        ckcore::MemoryInStream in(&data[0],size);
+        TS_ASSERT_EQUALS(process.feed(in),ckcore::tint64(size));
+        TS_ASSERT(process.close_input());
+        TS_ASSERT(!process.close_input());
+        process.wait();
+
+        TS_ASSERT_EQUALS(process.next(),std::string("SmallClient"));
+        TS_ASSERT_EQUALS(process.next(),expected.str());
+
+        // Feed from a file.
+        ckcore::File file = ckcore::File::temp(ckT("ckcore-test-process"));
+        TS_ASSERT(file.open(ckcore::File::ckOPEN_WRITE));
+        TS_ASSERT_EQUALS(file.write(&data[0],size),ckcore::tint64(size));
+        file.close();
+
+        TS_ASSERT(file.open(ckcore::File::ckOPEN_READ));
+        TS_ASSERT(process.create(cmd_line.c_str()));
+        TS_ASSERT_EQUALS(process.feed(file),ckcore::tint64(size));
+        TS_ASSERT(process.close_input());
+        process.wait();
+
+        TS_ASSERT_EQUALS(process.next(),std::string("SmallClient"));
+        TS_ASSERT_EQUALS(process.next(),expected.str());
+
+        file.close();
+        TS_ASSERT(file.remove());
+#endif
+    }
+
+    void testPipeline()
+    {
+#ifdef _UNIX
+        PipelineWrapper pipeline;
+
+        // The first client writes "SmallClient\nMESSAGE 1\n" to standard
+        // output and "MESSAGE 2\n" to standard error.
+        std::vector<ckcore::tstring> cmd_lines;
+        cmd_lines.push_back(ckcore::tstring(SMALLCLIENT) + ckT(" -m2"));
+        cmd_lines.push_back(ckcore::tstring(SMALLCLIENT) + ckT(" -m6"));
+        cmd_lines.push_back(ckcore::tstring(SMALLCLIENT) + ckT(" -m5"));
+
+        TS_ASSERT(!pipeline.create(std::vector<ckcore::tstring>()));
+
+        // The last process doesn't read its input.
+        cmd_lines.pop_back();
+        TS_ASSERT(pipeline.create(cmd_lines));
+        TS_ASSERT_EQUALS(pipeline.size(),size_t(2));
+        pipeline.wait();
+        TS_ASSERT(pipeline.finished_);
+        TS_ASSERT(!pipeline.running());
+
+        // Only the output of the last process and all errors are reported,
+        // the relative order is undefined.
+        std::sort(pipeline.blocks_.begin(),pipeline.blocks_.end());
+        TS_ASSERT_EQUALS(pipeline.blocks_.size(),size_t(3));
+        if (pipeline.blocks_.size() == 3)
+        {
+            std::ostringstream expected;
+            expected << "READ 22 " << 1730;
+
+            TS_ASSERT_EQUALS(pipeline.blocks_[0],std::string("MESSAGE 2"));
+            TS_ASSERT_EQUALS(pipeline.blocks_[1],expected.str());
+            TS_ASSERT_EQUALS(pipeline.blocks_[2],std::string("SmallClient"));
+        }
+
+        ckcore::tuint32 exit_code = -1;
+        TS_ASSERT(pipeline.exit_code(exit_code));
+        TS_ASSERT_EQUALS(exit_code,ckcore::tuint32(0));
+
+        // The exit code of the pipeline is the one of the last process.
+        cmd_lines.push_back(ckcore::tstring(SMALLCLIENT) + ckT(" -m5"));
+        pipeline.finished_ = false;
+        TS_ASSERT(pipeline.create(cmd_lines));
+        TS_ASSERT_EQUALS(pipeline.size(),size_t(3));
+        pipeline.wait();
+        TS_ASSERT(pipeline.finished_);
+
+        TS_ASSERT(pipeline.exit_code(exit_code));
+        TS_ASSERT_EQUALS(exit_code,ckcore::tuint32(42));
+        TS_ASSERT(pipeline.exit_code(0,exit_code));
+        TS_ASSERT_EQUALS(exit_code,ckcore::tuint32(0));
+#endif
+    }
+
+    void testProcessPool()
+    {
+#ifdef _UNIX
+        ckcore::ThreadPool thread_pool(ckT("ProcessPoolTest"),2);
+
+        // Each helper answers at most three jobs before being replaced.
+        ckcore::tstring cmd_line = SMALLCLIENT;
+        cmd_line += ckT(" -m8");    // Cause the client to answer framed requests.
+
+        ckcore::ProcessPool pool(cmd_line.c_str(),2,3,thread_pool);
+        TS_ASSERT_EQUALS(pool.size(),ckcore::tuint32(2));
+        TS_ASSERT(pool.create());
+
+        std::vector<EchoJob *> jobs;
+        for (int i = 0; i < 10; i++)
+        {
+            std::ostringstream request;
+            request << "JOB " << i;
+
+            jobs.push_back(new EchoJob(request.str()));
+            TS_ASSERT(pool.start(jobs.back(),static_cast<ckcore::tuint32>(i)));
+        }
+
+        // Empty requests are valid.
+        jobs.push_back(new EchoJob(""));
+        TS_ASSERT(pool.start(jobs.back()));
+
+        pool.wait();
+        TS_ASSERT_EQUALS(pool.queued(),ckcore::tuint32(0));
+
+        std::vector<std::string> pids;
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            TS_ASSERT(jobs[i]->finished_);
+            TS_ASSERT(jobs[i]->success_);
+
+            std::string::size_type pos = jobs[i]->response_.rfind(' ');
+            TS_ASSERT(pos != std::string::npos);
+            if (pos != std::string::npos)
+            {
+                TS_ASSERT_EQUALS(jobs[i]->response_.substr(0,pos),jobs[i]->request_);
+                pids.push_back(jobs[i]->response_.substr(pos + 1));
+            }
+
+            delete jobs[i];
+        }
+
+        // Eleven jobs require at least four helper instances.
+        std::sort(pids.begin(),pids.end());
+        pids.erase(std::unique(pids.begin(),pids.end()),pids.end());
+        TS_ASSERT(pids.size() >= 4);
+
+        // Higher priority jobs should pass queued default priority jobs,
+        // which should keep their order.
+        std::vector<std::string> order;
+        ckcore::thread::Event gate;
+        ckcore::ProcessPool ordered_pool(cmd_line.c_str(),1,0,thread_pool);
+
+        OrderedJob first("FIRST",order,&gate);
+        OrderedJob second("SECOND",order);
+        OrderedJob third("THIRD",order);
+        OrderedJob urgent("URGENT",order);
+        TS_ASSERT(ordered_pool.start(&first));
+        TS_ASSERT(ordered_pool.start(&second));
+        TS_ASSERT(ordered_pool.start(&third));
+        TS_ASSERT(ordered_pool.start(&urgent,1));
+        TS_ASSERT_EQUALS(ordered_pool.queued(),ckcore::tuint32(3));
+
+        gate.set();
+        ordered_pool.wait();
+        TS_ASSERT_EQUALS(order.size(),size_t(4));
+        if (order.size() == 4)
+        {
+            TS_ASSERT_EQUALS(order[0],"FIRST");
+            TS_ASSERT_EQUALS(order[1],"URGENT");
+            TS_ASSERT_EQUALS(order[2],"SECOND");
+            TS_ASSERT_EQUALS(order[3],"THIRD");
+        }
+
+        // Jobs should fail if the helper can't be started.
+        ckcore::ProcessPool bad_pool(ckT("/nonexistent/helper"),1,0,thread_pool);
+        TS_ASSERT(!bad_pool.create());
+
+        EchoJob job("JOB");
+        TS_ASSERT(bad_pool.start(&job));
+        bad_pool.wait();
+        TS_ASSERT(job.finished_);
+        TS_ASSERT(!job.success_);
+
+        // A helper that doesn't follow the protocol should fail the job.
+        cmd_line = SMALLCLIENT;
+        cmd_line += ckT(" -m5");    // Cause the client to exit immediately.
+
+        ckcore::ProcessPool exiting_pool(cmd_line.c_str(),1,0,thread_pool);
+        job.finished_ = false;
+        job.success_ = true;
+        TS_ASSERT(exiting_pool.start(&job));
+        exiting_pool.wait();
+        TS_ASSERT(job.finished_);
+        TS_ASSERT(!job.success_);
+#endif
+    }
+
+    void testSharedMemory()
+    {
+#ifdef _UNIX
+        ckcore::SharedMemoryOutStream out(4096);
+        TS_ASSERT(out.create());
+        TS_ASSERT_EQUALS(out.capacity(),ckcore::tuint32(4096));
+
+        // Pass the ring to the client through an inherited descriptor.
+        std::ostringstream cmd_line;
+        cmd_line << SMALLCLIENT << " -m9 " << out.handle();
+
+        ProcessWrapper process;
+        process.add_inherited_fd(out.handle());
+        TS_ASSERT(process.create(cmd_line.str().c_str()));
+        out.close_handle();
+        TS_ASSERT_EQUALS(out.handle(),-1);
+
+        unsigned char buffer[1000];
+        for (size_t i = 0; i < sizeof(buffer); i++)
+            buffer[i] = static_cast<unsigned char>(i % 251);
+
+        // Write more than fits in the ring, alternating between the stream
+        // interface and writing directly into the ring.
+        unsigned long count = 0,sum = 0;
+        for (int i = 0; i < 1000; i++)
+        {
+            ckcore::tuint32 written = sizeof(buffer);
+            if (i % 2 == 0)
+            {
+                TS_ASSERT_EQUALS(out.write(buffer,written),ckcore::tint64(written));
+            }
+            else
+            {
+                unsigned char *space = out.reserve(written);
+                TS_ASSERT(space != NULL);
+                if (space == NULL)
+                    break;
+
+                memcpy(space,buffer,written);
+                out.commit(written);
+            }
+
+            for (ckcore::tuint32 j = 0; j < written; j++)
+                sum += buffer[j];
+            count += written;
+        }
+
+        out.close();
+        process.wait();
+
+        std::ostringstream expected;
+        expected << "READ " << count << " " << sum;
+
+        TS_ASSERT_EQUALS(process.next(),"SmallClient");
+        TS_ASSERT_EQUALS(process.next(),expected.str());
+
+        // Closing the reading end should make the writer fail.
+        ckcore::SharedMemoryOutStream out2(16);
+        TS_ASSERT(out2.create());
+
+        ckcore::SharedMemoryInStream in;
+        TS_ASSERT(!in.open(-1));
+        TS_ASSERT(in.open(dup(out2.handle())));
+        TS_ASSERT_EQUALS(out2.write(buffer,16),16);
+        TS_ASSERT(in.seek(8,ckcore::InStream::ckSTREAM_CURRENT));
+        TS_ASSERT_EQUALS(in.read(buffer,sizeof(buffer)),8);
+        in.close();
+        TS_ASSERT_EQUALS(out2.write(buffer,32),-1);
+#endif
+    }
+
+    void testSharedMemoryPeerLost()
+    {
+#ifdef _UNIX
+        unsigned char buffer[8192];
+        memset(buffer,0x5a,sizeof(buffer));
+
+        // A reader exiting without closing the stream must make the writer
+        // fail rather than block forever.
+        ckcore::SharedMemoryOutStream out(4096);
+        TS_ASSERT(out.create());
+
+        std::ostringstream cmd_line;
+        cmd_line << SMALLCLIENT << " -m5 " << out.handle();
+
+        ProcessWrapper process;
+        process.add_inherited_fd(out.handle());
+        TS_ASSERT(process.create(cmd_line.str().c_str()));
+        out.close_handle();
+        process.wait();
+
+        TS_ASSERT_EQUALS(out.write(buffer,sizeof(buffer)),4096);
+        TS_ASSERT_EQUALS(out.write(buffer,sizeof(buffer)),-1);
+
+        // A writer exiting without closing the ring must make the reader fail
+        // once all data has been read.
+        ckcore::SharedMemoryRing ring;
+        TS_ASSERT(ring.create(4096));
+
+        ckcore::SharedMemoryInStream in;
+        TS_ASSERT(in.open(dup(ring.handle())));
+        ring.close_handle();
+
+        pid_t pid = fork();
+        TS_ASSERT(pid != -1);
+        if (pid == 0)
+        {
+            ckcore::tuint32 pos = 0;
+            if (ring.wait_space(pos) >= 100)
+            {
+                memcpy(ring.buffer() + pos,buffer,100);
+                ring.commit(100);
+            }
+
+            _exit(0);
+        }
+
+        // Unmap the ring without marking the writing end as closed.
+        ring.close();
+
+        int status = 0;
+        TS_ASSERT_EQUALS(waitpid(pid,&status,0),pid);
+
+        // The data written before exiting is still delivered but the transfer
+        // must not look complete.
+        ckcore::MemoryOutStream received;
+        TS_ASSERT(!ckcore::stream::copy(in,received));
+        TS_ASSERT_EQUALS(received.count(),ckcore::tuint32(100));
+        TS_ASSERT(!in.end());
+        TS_ASSERT_EQUALS(in.read(buffer,sizeof(buffer)),-1);
+#endif
+    }
+
     void testExitCode()
     {
         ProcessWrapper process;
@@ -227,4 +810,95 @@ public:
         TS_ASSERT(process.exit_code(exit_code));
         TS_ASSERT_EQUALS(exit_code,ckcore::tuint32(0));
     }
+
+    void testForkLauncher()
+    {
+#ifdef _UNIX
+        ProcessWrapper process;
+        process.set_launcher(ckcore::Process::LAUNCHER_FORK);
+
+        ckcore::tstring cmd_line = SMALLCLIENT;
+        cmd_line += ckT(" -m5");    // Cause the client to return 42 instead of zero.
+
+        TS_ASSERT(process.create(cmd_line.c_str()));
+        process.wait();
+        TS_ASSERT(process.finished());
+
+        ckcore::tuint32 exit_code = -1;
+        TS_ASSERT(process.exit_code(exit_code));
+        TS_ASSERT_EQUALS(exit_code,ckcore::tuint32(42));
+#endif
+    }
+
+    void testUsage()
+    {
+        ProcessWrapper process;
+        ckcore::Process::Usage usage;
+
+        // The usage is not available while running.
+        ckcore::tstring cmd_line = SMALLCLIENT;
+        cmd_line += ckT(" -m3");    // Cause the client to sleep for 30 seconds.
+
+        TS_ASSERT(process.create(cmd_line.c_str()));
+        TS_ASSERT(!process.usage(usage));
+        TS_ASSERT(process.kill());
+        process.wait();
+
+        TS_ASSERT(process.usage(usage));
+
+        // A completed run should report its peak memory usage.
+        cmd_line = SMALLCLIENT;
+        TS_ASSERT(process.create(cmd_line.c_str()));
+        process.wait();
+        TS_ASSERT(process.finished());
+
+        TS_ASSERT(process.usage(usage));
+        TS_ASSERT(usage.max_rss_ > 0);
+#ifdef _UNIX
+        TS_ASSERT(usage.voluntary_switches_ > 0);   // The client sleeps.
+#endif
+    }
+
+#ifdef _UNIX
+    void testOptions()
+    {
+        ProcessWrapper process;
+        process.set_nice(19);
+        process.set_limit(RLIMIT_NOFILE,64,64);
+
+        std::vector<unsigned int> cpus;
+        cpus.push_back(0);
+        process.set_affinity(cpus);
+        process.set_io_priority(ckcore::Process::IO_CLASS_IDLE);
+
+        ckcore::tstring cmd_line = SMALLCLIENT;
+        cmd_line += ckT(" -m7");    // Cause the client to print its options.
+
+        // Both launchers should apply the options.
+        for (int i = 0; i < 2; i++)
+        {
+            process.set_launcher(i == 0 ? ckcore::Process::LAUNCHER_SPAWN :
+                                          ckcore::Process::LAUNCHER_FORK);
+
+            TS_ASSERT(process.create(cmd_line.c_str()));
+            process.wait();
+
+            TS_ASSERT_EQUALS(process.next(),"SmallClient");
+            TS_ASSERT_EQUALS(process.next(),"NICE 19 FILES 64");
+        }
+
+        // Without options the client should inherit the limits.
+        process.clear_options();
+        TS_ASSERT(process.create(cmd_line.c_str()));
+        process.wait();
+
+        TS_ASSERT_EQUALS(process.next(),"SmallClient");
+        TS_ASSERT(process.next() != "NICE 19 FILES 64");
+
+        // Processes should fail to start if a limit can't be applied.
+        process.set_launcher(ckcore::Process::LAUNCHER_SPAWN);
+        process.set_limit(RLIMIT_NOFILE,64,32);
+        TS_ASSERT(!process.create(cmd_line.c_str()));
+    }
+#endif
 };
@@ -0,0 +1,218 @@
+/*
+ * The ckCore library provides core software functionality.
+ * Copyright (C) 2006-2012 Christian Kindahl
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cxxtest/TestSuite.h>
+#include "ckcore/types.hh"
+#include "ckcore/mpmcqueue.hh"
+#include "ckcore/spscring.hh"
+#include "ckcore/thread.hh"
+
+#define QUEUE_TEST_ITEMS    100000
+
+typedef ckcore::SpscRing<ckcore::tuint32,64> TestRing;
+typedef ckcore::MpmcQueue<ckcore::tuint32> TestQueue;
+
+/**
+ * @brief Test thread producing items into a ring.
+ */
+class TestRingProducer : public ckcore::Thread
+{
+private:
+    TestRing &ring_;
+
+    void run()
+    {
+        ckcore::tuint32 items[16];
+        ckcore::tuint32 next = 0;
+        while (next < QUEUE_TEST_ITEMS)
+        {
+            ckcore::tuint32 count = 0;
+            while (count < 16 && next + count < QUEUE_TEST_ITEMS)
+            {
+                items[count] = next + count;
+                count++;
+            }
+
+            next += ring_.push(items,count);
+        }
+    }
+
+public:
+    TestRingProducer(TestRing &ring) : ring_(ring) {}
+};
+
+/**
+ * @brief Test thread producing items into a queue.
+ */
+class TestQueueProducer : public ckcore::Thread
+{
+private:
+    TestQueue &queue_;
+    ckcore::tuint32 first_;
+
+    void run()
+    {
+        for (ckcore::tuint32 i = 0; i < QUEUE_TEST_ITEMS; i++)
+        {
+            while (!queue_.push(first_ + i))
+                ;
+        }
+    }
+
+public:
+    TestQueueProducer(TestQueue &queue,ckcore::tuint32 first) :
+        queue_(queue),first_(first) {}
+};
+
+/**
+ * @brief Test thread consuming items from a queue.
+ */
+class TestQueueConsumer : public ckcore::Thread
+{
+private:
+    TestQueue &queue_;
+    volatile ckcore::tint32 &remaining_;
+
+    void run()
+    {
+        ckcore::tuint32 items[8];
+        while (ckcore::atomic::load(remaining_) > 0)
+        {
+            ckcore::tuint32 count = queue_.pop(items,8);
+            for (ckcore::tuint32 i = 0; i < count; i++)
+                sum_ += items[i];
+
+            ckcore::atomic::add(remaining_,-static_cast<ckcore::tint32>(count));
+        }
+    }
+
+public:
+    ckcore::tuint64 sum_;
+
+    TestQueueConsumer(TestQueue &queue,volatile ckcore::tint32 &remaining) :
+        queue_(queue),remaining_(remaining),sum_(0) {}
+};
+
+class QueueTestSuite : public CxxTest::TestSuite
+{
+public:
+    void testSpscRing()
+    {
+        TestRing ring;
+        TS_ASSERT(ring.empty());
+        TS_ASSERT_EQUALS(ring.capacity(),64U);
+
+        for (ckcore::tuint32 i = 0; i < 64; i++)
+            TS_ASSERT(ring.push(i));
+        TS_ASSERT(!ring.push(64));
+        TS_ASSERT_EQUALS(ring.size(),64U);
+
+        ckcore::tuint32 items[100];
+        TS_ASSERT_EQUALS(ring.pop(items,10),10U);
+        TS_ASSERT_EQUALS(items[9],9U);
+        TS_ASSERT_EQUALS(ring.push(items,100),10U);
+        TS_ASSERT_EQUALS(ring.pop(items,100),64U);
+        TS_ASSERT_EQUALS(items[0],10U);
+        TS_ASSERT_EQUALS(items[53],63U);
+        TS_ASSERT_EQUALS(items[54],0U);
+        TS_ASSERT(ring.empty());
+
+        ckcore::tuint32 item = 0;
+        TS_ASSERT(!ring.pop(item));
+
+        // Transfer items between threads and verify the order.
+        TestRingProducer producer(ring);
+        TS_ASSERT(producer.start());
+
+        ckcore::tuint32 next = 0;
+        bool ordered = true;
+        while (next < QUEUE_TEST_ITEMS)
+        {
+            ckcore::tuint32 count = ring.pop(items,100);
+            for (ckcore::tuint32 i = 0; i < count; i++)
+                ordered = ordered && items[i] == next + i;
+            next += count;
+        }
+
+        producer.wait();
+        TS_ASSERT(ordered);
+        TS_ASSERT(ring.empty());
+    }
+
+    void testMpmcQueue()
+    {
+        TestQueue queue(100);
+        TS_ASSERT_EQUALS(queue.capacity(),128U);
+        TS_ASSERT(queue.empty());
+
+        ckcore::tuint32 items[200];
+        for (ckcore::tuint32 i = 0; i < 200; i++)
+            items[i] = i;
+
+        TS_ASSERT_EQUALS(queue.push(items,200),128U);
+        TS_ASSERT(!queue.push(items[0]));
+        TS_ASSERT_EQUALS(queue.size(),128U);
+
+        TS_ASSERT_EQUALS(queue.pop(items,100),100U);
+        TS_ASSERT_EQUALS(items[99],99U);
+        TS_ASSERT_EQUALS(queue.pop(items,100),28U);
+        TS_ASSERT_EQUALS(items[27],127U);
+        TS_ASSERT(queue.empty());
+
+        ckcore::tuint32 item = 0;
+        TS_ASSERT(!queue.pop(item));
+
+        // Transfer items between multiple producers and consumers and verify
+        // that no item is lost or duplicated.
+        volatile ckcore::tint32 remaining = 4 * QUEUE_TEST_ITEMS;
+
+        TestQueueProducer producer[4] =
+        {
+            TestQueueProducer(queue,0),
+            TestQueueProducer(queue,QUEUE_TEST_ITEMS),
+            TestQueueProducer(queue,2 * QUEUE_TEST_ITEMS),
+            TestQueueProducer(queue,3 * QUEUE_TEST_ITEMS)
+        };
+
+        TestQueueConsumer consumer[4] =
+        {
+            TestQueueConsumer(queue,remaining),TestQueueConsumer(queue,remaining),
+            TestQueueConsumer(queue,remaining),TestQueueConsumer(queue,remaining)
+        };
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            TS_ASSERT(consumer[i].start());
+            TS_ASSERT(producer[i].start());
+        }
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            producer[i].wait();
+            consumer[i].wait();
+        }
+
+        ckcore::tuint64 sum = 0;
+        for (size_t i = 0; i < 4; i++)
+            sum += consumer[i].sum_;
+
+        const ckcore::tuint64 total = 4 * QUEUE_TEST_ITEMS;
+        TS_ASSERT_EQUALS(sum,total * (total - 1) / 2);
+        TS_ASSERT(queue.empty());
+    }
+};
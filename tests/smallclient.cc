@@ -1,4 +1,5 @@
 #include <iostream>
+#include <sstream>
 
 #ifdef _WINDOWS
 #include <string>
@@ -6,6 +7,10 @@
 #define sleep(x) Sleep(x*1000)
 #elif defined(_UNIX)
 #include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "ckcore/sharedmemorystream.hh"
 #else
 #error "Unknown platform"
 #endif
@@ -24,9 +29,21 @@ int main(int argc,const char *argv[])
             mode = 4;
         else if (!strcmp(argv[1],"-m5"))
             mode = 5;
+        else if (!strcmp(argv[1],"-m6"))
+            mode = 6;
+        else if (!strcmp(argv[1],"-m7"))
+            mode = 7;
+        else if (!strcmp(argv[1],"-m8"))
+            mode = 8;
+        else if (!strcmp(argv[1],"-m9"))
+            mode = 9;
+        else if (!strcmp(argv[1],"-m10"))
+            mode = 10;
     }
 
-    std::cout << "SmallClient" << std::endl;
+    // The output of the framed protocol must not contain anything else.
+    if (mode != 8)
+        std::cout << "SmallClient" << std::endl;
 
     switch (mode)
     {
@@ -73,6 +90,100 @@ int main(int argc,const char *argv[])
         // Test exit code.
         case 5:
             return 42;
+
+        // Test feeding binary data to standard input.
+        case 6:
+            {
+                unsigned long count = 0,sum = 0;
+
+                char buffer[4096];
+                while (std::cin.read(buffer,sizeof(buffer)) || std::cin.gcount() > 0)
+                {
+                    for (std::streamsize i = 0; i < std::cin.gcount(); i++)
+                        sum += static_cast<unsigned char>(buffer[i]);
+
+                    count += static_cast<unsigned long>(std::cin.gcount());
+                }
+
+                std::cout << "READ " << count << " " << sum << std::endl;
+            }
+            break;
+
+#ifdef _UNIX
+        // Test process options.
+        case 7:
+            {
+                struct rlimit limit;
+                getrlimit(RLIMIT_NOFILE,&limit);
+
+                std::cout << "NICE " << getpriority(PRIO_PROCESS,0) << " "
+                          << "FILES " << limit.rlim_cur << std::endl;
+            }
+            break;
+
+        // Test framed requests, each request is answered with the request
+        // followed by the process identifier.
+        case 8:
+            {
+                unsigned char header[4];
+                while (std::cin.read(reinterpret_cast<char *>(header),sizeof(header)))
+                {
+                    unsigned long size = (static_cast<unsigned long>(header[0]) << 24) |
+                                         (static_cast<unsigned long>(header[1]) << 16) |
+                                         (static_cast<unsigned long>(header[2]) << 8) |
+                                          static_cast<unsigned long>(header[3]);
+
+                    std::string request(size,'\0');
+                    if (size > 0 && !std::cin.read(&request[0],size))
+                        break;
+
+                    std::ostringstream response;
+                    response << request << " " << getpid();
+
+                    std::string payload = response.str();
+                    size = static_cast<unsigned long>(payload.size());
+                    header[0] = static_cast<unsigned char>(size >> 24);
+                    header[1] = static_cast<unsigned char>(size >> 16);
+                    header[2] = static_cast<unsigned char>(size >> 8);
+                    header[3] = static_cast<unsigned char>(size);
+
+                    std::cout.write(reinterpret_cast<char *>(header),sizeof(header));
+                    std::cout.write(payload.data(),payload.size());
+                    std::cout.flush();
+                }
+            }
+            break;
+
+        // Test reading from a shared memory stream, the descriptor is given
+        // as the second argument.
+        case 9:
+            {
+                ckcore::SharedMemoryInStream in;
+                if (argc < 3 || !in.open(atoi(argv[2])))
+                    return 1;
+
+                unsigned long count = 0,sum = 0;
+
+                char buffer[4096];
+                ckcore::tint64 res;
+                while ((res = in.read(buffer,sizeof(buffer))) > 0)
+                {
+                    for (ckcore::tint64 i = 0; i < res; i++)
+                        sum += static_cast<unsigned char>(buffer[i]);
+
+                    count += static_cast<unsigned long>(res);
+                }
+
+                std::cout << "READ " << count << " " << sum << std::endl;
+            }
+            break;
+#endif
+
+        // Test exiting without terminating the last line.
+        case 10:
+            std::cout << "PARTIAL";
+            std::cout.flush();
+            break;
     }
 
     return 0;
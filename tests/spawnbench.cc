@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include "ckcore/types.hh"
+#include "ckcore/file.hh"
+#include "ckcore/process.hh"
+#include "ckcore/system.hh"
+
+class BenchProcess : public ckcore::Process
+{
+public:
+    ~BenchProcess()
+    {
+        invalid_inheritor_ = true;
+    }
+
+    void event_finished()
+    {
+    }
+
+    void event_output(const std::string &block)
+    {
+    }
+};
+
+/*
+ * Launches the executable repeatedly for about two seconds and returns the
+ * number of launches per second.
+ */
+static double bench(const char *executable,ckcore::Process::Launcher launcher)
+{
+    BenchProcess process;
+    process.set_launcher(launcher);
+
+    ckcore::tuint64 start_time = ckcore::system::time();
+    ckcore::tuint64 cur_time = start_time;
+    ckcore::tuint32 launches = 0;
+
+    while (cur_time - start_time < 2000)
+    {
+        if (!process.create(executable))
+            return -1.0;
+
+        process.wait();
+        launches++;
+
+        cur_time = ckcore::system::time();
+    }
+
+    return launches * 1000.0 / (cur_time - start_time);
+}
+
+int main(int argc,const char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: spawnbench <executable> [<heap size in MiB>...]" << std::endl;
+        return 1;
+    }
+
+    if (!ckcore::File::exist(argv[1]))
+    {
+        std::cerr << "Error: The specified executable does not exist." << std::endl;
+        return 1;
+    }
+
+    std::vector<ckcore::tuint32> heap_sizes;
+    for (int i = 2; i < argc; i++)
+        heap_sizes.push_back(atoi(argv[i]));
+
+    if (heap_sizes.empty())
+    {
+        heap_sizes.push_back(0);
+        heap_sizes.push_back(256);
+        heap_sizes.push_back(1024);
+    }
+
+    // Grow the heap in steps and touch every page so that it's resident.
+    std::vector<char *> heap;
+    ckcore::tuint32 heap_size = 0;
+
+    for (size_t i = 0; i < heap_sizes.size(); i++)
+    {
+        while (heap_size < heap_sizes[i])
+        {
+            char *block = static_cast<char *>(malloc(1024 * 1024));
+            if (block == NULL)
+            {
+                std::cerr << "Error: Unable to allocate memory." << std::endl;
+                return 1;
+            }
+
+            memset(block,1,1024 * 1024);
+            heap.push_back(block);
+            heap_size++;
+        }
+
+        double spawn_rate = bench(argv[1],ckcore::Process::LAUNCHER_SPAWN);
+        double fork_rate = bench(argv[1],ckcore::Process::LAUNCHER_FORK);
+        if (spawn_rate < 0.0 || fork_rate < 0.0)
+        {
+            std::cerr << "Error: Unable to launch process." << std::endl;
+            return 1;
+        }
+
+        std::cout << "Heap: " << heap_size << " MiB, spawn: " << spawn_rate
+                  << " launches/s, fork: " << fork_rate << " launches/s." << std::endl;
+    }
+
+    for (size_t i = 0; i < heap.size(); i++)
+        free(heap[i]);
+
+    return 0;
+}
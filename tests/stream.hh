@@ -19,15 +19,22 @@
 #include <cxxtest/TestSuite.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <string.h>
+#include <vector>
 #include "ckcore/types.hh"
 #include "ckcore/filestream.hh"
 #include "ckcore/bufferedstream.hh"
+#include "ckcore/bufferpool.hh"
 #include "ckcore/crcstream.hh"
 #include "ckcore/memorystream.hh"
 #include "ckcore/nullstream.hh"
+#include "ckcore/pipeline.hh"
+#include "ckcore/pipestream.hh"
 #include "ckcore/system.hh"
 #include "ckcore/progress.hh"
 #include "ckcore/progresser.hh"
+#include "ckcore/cancellation.hh"
+#include "ckcore/thread.hh"
 
 #ifdef TEST_SRC_DIR
 #undef TEST_SRC_DIR
@@ -42,6 +49,151 @@ public:
     bool cancelled() { return false; }
 };
 
+/**
+ * @brief Test thread writing a pattern to a pipe.
+ */
+class PipeWriter : public ckcore::Thread
+{
+private:
+    ckcore::PipeStream::Writer &writer_;
+    ckcore::tuint32 count_;
+
+    void run()
+    {
+        unsigned char buffer[1000];
+        ckcore::tuint32 pos = 0;
+        while (pos < count_)
+        {
+            // Alternate between writing through the stream interface and
+            // writing directly into the ring.
+            if ((pos / 1000) % 2 == 0)
+            {
+                ckcore::tuint32 count = std::min<ckcore::tuint32>(count_ - pos,1000);
+                for (ckcore::tuint32 i = 0; i < count; i++)
+                    buffer[i] = static_cast<unsigned char>((pos + i) % 251);
+
+                if (writer_.write(buffer,count) != count)
+                    break;
+
+                pos += count;
+            }
+            else
+            {
+                ckcore::tuint32 count = std::min<ckcore::tuint32>(count_ - pos,1000 - pos % 1000);
+                unsigned char *space = writer_.reserve(count);
+                if (space == NULL)
+                    break;
+
+                for (ckcore::tuint32 i = 0; i < count; i++)
+                    space[i] = static_cast<unsigned char>((pos + i) % 251);
+
+                writer_.commit(count);
+                pos += count;
+            }
+        }
+
+        writer_.close();
+    }
+
+public:
+    PipeWriter(ckcore::PipeStream::Writer &writer,ckcore::tuint32 count) :
+        writer_(writer),count_(count) {}
+};
+
+/**
+ * @brief Test thread allocating and releasing a number of buffers.
+ */
+class BufferReleaser : public ckcore::Thread
+{
+private:
+    ckcore::BufferPool &pool_;
+    size_t count_;
+
+    void run()
+    {
+        std::vector<void *> buffers;
+        for (size_t i = 0; i < count_; i++)
+            buffers.push_back(pool_.allocate(8192));
+
+        for (size_t i = 0; i < count_; i++)
+            pool_.release(buffers[i],8192);
+
+        // Keep the thread cache alive until the test is done inspecting the
+        // pool, then empty it so that nothing is returned on thread exit.
+        released_.set();
+        exit_.wait(5000);
+        pool_.trim();
+    }
+
+public:
+    ckcore::thread::Event released_;
+    ckcore::thread::Event exit_;
+
+    BufferReleaser(ckcore::BufferPool &pool,size_t count) :
+        pool_(pool),count_(count) {}
+};
+
+/**
+ * @brief Pipeline stage inverting all bytes.
+ */
+class InvertStage : public ckcore::PipelineStage
+{
+public:
+    bool process(ckcore::InStream &in,ckcore::OutStream &out)
+    {
+        unsigned char buffer[4096];
+        while (!in.end())
+        {
+            ckcore::tint64 res = in.read(buffer,sizeof(buffer));
+            if (res == -1)
+                return false;
+
+            for (ckcore::tint64 i = 0; i < res; i++)
+                buffer[i] = ~buffer[i];
+
+            if (out.write(buffer,static_cast<ckcore::tuint32>(res)) != res)
+                return false;
+        }
+
+        return true;
+    }
+};
+
+/**
+ * @brief Pipeline stage calculating a checksum of the data passing through.
+ */
+class ChecksumStage : public ckcore::PipelineStage
+{
+public:
+    ckcore::CrcStream crc_;
+    ckcore::tint64 limit_;  ///< Number of bytes to accept before failing.
+
+    ChecksumStage(ckcore::tint64 limit = -1) :
+        crc_(ckcore::CrcStream::ckCRC_32),limit_(limit) {}
+
+    bool process(ckcore::InStream &in,ckcore::OutStream &out)
+    {
+        unsigned char buffer[1000];
+        ckcore::tint64 total = 0;
+        while (!in.end())
+        {
+            ckcore::tint64 res = in.read(buffer,sizeof(buffer));
+            if (res == -1)
+                return false;
+
+            total += res;
+            if (limit_ >= 0 && total > limit_)
+                return false;
+
+            crc_.write(buffer,static_cast<ckcore::tuint32>(res));
+            if (out.write(buffer,static_cast<ckcore::tuint32>(res)) != res)
+                return false;
+        }
+
+        return true;
+    }
+};
+
 class StreamTestSuite : public CxxTest::TestSuite
 {
 public:
@@ -392,4 +544,231 @@ public:
         TS_ASSERT(ckcore::stream::copy(is1,ns4,p,9200));
         TS_ASSERT_EQUALS(ns4.written(),ckcore::tuint64(9200));
     }
+
+    void testCopyCancel()
+    {
+        ckcore::FileInStream is(ckT(TEST_SRC_DIR)ckT("/data/file/8253bytes"));
+        TS_ASSERT(is.open());
+
+        ckcore::CancellationSource source;
+        ckcore::CancellationToken token = source.token();
+        TS_ASSERT(token.cancellable());
+        TS_ASSERT(!token.cancelled());
+        TS_ASSERT(!ckcore::CancellationToken().cancellable());
+
+        ckcore::NullStream ns1;
+        TS_ASSERT(ckcore::stream::copy(is,ns1,token));
+        TS_ASSERT_EQUALS(ns1.written(),ckcore::tuint64(8253));
+
+        source.cancel();
+        TS_ASSERT(source.cancelled());
+        TS_ASSERT(token.cancelled());
+
+        // Cancelled copies should fail without writing anything.
+        ckcore::NullStream ns2;
+        TS_ASSERT(is.seek(0,ckcore::InStream::ckSTREAM_BEGIN));
+        TS_ASSERT(!ckcore::stream::copy(is,ns2,token));
+        TS_ASSERT_EQUALS(ns2.written(),ckcore::tuint64(0));
+
+        // The token should override the progress interface.
+        DummyProgress dp;
+        ckcore::Progresser p(dp,0xffffffff,token);
+        TS_ASSERT(p.cancelled());
+
+        ckcore::NullStream ns3;
+        TS_ASSERT(is.seek(0,ckcore::InStream::ckSTREAM_BEGIN));
+        TS_ASSERT(!ckcore::stream::copy(is,ns3,p));
+        TS_ASSERT_EQUALS(ns3.written(),ckcore::tuint64(0));
+    }
+    void testPipeStream()
+    {
+        ckcore::PipeStream pipe(1000);
+        TS_ASSERT_EQUALS(pipe.capacity(),1024U);
+
+        ckcore::PipeStream::Reader &reader = pipe.reader();
+        TS_ASSERT_EQUALS(reader.size(),-1);
+        TS_ASSERT(!reader.seek(0,ckcore::InStream::ckSTREAM_BEGIN));
+
+        const ckcore::tuint32 total = 1000000;
+        PipeWriter writer(pipe.writer(),total);
+        TS_ASSERT(writer.start());
+
+        // Alternate between reading through the stream interface and reading
+        // directly from the ring.
+        unsigned char buffer[777];
+        ckcore::tuint32 pos = 0;
+        bool valid = true;
+        while (!reader.end())
+        {
+            if (pos % 2 == 0)
+            {
+                ckcore::tint64 res = reader.read(buffer,sizeof(buffer));
+                TS_ASSERT(res > 0);
+                if (res <= 0)
+                    break;
+
+                for (ckcore::tint64 i = 0; i < res; i++)
+                    valid = valid && buffer[i] == (pos + i) % 251;
+                pos += static_cast<ckcore::tuint32>(res);
+            }
+            else
+            {
+                ckcore::tuint32 count = 0;
+                const unsigned char *data = reader.peek(count);
+                TS_ASSERT(data != NULL);
+                if (data == NULL)
+                    break;
+
+                for (ckcore::tuint32 i = 0; i < count; i++)
+                    valid = valid && data[i] == (pos + i) % 251;
+                reader.consume(count);
+                pos += count;
+            }
+        }
+
+        writer.wait();
+        TS_ASSERT(valid);
+        TS_ASSERT_EQUALS(pos,total);
+        TS_ASSERT_EQUALS(reader.read(buffer,sizeof(buffer)),0);
+
+        // Closing the reading end should make the writer fail.
+        ckcore::PipeStream pipe2(16);
+        TS_ASSERT_EQUALS(pipe2.writer().write(buffer,16),16);
+        TS_ASSERT(pipe2.reader().seek(8,ckcore::InStream::ckSTREAM_CURRENT));
+        pipe2.reader().close();
+        TS_ASSERT_EQUALS(pipe2.writer().write(buffer,16),-1);
+    }
+    void testPipeline()
+    {
+        const ckcore::tuint32 size = 1000000;
+        std::vector<unsigned char> input(size);
+        for (ckcore::tuint32 i = 0; i < size; i++)
+            input[i] = static_cast<unsigned char>(rand());
+
+        // The checksum stage sees the inverted data.
+        std::vector<unsigned char> inverted(size);
+        for (ckcore::tuint32 i = 0; i < size; i++)
+            inverted[i] = ~input[i];
+
+        ckcore::CrcStream expected(ckcore::CrcStream::ckCRC_32);
+        expected.write(&inverted[0],size);
+
+        // Invert the data twice so that the output should match the input.
+        InvertStage invert1,invert2;
+        ChecksumStage checksum;
+
+        ckcore::ThreadPool tp(ckT("pipeline"));
+        ckcore::Pipeline pipeline(tp,4096);
+        TS_ASSERT_EQUALS(pipeline.add(invert1),0U);
+        TS_ASSERT_EQUALS(pipeline.add(checksum),1U);
+        TS_ASSERT_EQUALS(pipeline.add(invert2),2U);
+        TS_ASSERT_EQUALS(pipeline.size(),3U);
+
+        ckcore::MemoryInStream source(&input[0],size);
+        ckcore::MemoryOutStream sink;
+        TS_ASSERT(pipeline.execute(source,sink));
+
+        TS_ASSERT_EQUALS(sink.count(),size);
+        TS_ASSERT(sink.count() == size &&
+                  memcmp(sink.data(),&input[0],size) == 0);
+        TS_ASSERT_EQUALS(checksum.crc_.checksum(),expected.checksum());
+
+        for (ckcore::tuint32 i = 0; i < pipeline.size(); i++)
+        {
+            TS_ASSERT_EQUALS(pipeline.stats(i).bytes_in_,size);
+            TS_ASSERT_EQUALS(pipeline.stats(i).bytes_out_,size);
+            TS_ASSERT(pipeline.stats(i).run_time_ >= pipeline.stats(i).busy_time());
+        }
+
+        // A failing stage should make the whole pipeline fail.
+        ChecksumStage failing(size / 2);
+        ckcore::Pipeline pipeline2(tp,4096);
+        pipeline2.add(invert1);
+        pipeline2.add(failing);
+        pipeline2.add(invert2);
+
+        ckcore::MemoryInStream source2(&input[0],size);
+        ckcore::NullStream sink2;
+        TS_ASSERT(!pipeline2.execute(source2,sink2));
+        TS_ASSERT(pipeline2.stats(0).bytes_in_ < size);
+    }
+
+    void testBufferPool()
+    {
+        ckcore::BufferPool pool(8 * 8192);
+        TS_ASSERT_EQUALS(ckcore::BufferPool::buffer_size(1),size_t(4096));
+        TS_ASSERT_EQUALS(ckcore::BufferPool::buffer_size(5000),size_t(8192));
+        TS_ASSERT_EQUALS(ckcore::BufferPool::buffer_size(5 * 1024 * 1024),size_t(6 * 1024 * 1024));
+
+        // Buffers should be page aligned and reused by the same thread.
+        void *buffer = pool.allocate(5000);
+        TS_ASSERT(buffer != NULL);
+        TS_ASSERT_EQUALS(reinterpret_cast<size_t>(buffer) % 4096,size_t(0));
+        memset(buffer,0xff,8192);
+        pool.release(buffer,5000);
+        TS_ASSERT_EQUALS(pool.allocate(8000),buffer);
+        pool.release(buffer,8000);
+        TS_ASSERT_EQUALS(pool.cached(),ckcore::tuint64(0));
+
+        // Buffers not fitting in the thread cache go to the shared pool, up
+        // to the budget.
+        BufferReleaser releaser(pool,12);
+        TS_ASSERT(releaser.start());
+        TS_ASSERT(releaser.released_.wait(5000));
+        TS_ASSERT(pool.cached() >= 8 * 8192 - ckcore::BufferPool::THREAD_CACHE_COUNT * 8192);
+        TS_ASSERT(pool.cached() <= 8 * 8192);
+
+        // Buffers in the shared pool are available to all threads.
+        ckcore::tuint64 cached = pool.cached();
+        void *shared[ckcore::BufferPool::THREAD_CACHE_COUNT + 1];
+        for (int i = 0; i < ckcore::BufferPool::THREAD_CACHE_COUNT + 1; i++)
+            shared[i] = pool.allocate(8192);
+        TS_ASSERT(pool.cached() < cached);
+        for (int i = 0; i < ckcore::BufferPool::THREAD_CACHE_COUNT + 1; i++)
+            pool.release(shared[i],8192);
+
+        // Thread::wait() fails if the thread has already finished, the
+        // thread is done with the pool either way once it returns.
+        releaser.exit_.set();
+        releaser.wait();
+        TS_ASSERT(!releaser.running());
+
+        // Huge buffers bypass the caches.
+        pool.set_huge_pages(true);
+        {
+            ckcore::PooledBuffer huge(3 * 1024 * 1024,pool);
+            TS_ASSERT(huge.data() != NULL);
+            memset(huge.data(),0,3 * 1024 * 1024);
+        }
+
+        pool.trim();
+        TS_ASSERT_EQUALS(pool.cached(),ckcore::tuint64(0));
+    }
+
+    void testBufferedSeek()
+    {
+        std::vector<unsigned char> data(100000);
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = static_cast<unsigned char>(i % 251);
+
+        // Seeking should skip data within and beyond the internal buffer.
+        ckcore::MemoryInStream source(&data[0],static_cast<ckcore::tuint32>(data.size()));
+        ckcore::BufferedInStream in(source,1000);
+
+        unsigned char c = 0;
+        TS_ASSERT(in.seek(10,ckcore::InStream::ckSTREAM_CURRENT));
+        TS_ASSERT_EQUALS(in.read(&c,1),1);
+        TS_ASSERT_EQUALS(c,10);
+
+        TS_ASSERT(in.seek(50000,ckcore::InStream::ckSTREAM_CURRENT));
+        TS_ASSERT_EQUALS(in.read(&c,1),1);
+        TS_ASSERT_EQUALS(c,50011 % 251);
+
+        TS_ASSERT(in.seek(7,ckcore::InStream::ckSTREAM_BEGIN));
+        TS_ASSERT_EQUALS(in.read(&c,1),1);
+        TS_ASSERT_EQUALS(c,7);
+
+        // Seeking beyond the end should fail.
+        TS_ASSERT(!in.seek(100000,ckcore::InStream::ckSTREAM_CURRENT));
+    }
 };
@@ -18,6 +18,9 @@
 
 #include <cxxtest/TestSuite.h>
 #include "ckcore/locker.hh"
+#include "ckcore/lockprofiler.hh"
+#include "ckcore/rwlock.hh"
+#include "ckcore/spinlock.hh"
 #include "ckcore/types.hh"
 #include "ckcore/thread.hh"
 
@@ -116,6 +119,173 @@ public:
     TestThread5(int &value,ckcore::thread::WaitCondition &wc) : value_(value),wc_(wc) {}
 };
 
+/**
+ * @brief Test thread for thread attributes.
+ */
+class TestThread6 : public ckcore::Thread
+{
+private:
+    void run()
+    {
+        // Stay alive until the test is ready to wait for the thread.
+        if (!release_.wait(5000))
+            return;
+
+#ifdef __linux__
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        if (sched_getaffinity(0,sizeof(cpu_set),&cpu_set) == 0)
+            cpu_count_ = CPU_COUNT(&cpu_set);
+
+        char name[16];
+        if (pthread_getname_np(pthread_self(),name,sizeof(name)) == 0)
+            name_ = name;
+#endif
+        result_++;
+    }
+
+public:
+    ckcore::thread::Event release_;
+    int result_;
+    int cpu_count_;
+    std::string name_;
+
+    TestThread6() : result_(0),cpu_count_(0) {}
+};
+
+/**
+ * @brief Test thread for events and semaphores.
+ */
+class TestThread7 : public ckcore::Thread
+{
+private:
+    ckcore::thread::Event *event_;
+    ckcore::thread::Semaphore *sema_;
+
+    void run()
+    {
+        if (event_ != NULL && event_->wait(5000))
+            result_++;
+
+        if (sema_ != NULL && sema_->wait(5000))
+            result_++;
+    }
+
+public:
+    volatile int result_;
+
+    TestThread7(ckcore::thread::Event *event,ckcore::thread::Semaphore *sema) :
+        event_(event),sema_(sema),result_(0) {}
+};
+
+/**
+ * @brief Test thread for reader-writer locks.
+ */
+class TestThread8 : public ckcore::Thread
+{
+private:
+    int &value_;
+    ckcore::thread::RWLock &lock_;
+    bool writer_;
+
+    void run()
+    {
+        for (size_t i = 0; i < 1024; i++)
+        {
+            if (writer_)
+            {
+                ckcore::Locker<ckcore::thread::RWLock> lock(lock_);
+                value_++;
+                value_++;
+            }
+            else
+            {
+                ckcore::SharedLocker<ckcore::thread::RWLock> lock(lock_);
+                if (value_ % 2 != 0)
+                    errors_++;
+            }
+        }
+    }
+
+public:
+    int errors_;
+
+    TestThread8(int &value,ckcore::thread::RWLock &lock,bool writer) :
+        value_(value),lock_(lock),writer_(writer),errors_(0) {}
+};
+
+/**
+ * @brief Test thread for spin locks.
+ */
+class TestThread9 : public ckcore::Thread
+{
+private:
+    int &value_;
+    ckcore::thread::SpinLock &lock_;
+
+    void run()
+    {
+        for (size_t i = 0; i < 1024; i++)
+        {
+            ckcore::Locker<ckcore::thread::SpinLock> lock(lock_);
+            int tmp = value_;
+            value_ = tmp + 1;
+        }
+    }
+
+public:
+    TestThread9(int &value,ckcore::thread::SpinLock &lock) :
+        value_(value),lock_(lock) {}
+};
+
+/**
+ * @brief Test thread locking two mutexes in a given order.
+ */
+class TestThread10 : public ckcore::Thread
+{
+private:
+    int &value_;
+    ckcore::thread::Mutex &mutex1_;
+    ckcore::thread::Mutex &mutex2_;
+
+    void run()
+    {
+        for (size_t i = 0; i < 1024; i++)
+        {
+            ckcore::MultiLocker<ckcore::thread::Mutex> lock(mutex1_,mutex2_);
+            int tmp = value_;
+            value_ = tmp + 1;
+        }
+    }
+
+public:
+    TestThread10(int &value,ckcore::thread::Mutex &mutex1,
+                 ckcore::thread::Mutex &mutex2) :
+        value_(value),mutex1_(mutex1),mutex2_(mutex2) {}
+};
+
+/**
+ * @brief Test thread waiting on a wait condition until killed.
+ */
+class TestThread11 : public ckcore::Thread
+{
+private:
+    ckcore::thread::Mutex &mutex_;
+    ckcore::thread::WaitCondition &cond_;
+
+    void run()
+    {
+        ckcore::Locker<ckcore::thread::Mutex> lock(mutex_);
+        while (true)
+            cond_.wait(mutex_);
+    }
+
+public:
+    TestThread11(ckcore::thread::Mutex &mutex,
+                 ckcore::thread::WaitCondition &cond) :
+        mutex_(mutex),cond_(cond) {}
+};
+
 class ThreadTestSuite : public CxxTest::TestSuite
 {
 public:
@@ -165,6 +335,27 @@ public:
         TS_ASSERT_EQUALS(thread.result_,1);
     }
 
+    void testThreadKillWaiting()
+    {
+        ckcore::thread::Event event;
+        TestThread7 thread1(&event,NULL);
+        TS_ASSERT(thread1.start());
+        ckcore::thread::sleep(20);
+        TS_ASSERT(thread1.kill());
+        TS_ASSERT_EQUALS(thread1.result_,0);
+
+        ckcore::thread::Mutex mutex;
+        ckcore::thread::WaitCondition cond;
+        TestThread11 thread2(mutex,cond);
+        TS_ASSERT(thread2.start());
+        ckcore::thread::sleep(20);
+        TS_ASSERT(thread2.kill());
+
+        // The killed thread must not keep the mutex locked.
+        TS_ASSERT(mutex.try_lock());
+        mutex.unlock();
+    }
+
     void testThreadMutex()
     {
         // This test is based on the idea that it's unlikeley that a large
@@ -382,4 +573,270 @@ public:
 
         TS_ASSERT_EQUALS(count,32);
     }
+
+    void testThreadAttributes()
+    {
+        ckcore::ThreadAttributes attr;
+        attr.stack_size = 256 * 1024;
+        attr.cpu_affinity.push_back(0);
+        attr.name = ckT("cktest");
+
+        TestThread6 thread;
+        TS_ASSERT(thread.start(attr));
+        TS_ASSERT(thread.running());
+
+        // The thread may finish before wait() is called in which case wait()
+        // returns false, check the recorded result instead.
+        thread.release_.set();
+        thread.wait();
+        TS_ASSERT(!thread.running());
+        TS_ASSERT_EQUALS(thread.result_,1);
+
+#ifdef __linux__
+        TS_ASSERT_EQUALS(thread.cpu_count_,1);
+        TS_ASSERT_EQUALS(thread.name_,std::string("cktest"));
+#endif
+
+        // Restarting using the default attributes should reset the attributes.
+        thread.cpu_count_ = 0;
+        thread.name_.clear();
+
+        TS_ASSERT(thread.start());
+        TS_ASSERT(thread.running());
+        thread.release_.set();
+        thread.wait();
+        TS_ASSERT(!thread.running());
+        TS_ASSERT_EQUALS(thread.result_,2);
+
+#ifdef __linux__
+        // The thread should run on the same processors as this thread.
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        TS_ASSERT_EQUALS(sched_getaffinity(0,sizeof(cpu_set),&cpu_set),0);
+        TS_ASSERT_EQUALS(thread.cpu_count_,CPU_COUNT(&cpu_set));
+        TS_ASSERT_DIFFERS(thread.name_,std::string("cktest"));
+#endif
+    }
+
+    void testThreadEvent()
+    {
+        // Manual-reset events release all waiting threads.
+        ckcore::thread::Event manual(true);
+        TS_ASSERT(!manual.wait(10));
+
+        TestThread7 thread1(&manual,NULL),thread2(&manual,NULL);
+        TS_ASSERT(thread1.start());
+        TS_ASSERT(thread2.start());
+
+        ckcore::thread::sleep(20);
+        TS_ASSERT_EQUALS(thread1.result_,0);
+        TS_ASSERT_EQUALS(thread2.result_,0);
+
+        manual.set();
+        thread1.wait();
+        thread2.wait();
+        TS_ASSERT_EQUALS(thread1.result_,1);
+        TS_ASSERT_EQUALS(thread2.result_,1);
+        TS_ASSERT(manual.wait(0));
+
+        manual.reset();
+        TS_ASSERT(!manual.wait(10));
+
+        // Auto-reset events release one thread at a time.
+        ckcore::thread::Event automatic;
+        TestThread7 thread3(&automatic,NULL),thread4(&automatic,NULL);
+        TS_ASSERT(thread3.start());
+        TS_ASSERT(thread4.start());
+
+        automatic.set();
+        ckcore::thread::sleep(50);
+        TS_ASSERT_EQUALS(thread3.result_ + thread4.result_,1);
+
+        automatic.set();
+        thread3.wait();
+        thread4.wait();
+        TS_ASSERT_EQUALS(thread3.result_ + thread4.result_,2);
+        TS_ASSERT(!automatic.wait(10));
+    }
+
+    void testThreadSemaphore()
+    {
+        ckcore::thread::Semaphore sema(1);
+        TS_ASSERT(sema.wait(0));
+        TS_ASSERT(!sema.wait(10));
+
+        TestThread7 thread[4] =
+        {
+            TestThread7(NULL,&sema),TestThread7(NULL,&sema),
+            TestThread7(NULL,&sema),TestThread7(NULL,&sema)
+        };
+
+        for (size_t i = 0; i < 4; i++)
+            TS_ASSERT(thread[i].start());
+
+        // Release the threads two at a time.
+        sema.release(2);
+        ckcore::thread::sleep(50);
+
+        int count = 0;
+        for (size_t i = 0; i < 4; i++)
+            count += thread[i].result_;
+        TS_ASSERT_EQUALS(count,2);
+
+        sema.release(2);
+        for (size_t i = 0; i < 4; i++)
+            thread[i].wait();
+
+        count = 0;
+        for (size_t i = 0; i < 4; i++)
+            count += thread[i].result_;
+        TS_ASSERT_EQUALS(count,4);
+        TS_ASSERT(!sema.wait(10));
+    }
+    void testThreadRWLock()
+    {
+        ckcore::thread::RWLock lock;
+        TS_ASSERT(lock.try_lock_shared());
+        TS_ASSERT(lock.try_lock_shared());
+        TS_ASSERT(!lock.try_lock());
+        TS_ASSERT(lock.unlock_shared());
+        TS_ASSERT(lock.unlock_shared());
+        TS_ASSERT(!lock.unlock_shared());
+        TS_ASSERT(lock.try_lock());
+        TS_ASSERT(!lock.try_lock_shared());
+        TS_ASSERT(lock.unlock());
+        TS_ASSERT(!lock.unlock());
+
+        int value = 0;
+        TestThread8 thread[8] =
+        {
+            TestThread8(value,lock,true),TestThread8(value,lock,false),
+            TestThread8(value,lock,false),TestThread8(value,lock,false),
+            TestThread8(value,lock,true),TestThread8(value,lock,false),
+            TestThread8(value,lock,false),TestThread8(value,lock,false)
+        };
+
+        for (size_t i = 0; i < 8; i++)
+            TS_ASSERT(thread[i].start());
+
+        for (size_t i = 0; i < 8; i++)
+        {
+            thread[i].wait();
+            TS_ASSERT_EQUALS(thread[i].errors_,0);
+        }
+
+        TS_ASSERT_EQUALS(value,2 * 2 * 1024);
+    }
+
+    void testThreadSpinLock()
+    {
+        ckcore::thread::SpinLock lock;
+        TS_ASSERT(lock.try_lock());
+        TS_ASSERT(!lock.try_lock());
+        TS_ASSERT(lock.unlock());
+        TS_ASSERT(!lock.unlock());
+
+        int value = 0;
+        TestThread9 thread[8] =
+        {
+            TestThread9(value,lock),TestThread9(value,lock),
+            TestThread9(value,lock),TestThread9(value,lock),
+            TestThread9(value,lock),TestThread9(value,lock),
+            TestThread9(value,lock),TestThread9(value,lock)
+        };
+
+        for (size_t i = 0; i < 8; i++)
+            TS_ASSERT(thread[i].start());
+
+        for (size_t i = 0; i < 8; i++)
+            thread[i].wait();
+
+        TS_ASSERT_EQUALS(value,8 * 1024);
+    }
+
+    void testThreadMultiLocker()
+    {
+        // Threads lock the mutexes in opposite order which would eventually
+        // deadlock without the multi-locker.
+        int value = 0;
+        ckcore::thread::Mutex mutex1,mutex2;
+
+        TestThread10 thread[4] =
+        {
+            TestThread10(value,mutex1,mutex2),TestThread10(value,mutex2,mutex1),
+            TestThread10(value,mutex1,mutex2),TestThread10(value,mutex2,mutex1)
+        };
+
+        for (size_t i = 0; i < 4; i++)
+            TS_ASSERT(thread[i].start());
+
+        for (size_t i = 0; i < 4; i++)
+            thread[i].wait();
+
+        TS_ASSERT_EQUALS(value,4 * 1024);
+
+        ckcore::MultiLocker<ckcore::thread::Mutex> lock(mutex1,mutex2);
+        TS_ASSERT(lock.locked());
+        TS_ASSERT(!mutex1.try_lock());
+        TS_ASSERT(lock.unlock());
+        TS_ASSERT(mutex1.try_lock());
+        TS_ASSERT(mutex1.unlock());
+    }
+    void testThreadLockProfiler()
+    {
+        ckcore::thread::Mutex mutex("TestMutex \"1\"");
+        ckcore::thread::LockProfiler::reset();
+
+        // Nothing is recorded while profiling is disabled.
+        TS_ASSERT(mutex.lock());
+        TS_ASSERT(mutex.unlock());
+
+        ckcore::thread::LockProfiler::enable(true);
+
+        int value = 0;
+        TestThread3 thread[4] =
+        {
+            TestThread3(value,mutex),TestThread3(value,mutex),
+            TestThread3(value,mutex),TestThread3(value,mutex)
+        };
+
+        for (size_t i = 0; i < 4; i++)
+            thread[i].start();
+        for (size_t i = 0; i < 4; i++)
+            thread[i].wait();
+
+        ckcore::thread::LockProfiler::enable(false);
+        TS_ASSERT_EQUALS(value,4 * 1024);
+
+        std::vector<ckcore::thread::LockStats> stats;
+        ckcore::thread::LockProfiler::stats(stats);
+
+        const ckcore::thread::LockStats *mutex_stats = NULL;
+        for (size_t i = 0; i < stats.size(); i++)
+        {
+            if (stats[i].name_ == "TestMutex \"1\"")
+                mutex_stats = &stats[i];
+        }
+
+        TS_ASSERT(mutex_stats != NULL);
+        if (mutex_stats == NULL)
+            return;
+
+        TS_ASSERT_EQUALS(mutex_stats->instances_,1U);
+        TS_ASSERT_EQUALS(mutex_stats->acquisitions_,4U);
+        TS_ASSERT(mutex_stats->contended_ <= mutex_stats->acquisitions_);
+
+        ckcore::tuint64 holds = 0,waits = 0;
+        for (size_t i = 0; i < ckcore::thread::LockStats::HISTOGRAM_SIZE; i++)
+        {
+            holds += mutex_stats->hold_histogram_[i];
+            waits += mutex_stats->wait_histogram_[i];
+        }
+        TS_ASSERT_EQUALS(holds,4U);
+        TS_ASSERT_EQUALS(waits,mutex_stats->contended_);
+
+        std::string json = ckcore::thread::LockProfiler::json();
+        TS_ASSERT(json.find("\"name\":\"TestMutex \\\"1\\\"\"") != std::string::npos);
+        TS_ASSERT(json.find("\"acquisitions\":4,") != std::string::npos);
+    }
 };
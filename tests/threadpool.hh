@@ -17,8 +17,12 @@
  */
 
 #include <cxxtest/TestSuite.h>
+#include <vector>
 #include "ckcore/types.hh"
+#include "ckcore/locker.hh"
+#include "ckcore/system.hh"
 #include "ckcore/task.hh"
+#include "ckcore/taskgraph.hh"
 #include "ckcore/threadpool.hh"
 
 class TestTask1: public ckcore::Task
@@ -44,6 +48,90 @@ public:
     }
 };
 
+class TestTask2: public ckcore::Task
+{
+private:
+    void start()
+    {
+        ckcore::ThreadPool::BlockingScope scope(pool_);
+        ckcore::thread::sleep(400);
+        *result_ = *other_result_;
+    }
+
+public:
+    ckcore::ThreadPool &pool_;
+    int *result_;
+    int *other_result_;
+
+    TestTask2(ckcore::ThreadPool &pool,int *result,int *other_result) :
+        pool_(pool),result_(result),other_result_(other_result)
+    {
+    }
+};
+
+class TestTask3: public ckcore::Task
+{
+private:
+    void start()
+    {
+        (*result_)++;
+    }
+
+public:
+    volatile int *result_;
+    int *deleted_;
+
+    TestTask3(volatile int *result,int *deleted) :
+        result_(result),deleted_(deleted)
+    {
+    }
+
+    ~TestTask3()
+    {
+        *deleted_ = 1;
+    }
+};
+
+class TestTask4: public ckcore::Task
+{
+private:
+    void start()
+    {
+        ckcore::thread::sleep(delay_);
+
+        ckcore::Locker<ckcore::thread::Mutex> lock(*mutex_);
+        order_->push_back(id_);
+    }
+
+public:
+    int id_;
+    ckcore::tuint32 delay_;
+    ckcore::thread::Mutex *mutex_;
+    std::vector<int> *order_;
+
+    TestTask4(int id,ckcore::tuint32 delay,ckcore::thread::Mutex *mutex,
+              std::vector<int> *order) :
+        id_(id),delay_(delay),mutex_(mutex),order_(order)
+    {
+    }
+};
+
+class TestTask5: public ckcore::Task
+{
+private:
+    void start()
+    {
+        *started_ = ckcore::system::time();
+    }
+
+public:
+    volatile ckcore::tuint64 *started_;
+
+    TestTask5(volatile ckcore::tuint64 *started) : started_(started)
+    {
+    }
+};
+
 class ThreadPoolTestSuite : public CxxTest::TestSuite
 {
 public:
@@ -347,6 +435,292 @@ public:
         {
             TS_ASSERT_EQUALS(deleted[i],1);
         }
+#endif
+    }
+
+    void testThreadPoolBatch()
+    {
+#if 1
+        ckcore::ThreadPool &tp = ckcore::ThreadPool::instance();
+        tp.set_retire_timeout(ckcore::ThreadPool::THREAD_RETIRE_TIMEOUT);
+
+        TS_ASSERT_EQUALS(tp.active_threads(),0);
+        TS_ASSERT_EQUALS(tp.idle_threads(),0);
+        TS_ASSERT_EQUALS(tp.retired_threads(),0);
+
+        int results[32];
+        int deleted[32];
+        memset(results,0,sizeof(int) * 32);
+        memset(deleted,0,sizeof(int) * 32);
+
+        ckcore::Task *tasks[32];
+        for (ckcore::tuint32 i = 0; i < 32; i++)
+            tasks[i] = new TestTask1(&results[i],&deleted[i]);
+
+        TS_ASSERT(tp.start_batch(tasks,32));
+        TS_ASSERT(tp.active_threads() <= ckcore::thread::ideal_count());
+
+        tp.wait();
+
+        // Verify results.
+        for (ckcore::tuint32 i = 0; i < 32; i++)
+        {
+            TS_ASSERT_EQUALS(results[i],1);
+            TS_ASSERT_EQUALS(deleted[i],1);
+        }
+
+        /*
+         * Run second pass with idle threads waiting for work.
+         */
+        memset(deleted,0,sizeof(int) * 32);
+
+        for (ckcore::tuint32 i = 0; i < ckcore::thread::ideal_count(); i++)
+            TS_ASSERT(tp.start(new TestTask1(&results[i],&deleted[i])));
+
+        ckcore::thread::sleep(200);
+        TS_ASSERT_EQUALS(tp.idle_threads(),ckcore::thread::ideal_count());
+
+        std::vector<ckcore::Task *> task_vec;
+        for (ckcore::tuint32 i = 0; i < 32; i++)
+            task_vec.push_back(new TestTask1(&results[i],&deleted[i]));
+
+        TS_ASSERT(tp.start_batch(task_vec));
+        TS_ASSERT_EQUALS(tp.idle_threads(),0);
+
+        tp.wait();
+
+        for (ckcore::tuint32 i = 0; i < ckcore::thread::ideal_count(); i++)
+            TS_ASSERT_EQUALS(results[i],3);
+        for (ckcore::tuint32 i = ckcore::thread::ideal_count(); i < 32; i++)
+            TS_ASSERT_EQUALS(results[i],2);
+
+        TS_ASSERT_EQUALS(tp.active_threads(),0);
+        TS_ASSERT_EQUALS(tp.idle_threads(),0);
+        TS_ASSERT_EQUALS(tp.retired_threads(),0);
+#endif
+    }
+
+    void testThreadPoolNamed()
+    {
+#if 1
+        ckcore::ThreadPool tp(ckT("io"),4,0);
+        TS_ASSERT_EQUALS(tp.name(),ckcore::tstring(ckT("io")));
+        TS_ASSERT_EQUALS(tp.max_threads(),4);
+        TS_ASSERT_EQUALS(ckcore::ThreadPool::instance().max_threads(),
+                         ckcore::thread::ideal_count());
+
+        int results[8];
+        int deleted[8];
+        memset(results,0,sizeof(int) * 8);
+        memset(deleted,0,sizeof(int) * 8);
+
+        for (ckcore::tuint32 i = 0; i < 8; i++)
+            TS_ASSERT(tp.start(new TestTask1(&results[i],&deleted[i])));
+
+        // The pool is sized independently of the default pool.
+        TS_ASSERT_EQUALS(tp.active_threads(),4);
+        TS_ASSERT_EQUALS(tp.queued(),4);
+        TS_ASSERT_EQUALS(ckcore::ThreadPool::instance().active_threads(),0);
+
+        // Wait for all tasks to finish, the threads retire immediately.
+        while (tp.retired_threads() < 4)
+            ckcore::thread::sleep(100);
+
+        for (ckcore::tuint32 i = 0; i < 8; i++)
+        {
+            TS_ASSERT_EQUALS(results[i],1);
+            TS_ASSERT_EQUALS(deleted[i],1);
+        }
+
+        TS_ASSERT_EQUALS(tp.active_threads(),0);
+#endif
+    }
+
+    void testThreadPoolBlocking()
+    {
+#if 1
+        ckcore::ThreadPool tp(ckT("blocking"),1,0);
+
+        int result = 0;
+        int other_result = 0;
+        int deleted = 0;
+
+        // The first task blocks, which should allow the second task to run
+        // even though the pool only has one thread.
+        TS_ASSERT(tp.start(new TestTask2(tp,&result,&other_result)));
+        TS_ASSERT(tp.start(new TestTask1(&other_result,&deleted)));
+
+        ckcore::thread::sleep(200);
+        TS_ASSERT_EQUALS(tp.blocked_threads(),1);
+        TS_ASSERT_EQUALS(tp.queued(),0);
+
+        tp.wait();
+
+        TS_ASSERT_EQUALS(other_result,1);
+        TS_ASSERT_EQUALS(deleted,1);
+        TS_ASSERT_EQUALS(result,1);
+        TS_ASSERT_EQUALS(tp.blocked_threads(),0);
+        TS_ASSERT_EQUALS(tp.active_threads(),0);
+
+#ifndef _DEBUG
+        // Scopes entered outside the pool threads must not be counted.
+        {
+            ckcore::ThreadPool::BlockingScope scope(tp);
+            TS_ASSERT_EQUALS(tp.blocked_threads(),0);
+            TS_ASSERT_EQUALS(tp.active_threads(),0);
+        }
+#endif
+#endif
+    }
+
+    void testThreadPoolTimers()
+    {
+#if 1
+        ckcore::ThreadPool tp(ckT("timers"),2);
+
+        // Delayed task.
+        int result = 0;
+        int deleted = 0;
+
+        ckcore::tuint64 start = ckcore::system::time();
+        TS_ASSERT(tp.start_after(new TestTask1(&result,&deleted),200));
+
+        ckcore::thread::sleep(100);
+        TS_ASSERT_EQUALS(result,0);
+        TS_ASSERT_EQUALS(deleted,0);
+
+        while (deleted == 0 && ckcore::system::time() - start < 5000)
+            ckcore::thread::sleep(10);
+        TS_ASSERT_EQUALS(result,1);
+        TS_ASSERT_EQUALS(deleted,1);
+        TS_ASSERT(ckcore::system::time() - start >= 300);
+
+        // Periodic task.
+        volatile int count = 0;
+        int periodic_deleted = 0;
+
+        TestTask3 *task = new TestTask3(&count,&periodic_deleted);
+        TS_ASSERT(tp.start_every(task,20));
+        TS_ASSERT(!tp.start_every(task,20));
+
+        start = ckcore::system::time();
+        while (count < 5 && ckcore::system::time() - start < 5000)
+            ckcore::thread::sleep(10);
+        TS_ASSERT(count >= 5);
+
+        TS_ASSERT(tp.cancel_timer(task));
+        TS_ASSERT(!tp.cancel_timer(task));
+        tp.wait();
+        TS_ASSERT_EQUALS(periodic_deleted,1);
+
+        // Delayed tasks must never start before their delay has elapsed, even
+        // when the delay is shorter than the timer resolution.
+        for (ckcore::tuint32 delay = 1; delay <= 25; delay += 3)
+        {
+            volatile ckcore::tuint64 started = 0;
+
+            start = ckcore::system::time();
+            TS_ASSERT(tp.start_after(new TestTask5(&started),delay));
+            while (started == 0 && ckcore::system::time() - start < 5000)
+                ckcore::thread::sleep(1);
+            TS_ASSERT(started >= start + delay);
+        }
+
+        // Cancelled tasks are never started.
+        result = deleted = 0;
+        TestTask1 *delayed = new TestTask1(&result,&deleted);
+        TS_ASSERT(tp.start_after(delayed,100));
+        TS_ASSERT(tp.cancel_timer(delayed));
+        ckcore::thread::sleep(200);
+        TS_ASSERT_EQUALS(result,0);
+        TS_ASSERT_EQUALS(deleted,1);
+#endif
+    }
+
+    void testThreadPoolCancellation()
+    {
+#if 1
+        ckcore::ThreadPool tp(ckT("cancellation"),1);
+
+        int result = 0;
+        int deleted[4] = { 0,0,0,0 };
+
+        // Occupy the only thread so that the following tasks are queued.
+        TS_ASSERT(tp.start(new TestTask1(&result,&deleted[0])));
+
+        ckcore::CancellationSource source;
+        for (int i = 1; i < 4; i++)
+        {
+            ckcore::Task *task = new TestTask1(&result,&deleted[i]);
+            task->set_cancellation_token(source.token());
+            TS_ASSERT(tp.start(task));
+        }
+
+        TS_ASSERT_EQUALS(tp.queued(),3);
+        source.cancel();
+        tp.wait();
+
+        // Only the first task should have executed but all should have been
+        // deleted.
+        TS_ASSERT_EQUALS(result,1);
+        for (int i = 0; i < 4; i++)
+            TS_ASSERT_EQUALS(deleted[i],1);
+#endif
+    }
+
+    void testTaskGraph()
+    {
+#if 1
+        ckcore::ThreadPool tp(ckT("graph"),4);
+
+        ckcore::thread::Mutex mutex;
+        std::vector<int> order;
+
+        // Diamond shaped graph where the 0 -> 1 -> 3 branch is slowest.
+        ckcore::TaskGraph graph(tp);
+        ckcore::TaskGraph::Node n0 = graph.add(new TestTask4(0,50,&mutex,&order));
+        ckcore::TaskGraph::Node n1 = graph.add(new TestTask4(1,300,&mutex,&order));
+        ckcore::TaskGraph::Node n2 = graph.add(new TestTask4(2,10,&mutex,&order));
+        ckcore::TaskGraph::Node n3 = graph.add(new TestTask4(3,10,&mutex,&order));
+
+        TS_ASSERT(graph.depend(n1,n0));
+        TS_ASSERT(graph.depend(n2,n0));
+        TS_ASSERT(graph.depend(n3,n1));
+        TS_ASSERT(graph.depend(n3,n2));
+        TS_ASSERT(!graph.depend(n3,n3));
+        TS_ASSERT(!graph.depend(n3,4));
+
+        TS_ASSERT(graph.execute());
+
+        // Node 2 does not depend on node 1 and should finish before it.
+        TS_ASSERT_EQUALS(order.size(),4);
+        if (order.size() == 4)
+        {
+            TS_ASSERT_EQUALS(order[0],0);
+            TS_ASSERT_EQUALS(order[1],2);
+            TS_ASSERT_EQUALS(order[2],1);
+            TS_ASSERT_EQUALS(order[3],3);
+        }
+
+        const std::vector<ckcore::TaskGraph::Node> &path = graph.critical_path();
+        TS_ASSERT_EQUALS(path.size(),3);
+        if (path.size() == 3)
+        {
+            TS_ASSERT_EQUALS(path[0],n0);
+            TS_ASSERT_EQUALS(path[1],n1);
+            TS_ASSERT_EQUALS(path[2],n3);
+        }
+        TS_ASSERT(graph.critical_path_time() >= 350);
+
+        // Graphs containing cycles should be rejected.
+        ckcore::TaskGraph cyclic(tp);
+        order.clear();
+        ckcore::TaskGraph::Node c0 = cyclic.add(new TestTask4(0,0,&mutex,&order));
+        ckcore::TaskGraph::Node c1 = cyclic.add(new TestTask4(1,0,&mutex,&order));
+        TS_ASSERT(cyclic.depend(c1,c0));
+        TS_ASSERT(cyclic.depend(c0,c1));
+        TS_ASSERT(!cyclic.execute());
+        TS_ASSERT(order.empty());
 #endif
     }
 };